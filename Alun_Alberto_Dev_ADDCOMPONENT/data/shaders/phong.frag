@@ -8,23 +8,29 @@ in vec3 v_cam_dir;
 in vec3 v_vertex_world_pos;
 out vec4 fragColor;
 
-//basic material uniforms
-uniform vec3 u_ambient;
-uniform vec3 u_diffuse;
-uniform vec3 u_specular;
-uniform float u_specular_gloss;
+//basic material uniforms, must match MaterialBlock in GraphicsSystem.h
+layout(std140) uniform MaterialBlock {
+	vec3 u_ambient;
+	vec3 u_diffuse;
+	vec3 u_specular;
+	float u_specular_gloss;
+};
 
 //texture uniforms
 uniform sampler2D u_diffuse_map;
 
-//light structs and uniforms
+//per frame uniforms, must match FrameBlock in GraphicsSystem.h
 struct PointLight {
 	vec3 position;
 	vec3 color;
 };
 const int MAX_LIGHTS = 8;
-uniform PointLight lights[MAX_LIGHTS];
-uniform int u_num_lights;
+layout(std140) uniform FrameBlock {
+	mat4 u_vp;
+	vec3 u_cam_pos;
+	PointLight lights[MAX_LIGHTS];
+	int u_num_lights;
+};
 
 
 void main(){
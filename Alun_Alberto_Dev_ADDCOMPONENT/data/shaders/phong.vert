@@ -7,7 +7,19 @@ layout(location = 2) in vec3 a_normal;
 uniform mat4 u_mvp;
 uniform mat4 u_model;
 uniform mat4 u_normal_matrix;
-uniform vec3 u_cam_pos; 
+
+//per frame uniforms, must match FrameBlock in GraphicsSystem.h
+struct PointLight {
+	vec3 position;
+	vec3 color;
+};
+const int MAX_LIGHTS = 8;
+layout(std140) uniform FrameBlock {
+	mat4 u_vp;
+	vec3 u_cam_pos;
+	PointLight lights[MAX_LIGHTS];
+	int u_num_lights;
+};
 
 out vec2 v_uv;
 out vec3 v_normal;
@@ -0,0 +1,42 @@
+#version 330
+
+layout(location = 0) in vec3 a_vertex;
+layout(location = 1) in vec2 a_uv;
+layout(location = 2) in vec3 a_normal;
+
+//per instance attributes, a mat4 takes four locations each
+layout(location = 3) in mat4 a_model;
+layout(location = 7) in mat4 a_normal_matrix;
+
+//per frame uniforms, must match FrameBlock in GraphicsSystem.h
+struct PointLight {
+	vec3 position;
+	vec3 color;
+};
+const int MAX_LIGHTS = 8;
+layout(std140) uniform FrameBlock {
+	mat4 u_vp;
+	vec3 u_cam_pos;
+	PointLight lights[MAX_LIGHTS];
+	int u_num_lights;
+};
+
+out vec2 v_uv;
+out vec3 v_normal;
+out vec3 v_vertex_world_pos;
+out vec3 v_cam_dir;
+
+void main(){
+
+	v_uv = a_uv;
+	//rotate normal 
+	v_normal = (a_normal_matrix * vec4(a_normal, 1.0)).xyz;
+
+	//calculate world position of current vertex
+	v_vertex_world_pos = (a_model * vec4(a_vertex, 1.0)).xyz;
+
+	//calculate direction to camera in world space
+	v_cam_dir = u_cam_pos - v_vertex_world_pos;
+
+	gl_Position = u_vp * vec4(v_vertex_world_pos, 1.0);
+}
\ No newline at end of file
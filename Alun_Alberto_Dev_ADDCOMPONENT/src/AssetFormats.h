@@ -0,0 +1,164 @@
+#pragma once
+#include "includes.h"
+#include "BVH.h"
+#include <cstdint>
+
+// Binary layouts of the asset files read at runtime and written by the cooker.
+// .mesh and .tex files are both a stream of chunks, each a TChunk followed by
+// num_bytes of data, ending with a magicEoF chunk. Unknown chunks are skipped
+
+struct TGAInfo //stores info about TGA file, or a cooked texture
+{
+	GLuint width;
+	GLuint height;
+	GLuint bpp; //bits per pixel
+	GLubyte* data; //bytes with the pixel information
+	//mip levels in data, largest first, each half the size of the one before
+	//(at least 1 pixel). 1 means mips must be generated when uploading
+	GLuint num_levels = 1;
+};
+
+// Declare necessary structs to identify byte chunks
+struct TChunk {
+
+    uint32_t magic_id;
+    uint32_t num_bytes;
+};
+
+struct THeader {
+
+    uint32_t num_vertexs = 0;
+    uint32_t num_indices = 0;
+    uint32_t primitive_type = 0;
+    uint32_t bytes_per_vtx = 0;
+    uint32_t bytes_per_idx = 0;
+    uint32_t num_subgroups = 0;
+    uint32_t flags = 0; //MESH_FLAG_*, 0 in exported files
+    uint32_t dummy3 = 0;
+    char     vertex_type_name[32];
+};
+
+//flags of THeader
+//file has a magicAABB chunk with the bounds of its vertices
+static const uint32_t MESH_FLAG_AABB = 1;
+//indices are ordered for the vertex cache and overdraw, vertices in order of first use
+static const uint32_t MESH_FLAG_OPTIMIZED = 2;
+
+// Magics to identify each block
+static const uint32_t magicHeader = 0x44444444;
+static const uint32_t magicVtxs = 0x55554433;
+static const uint32_t magicIdxs = 0x55556677;
+static const uint32_t magicSubGroups = 0x55556688;
+static const uint32_t magicAABB = 0x55557799; //6 floats: center, half width
+static const uint32_t magicEoF = 0x55558888;
+
+// View of the chunks of a .mesh file mapped in memory. vertices and indices
+// point straight into the mapping, so are only valid while it is open
+struct MeshView {
+    THeader header;
+    const unsigned char* vertices = nullptr; // header.num_vertexs * header.bytes_per_vtx bytes
+    const unsigned char* indices = nullptr; // header.num_indices * header.bytes_per_idx bytes
+    bool has_aabb = false;
+    AABB aabb;
+};
+
+// Cooked texture (.tex): header, then all mip levels in one chunk, largest
+// first. Pixels are as in the source TGA, BGR or BGRA rows bottom up, tightly
+// packed (no row alignment)
+struct TTextureHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bpp = 0; //24 or 32
+    uint32_t num_levels = 0;
+};
+
+static const uint32_t magicTextureHeader = 0x54584848;
+static const uint32_t magicTextureLevels = 0x54584C56;
+
+//bytes of a full mip chain of num_levels from a width x height image
+inline size_t mipChainBytes(GLuint width, GLuint height, GLuint bytes_per_pixel, GLuint num_levels) {
+    size_t bytes = 0;
+    for (GLuint level = 0; level < num_levels; level++) {
+        bytes += (size_t)width * height * bytes_per_pixel;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes;
+}
+
+// Compiled scene (.bscene), made from a .scene by the cooker with prefabs
+// already expanded. Header, then one table per record type and a table of
+// null terminated strings, all at 4 byte aligned offsets so records can be
+// read in place from the mapped file. Strings are referred to by their offset
+// in the string table, entities by their index in the entity table.
+// Files of any other version are rejected and the .scene is read instead, as
+// they are when the .scene or any prefab listed in the file is newer
+static const uint32_t magicScene = 0x4E435342; //BSCN
+static const uint32_t SCENE_VERSION = 2;
+
+enum SceneTable {
+    SceneTableEntities,
+    SceneTableTransforms,
+    SceneTableMeshes,
+    SceneTableLights,
+    SceneTableColliders,
+    SceneTableElevators,
+    SceneTablePrefabs,
+    SceneTableStrings, //count is bytes, record_bytes is 1
+    SCENE_TABLE_COUNT
+};
+
+struct TSceneTableInfo {
+    uint32_t offset = 0; //bytes from start of file
+    uint32_t count = 0;
+    uint32_t record_bytes = 0;
+};
+
+struct TSceneHeader {
+    uint32_t magic = magicScene;
+    uint32_t version = SCENE_VERSION;
+    TSceneTableInfo tables[SCENE_TABLE_COUNT];
+};
+
+struct TSceneEntity {
+    uint32_t name; //string
+    int32_t parent; //entity, -1 if root
+};
+
+//local matrix, as Transform::Load would leave it
+struct TSceneTransform {
+    uint32_t entity;
+    float matrix[16];
+};
+
+struct TSceneMesh {
+    uint32_t entity;
+    uint32_t mesh; //string, path of geometry file
+    uint32_t material; //string, path of material file
+};
+
+struct TSceneLight {
+    uint32_t entity;
+    float color[3];
+};
+
+//type is a ColliderType, or SCENE_COLLIDER_DEFAULT to keep the default shape
+static const uint32_t SCENE_COLLIDER_DEFAULT = 0xFFFFFFFF;
+struct TSceneCollider {
+    uint32_t entity;
+    uint32_t type;
+    float center[3];
+    float halfwidth[3];
+};
+
+struct TSceneElevator {
+    uint32_t entity;
+    float direction[3];
+    float speed;
+    uint32_t automatic;
+};
+
+//prefab file expanded into the scene, nested ones included
+struct TScenePrefab {
+    uint32_t path; //string
+};
@@ -0,0 +1,605 @@
+#include "Parsers.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <fstream>
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+
+// Parsers which only read files, without GL calls or the ECS, so that they
+// are shared by the engine and the asset cooker
+
+/**** OBJ ****/
+
+//files at least this big are split in chunks parsed in parallel
+static const size_t OBJ_PARALLEL_MIN_BYTES = 4 * 1024 * 1024;
+static const size_t OBJ_CHUNK_MIN_BYTES = 1024 * 1024;
+
+//face vertex, with indices as written in file (1 based, or negative relative
+//to last element read). 0 if missing
+struct ObjCorner {
+    int index[3]; //position, uv, normal
+};
+
+//polygon, as a run of corners. Keeps number of each attribute read in its
+//chunk before it, so negative indices can be resolved when chunks are merged
+struct ObjFace {
+    uint32_t first;
+    uint32_t count;
+    int num_read[3];
+};
+
+//one range of lines of an obj file, and what was parsed from it
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    std::vector<lm::vec3> positions;
+    std::vector<lm::vec2> uvs;
+    std::vector<lm::vec3> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<ObjFace> faces;
+};
+
+static inline bool isObjSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline void skipObjSpaces(const char*& p, const char* end) {
+    while (p < end && isObjSpace(*p)) p++;
+}
+
+//reads an integer at p and moves past it. 0 if there is none
+static int parseObjInt(const char*& p, const char* end) {
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) p++;
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    return negative ? -value : value;
+}
+
+//reads a decimal float (with optional exponent) at p and moves past it.
+//Digits are gathered in an integer and scaled once, instead of going through atof
+static float parseObjFloat(const char*& p, const char* end) {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    skipObjSpaces(p, end);
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) p++;
+
+    //first 19 significant digits fit in 64 bits, the rest only move the exponent
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) digits++; }
+        else exponent++;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) digits++; exponent--; }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = p < end && *p == '-';
+        if (negative_exponent || (p < end && *p == '+')) p++;
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (e < 10000) e = e * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negative_exponent ? -e : e;
+    }
+
+    double value = (double)mantissa;
+    int abs_exponent = exponent < 0 ? -exponent : exponent;
+    double scale = abs_exponent <= 22 ? powers[abs_exponent] : pow(10.0, abs_exponent);
+    value = exponent < 0 ? value / scale : value * scale;
+    return (float)(negative ? -value : value);
+}
+
+//parses v, vt, vn and f lines of chunk. Anything else is ignored
+static void parseObjChunk(ObjChunk& chunk) {
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* line_end = (const char*)memchr(p, '\n', chunk.end - p);
+        if (!line_end) line_end = chunk.end;
+        skipObjSpaces(p, line_end);
+
+        size_t length = line_end - p;
+        if (length > 2 && p[0] == 'v' && isObjSpace(p[1])) {
+            p += 2;
+            float x = parseObjFloat(p, line_end);
+            float y = parseObjFloat(p, line_end);
+            float z = parseObjFloat(p, line_end);
+            chunk.positions.push_back(lm::vec3(x, y, z));
+        }
+        else if (length > 3 && p[0] == 'v' && p[1] == 't' && isObjSpace(p[2])) {
+            p += 3;
+            float u = parseObjFloat(p, line_end);
+            float v = parseObjFloat(p, line_end);
+            chunk.uvs.push_back(lm::vec2(u, v));
+        }
+        else if (length > 3 && p[0] == 'v' && p[1] == 'n' && isObjSpace(p[2])) {
+            p += 3;
+            float x = parseObjFloat(p, line_end);
+            float y = parseObjFloat(p, line_end);
+            float z = parseObjFloat(p, line_end);
+            chunk.normals.push_back(lm::vec3(x, y, z));
+        }
+        else if (length > 2 && p[0] == 'f' && isObjSpace(p[1])) {
+            p += 2;
+            ObjFace face;
+            face.first = (uint32_t)chunk.corners.size();
+            face.num_read[0] = (int)chunk.positions.size();
+            face.num_read[1] = (int)chunk.uvs.size();
+            face.num_read[2] = (int)chunk.normals.size();
+            //corners are v, v/t, v//n or v/t/n
+            while (true) {
+                skipObjSpaces(p, line_end);
+                if (p >= line_end) break;
+                ObjCorner corner = { { 0, 0, 0 } };
+                corner.index[0] = parseObjInt(p, line_end);
+                if (p < line_end && *p == '/') {
+                    p++;
+                    corner.index[1] = parseObjInt(p, line_end);
+                    if (p < line_end && *p == '/') {
+                        p++;
+                        corner.index[2] = parseObjInt(p, line_end);
+                    }
+                }
+                while (p < line_end && !isObjSpace(*p)) p++;
+                chunk.corners.push_back(corner);
+            }
+            face.count = (uint32_t)chunk.corners.size() - face.first;
+            if (face.count >= 3) chunk.faces.push_back(face);
+            else chunk.corners.resize(face.first);
+        }
+        p = line_end + 1;
+    }
+}
+
+//0 based index of an attribute, from index as written in file. -1 if missing,
+//-2 if out of range
+static int resolveObjIndex(int index, int chunk_first, int num_read, int total) {
+    if (index == 0) return -1;
+    int resolved = index > 0 ? index - 1 : chunk_first + num_read + index;
+    return resolved >= 0 && resolved < total ? resolved : -2;
+}
+
+//parses a wavefront object into passed arrays. The file is mapped and read in
+//place; big files are split in chunks of whole lines parsed on the job system,
+//then merged in file order, so result is the same however it was split.
+//Each distinct position/uv/normal triple becomes one vertex, polygons are
+//triangulated as fans. If the file has no uvs or normals, those arrays are left empty
+bool Parsers::parseOBJ(std::string filename, std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices) {
+    PROFILE_SCOPE("Parsers::parseOBJ");
+
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    const char* data = (const char*)file.data();
+    size_t size = file.size();
+
+    //split at line starts
+    JobSystem& jobs = JobSystem::get();
+    size_t num_chunks = 1;
+    if (size >= OBJ_PARALLEL_MIN_BYTES && jobs.getNumWorkers() > 0)
+        num_chunks = std::min((size_t)(jobs.getNumWorkers() + 1) * 4, size / OBJ_CHUNK_MIN_BYTES);
+    std::vector<ObjChunk> chunks(num_chunks);
+    const char* chunk_begin = data;
+    for (size_t i = 0; i < num_chunks; i++) {
+        const char* chunk_end = data + size;
+        if (i + 1 < num_chunks) {
+            chunk_end = std::max(chunk_begin, data + size * (i + 1) / num_chunks);
+            const char* line_end = (const char*)memchr(chunk_end, '\n', data + size - chunk_end);
+            chunk_end = line_end ? line_end + 1 : data + size;
+        }
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    if (num_chunks == 1) parseObjChunk(chunks[0]);
+    else jobs.parallelFor((int)num_chunks, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) parseObjChunk(chunks[i]);
+    });
+
+    //first position, uv and normal of each chunk in the whole file
+    std::vector<lm::vec3> positions;
+    std::vector<lm::vec2> file_uvs;
+    std::vector<lm::vec3> file_normals;
+    std::vector<int> chunk_first(num_chunks * 3);
+    size_t num_corners = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunk_first[i * 3] = (int)positions.size();
+        chunk_first[i * 3 + 1] = (int)file_uvs.size();
+        chunk_first[i * 3 + 2] = (int)file_normals.size();
+        positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+        file_uvs.insert(file_uvs.end(), chunks[i].uvs.begin(), chunks[i].uvs.end());
+        file_normals.insert(file_normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+        num_corners += chunks[i].corners.size();
+    }
+    int totals[3] = { (int)positions.size(), (int)file_uvs.size(), (int)file_normals.size() };
+    bool has_uvs = !file_uvs.empty();
+    bool has_normals = !file_normals.empty();
+
+    //vertices already made from each position, as linked lists of their
+    //uv and normal, so deduplicating needs no hashing or strings
+    struct VertexVariant {
+        int uv, normal;
+        unsigned int vertex;
+        int next;
+    };
+    std::vector<int> position_variants(positions.size(), -1);
+    std::vector<VertexVariant> variants;
+    variants.reserve(positions.size());
+    vertices.reserve(vertices.size() + positions.size() * 3);
+    if (has_uvs) uvs.reserve(uvs.size() + positions.size() * 2);
+    if (has_normals) normals.reserve(normals.size() + positions.size() * 3);
+    indices.reserve(indices.size() + num_corners * 3);
+
+    unsigned int next_vertex = (unsigned int)(vertices.size() / 3);
+    std::vector<unsigned int> face_vertices;
+    for (size_t c = 0; c < num_chunks; c++) {
+        const ObjChunk& chunk = chunks[c];
+        for (const ObjFace& face : chunk.faces) {
+            face_vertices.clear();
+            for (uint32_t k = 0; k < face.count; k++) {
+                const ObjCorner& corner = chunk.corners[face.first + k];
+                int resolved[3];
+                for (int a = 0; a < 3; a++)
+                    resolved[a] = resolveObjIndex(corner.index[a], chunk_first[c * 3 + a], face.num_read[a], totals[a]);
+                if (resolved[0] < 0 || resolved[1] == -2 || resolved[2] == -2) {
+                    std::cerr << "ERROR: Face index out of range in " << filename << std::endl;
+                    return false;
+                }
+
+                int variant = position_variants[resolved[0]];
+                while (variant != -1 && (variants[variant].uv != resolved[1] || variants[variant].normal != resolved[2]))
+                    variant = variants[variant].next;
+                if (variant == -1) {
+                    //new vertex
+                    const lm::vec3& pos = positions[resolved[0]];
+                    vertices.insert(vertices.end(), { pos.x, pos.y, pos.z });
+                    if (has_uvs) {
+                        lm::vec2 uv = resolved[1] >= 0 ? file_uvs[resolved[1]] : lm::vec2(0.0f, 0.0f);
+                        uvs.insert(uvs.end(), { uv.x, uv.y });
+                    }
+                    if (has_normals) {
+                        lm::vec3 normal = resolved[2] >= 0 ? file_normals[resolved[2]] : lm::vec3(0.0f, 0.0f, 0.0f);
+                        normals.insert(normals.end(), { normal.x, normal.y, normal.z });
+                    }
+                    variants.push_back({ resolved[1], resolved[2], next_vertex, position_variants[resolved[0]] });
+                    variant = (int)variants.size() - 1;
+                    position_variants[resolved[0]] = variant;
+                    next_vertex++;
+                }
+                face_vertices.push_back(variants[variant].vertex);
+            }
+            //fan from first corner
+            for (size_t k = 2; k < face_vertices.size(); k++)
+                indices.insert(indices.end(), { face_vertices[0], face_vertices[k - 1], face_vertices[k] });
+        }
+    }
+    return true;
+}
+
+//reads chunks of a .mesh file mapped in memory, checking that every chunk fits
+//in the file and that the vertex and index chunks match the sizes in the header.
+//Nothing is copied, mesh points into the mapped file
+bool Parsers::parseBin(const MappedFile& file, const std::string& filename, MeshView& mesh)
+{
+    PROFILE_SCOPE("Parsers::parseBin");
+    const unsigned char* data = file.data();
+    size_t size = file.size();
+    size_t offset = 0;
+    bool header_found = false;
+    uint32_t vertices_bytes = 0, indices_bytes = 0;
+
+    mesh.vertices = nullptr;
+    mesh.indices = nullptr;
+    mesh.has_aabb = false;
+
+    //walk chunk stream
+    bool eof_found = false;
+    while (!eof_found) {
+
+        TChunk chunk;
+        if (size - offset < sizeof(TChunk)) {
+            std::cerr << "ERROR: Truncated chunk in mesh file " << filename << std::endl;
+            return false;
+        }
+        memcpy(&chunk, data + offset, sizeof(TChunk));
+        offset += sizeof(TChunk);
+        if (chunk.num_bytes > size - offset) {
+            std::cerr << "ERROR: Chunk larger than mesh file " << filename << std::endl;
+            return false;
+        }
+        const unsigned char* chunk_data = data + offset;
+
+        switch (chunk.magic_id) {
+
+        case magicHeader:
+
+            if (chunk.num_bytes != sizeof(THeader)) {
+                std::cerr << "ERROR: Unexpected header size in mesh file " << filename << std::endl;
+                return false;
+            }
+            memcpy(&mesh.header, chunk_data, sizeof(THeader));
+            header_found = true;
+            break;
+
+        case magicVtxs:
+
+            mesh.vertices = chunk_data;
+            vertices_bytes = chunk.num_bytes;
+            break;
+
+        case magicIdxs:
+
+            mesh.indices = chunk_data;
+            indices_bytes = chunk.num_bytes;
+            break;
+
+        case magicSubGroups:
+
+            // add subgroups here
+
+            break;
+
+        case magicAABB:
+
+            if (chunk.num_bytes != 6 * sizeof(float)) {
+                std::cerr << "ERROR: Unexpected AABB size in mesh file " << filename << std::endl;
+                return false;
+            }
+            float bounds[6];
+            memcpy(bounds, chunk_data, sizeof(bounds));
+            mesh.aabb.center = lm::vec3(bounds[0], bounds[1], bounds[2]);
+            mesh.aabb.half_width = lm::vec3(bounds[3], bounds[4], bounds[5]);
+            mesh.has_aabb = true;
+            break;
+
+        case magicEoF:
+
+            eof_found = true;
+            break;
+
+        default:
+            //printf("Unknown chunk data type %08x of %d bytes while reading file %s\n", chunk.magic_id, chunk.num_bytes, filename.c_str());
+            break;
+        }
+        offset += chunk.num_bytes;
+    }
+
+    //check contents agree with header
+    if (!header_found || !mesh.vertices || !mesh.indices) {
+        std::cerr << "ERROR: Mesh file is missing header, vertex or index chunk " << filename << std::endl;
+        return false;
+    }
+    const THeader& header = mesh.header;
+    if (header.bytes_per_idx != 2 && header.bytes_per_idx != 4) {
+        std::cerr << "ERROR: Unsupported index size " << header.bytes_per_idx << " in mesh file " << filename << std::endl;
+        return false;
+    }
+    if ((uint64_t)header.num_vertexs * header.bytes_per_vtx != vertices_bytes ||
+        (uint64_t)header.num_indices * header.bytes_per_idx != indices_bytes) {
+        std::cerr << "ERROR: Chunk sizes do not match header in mesh file " << filename << std::endl;
+        return false;
+    }
+    if (memchr(header.vertex_type_name, 0, sizeof(header.vertex_type_name)) == nullptr) {
+        std::cerr << "ERROR: Bad vertex type name in mesh file " << filename << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// this reader supports only uncompressed RGB targa files with no colour table
+TGAInfo* Parsers::loadTGA(std::string filename)
+{
+	PROFILE_SCOPE("Parsers::loadTGA");
+	//the TGA header is 18 bytes long. The first 12 bytes are for specifying the compression
+	//and various fields that are very infrequently used, and hence are usually 0.
+	//for this limited file parser, we start by reading the first 12 bytes and compare
+	//them against the pattern that identifies the file a simple, uncompressed RGB file.
+	//more info about the TGA format cane be found at http://www.paulbourke.net/dataformats/tga/
+
+	char TGA_uncompressed[12] = { 0x0, 0x0, 0x2, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
+	char TGA_compare[12];
+	char info_header[6];
+	GLuint bytes_per_pixel;
+	GLuint image_size;
+
+	//open file
+	std::ifstream file(filename, std::ios::binary);
+
+	//read first 12 bytes
+	file.read(&TGA_compare[0], 12);
+	std::streamsize read_header_12 = file.gcount();
+	//compare to check that file in uncompressed (or not corrupted)
+	int header_compare = memcmp(TGA_uncompressed, TGA_compare, sizeof(TGA_uncompressed));
+	if (read_header_12 != sizeof(TGA_compare) || header_compare != 0) {
+		std::cerr << "ERROR: TGA file is not in correct format or corrupted: " << filename << std::endl;
+		file.close();
+		return nullptr;
+	}
+
+	//read in next 6 bytes, which contain 'important' bit of header
+	file.read(&info_header[0], 6);
+
+	TGAInfo* tgainfo = new TGAInfo;
+
+	tgainfo->width = info_header[1] * 256 + info_header[0]; //width is stored in first two bytes of info_header
+	tgainfo->height = info_header[3] * 256 + info_header[2]; //height is stored in next two bytes of info_header
+
+	if (tgainfo->width <= 0 || tgainfo->height <= 0 || (info_header[4] != 24 && info_header[4] != 32)) {
+		file.close();
+		delete tgainfo;
+		std::cerr << "ERROR: TGA file is not 24 or 32 bits, or has no width or height: " << filename << std::endl;
+		return NULL;
+	}
+
+	//calculate bytes per pixel and then total image size in bytes
+	tgainfo->bpp = info_header[4];
+	bytes_per_pixel = tgainfo->bpp / 8;
+	image_size = tgainfo->width * tgainfo->height * bytes_per_pixel;
+
+	//reserve memory for the image data
+	tgainfo->data = (GLubyte*)malloc(image_size);
+
+	//read data into memory
+	file.read((char*)tgainfo->data, image_size);
+	std::streamsize image_read_size = file.gcount();
+
+	//check it has been read correctly
+	if (image_read_size != image_size) {
+		if (tgainfo->data != NULL)
+			free(tgainfo->data);
+		file.close();
+		std::cerr << "ERROR: Could not read tga data: " << filename << std::endl;
+		delete tgainfo;
+		return NULL;
+	}
+
+	file.close();
+
+	return tgainfo;
+}
+
+// reads a texture written by the cooker, with all its mip levels
+TGAInfo* Parsers::loadCookedTexture(const std::string& filename)
+{
+    PROFILE_SCOPE("Parsers::loadCookedTexture");
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "ERROR: Could not open texture file " << filename << std::endl;
+        return nullptr;
+    }
+    const unsigned char* data = file.data();
+    size_t size = file.size();
+    size_t offset = 0;
+
+    TTextureHeader header;
+    bool header_found = false;
+    const unsigned char* levels = nullptr;
+    size_t levels_bytes = 0;
+    bool eof_found = false;
+    while (!eof_found) {
+        TChunk chunk;
+        if (size - offset < sizeof(TChunk)) {
+            std::cerr << "ERROR: Truncated chunk in texture file " << filename << std::endl;
+            return nullptr;
+        }
+        memcpy(&chunk, data + offset, sizeof(TChunk));
+        offset += sizeof(TChunk);
+        if (chunk.num_bytes > size - offset) {
+            std::cerr << "ERROR: Chunk larger than texture file " << filename << std::endl;
+            return nullptr;
+        }
+        if (chunk.magic_id == magicTextureHeader && chunk.num_bytes == sizeof(TTextureHeader)) {
+            memcpy(&header, data + offset, sizeof(TTextureHeader));
+            header_found = true;
+        }
+        else if (chunk.magic_id == magicTextureLevels) {
+            levels = data + offset;
+            levels_bytes = chunk.num_bytes;
+        }
+        else if (chunk.magic_id == magicEoF) {
+            eof_found = true;
+        }
+        offset += chunk.num_bytes;
+    }
+
+    if (!header_found || !levels || header.width == 0 || header.height == 0 || header.num_levels == 0 ||
+        (header.bpp != 24 && header.bpp != 32) ||
+        mipChainBytes(header.width, header.height, header.bpp / 8, header.num_levels) != levels_bytes) {
+        std::cerr << "ERROR: Texture file is missing chunks or does not match its header: " << filename << std::endl;
+        return nullptr;
+    }
+
+    TGAInfo* tgainfo = new TGAInfo;
+    tgainfo->width = header.width;
+    tgainfo->height = header.height;
+    tgainfo->bpp = header.bpp;
+    tgainfo->num_levels = header.num_levels;
+    tgainfo->data = (GLubyte*)malloc(levels_bytes);
+    memcpy(tgainfo->data, levels, levels_bytes);
+    return tgainfo;
+}
+
+// box filters each level from the one before. Odd sizes repeat their last
+// row or column, which is close enough for small levels
+void Parsers::generateMips(TGAInfo* tgainfo)
+{
+    PROFILE_SCOPE("Parsers::generateMips");
+    if (tgainfo->num_levels != 1) return;
+
+    //every level down to 1x1
+    GLuint num_levels = 1;
+    while ((tgainfo->width >> num_levels) > 0 || (tgainfo->height >> num_levels) > 0) num_levels++;
+    GLuint bytes_per_pixel = tgainfo->bpp / 8;
+    GLubyte* levels = (GLubyte*)realloc(tgainfo->data, mipChainBytes(tgainfo->width, tgainfo->height, bytes_per_pixel, num_levels));
+    if (levels == NULL) return;
+    tgainfo->data = levels;
+    tgainfo->num_levels = num_levels;
+
+    GLuint width = tgainfo->width, height = tgainfo->height;
+    size_t level_offset = 0;
+    for (GLuint level = 1; level < num_levels; level++) {
+        GLuint next_width = width > 1 ? width / 2 : 1;
+        GLuint next_height = height > 1 ? height / 2 : 1;
+        const unsigned char* src = levels + level_offset;
+        level_offset += (size_t)width * height * bytes_per_pixel;
+        unsigned char* dst = levels + level_offset;
+        for (GLuint y = 0; y < next_height; y++) {
+            GLuint y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (GLuint x = 0; x < next_width; x++) {
+                GLuint x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (GLuint c = 0; c < bytes_per_pixel; c++) {
+                    unsigned int sum = src[((size_t)y0 * width + x0) * bytes_per_pixel + c] +
+                                       src[((size_t)y0 * width + x1) * bytes_per_pixel + c] +
+                                       src[((size_t)y1 * width + x0) * bytes_per_pixel + c] +
+                                       src[((size_t)y1 * width + x1) * bytes_per_pixel + c];
+                    dst[((size_t)y * next_width + x) * bytes_per_pixel + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        width = next_width;
+        height = next_height;
+    }
+}
+
+// reads cooked version of a texture if there is one, else the TGA itself
+TGAInfo* Parsers::loadTexture(const std::string& filename)
+{
+    std::string path = getCookedFilename(filename);
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".tex") == 0)
+        return loadCookedTexture(path);
+    return loadTGA(path);
+}
+
+// cooked files sit next to their source, with the extension of the runtime format.
+// A cooked file older than its source is stale (source was edited since it was
+// cooked) and is ignored until it is cooked again
+std::string Parsers::getCookedFilename(const std::string& filename)
+{
+    if (filename.size() < 4) return filename;
+    std::string ext = filename.substr(filename.size() - 4, 4);
+    std::string cooked;
+    if (ext == ".obj" || ext == ".OBJ") cooked = filename.substr(0, filename.size() - 4) + ".mesh";
+    else if (ext == ".tga" || ext == ".TGA") cooked = filename.substr(0, filename.size() - 4) + ".tex";
+    else if (filename.size() > 6 && filename.compare(filename.size() - 6, 6, ".scene") == 0)
+        cooked = filename.substr(0, filename.size() - 6) + ".bscene";
+    else return filename;
+
+    struct stat source_stat, cooked_stat;
+    if (stat(cooked.c_str(), &cooked_stat) != 0) return filename;
+    //shipped without its source
+    if (stat(filename.c_str(), &source_stat) != 0) return cooked;
+    if (cooked_stat.st_mtime < source_stat.st_mtime) {
+        std::cerr << "WARNING: " << cooked << " is older than " << filename << ", loading source instead" << std::endl;
+        return filename;
+    }
+    return cooked;
+}
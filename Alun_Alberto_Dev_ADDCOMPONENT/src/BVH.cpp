@@ -0,0 +1,223 @@
+#include "BVH.h"
+#include <algorithm>
+
+//Gribb and Hartmann method: each plane is the sum or difference of the
+//fourth row of the matrix and one of the other three rows
+void Frustum::fromViewProjection(const lm::mat4& vp) {
+    const float* m = vp.m; //column major, row i is m[i], m[4+i], m[8+i], m[12+i]
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = lm::vec4(m[3] + m[i], m[7] + m[4 + i], m[11] + m[8 + i], m[15] + m[12 + i]);
+        planes[i * 2 + 1] = lm::vec4(m[3] - m[i], m[7] - m[4 + i], m[11] - m[8 + i], m[15] - m[12 + i]);
+    }
+}
+
+//recalculates AABB which encloses given AABB after transforming it (Arvo's method):
+//center is transformed as a point, and each new half width is the sum of the old
+//half widths weighted by the absolute value of the rotation and scale terms
+AABB transformAABB(const AABB& aabb, const lm::mat4& transform) {
+	const float* m = transform.m;
+	float hx = fabs(aabb.half_width.x);
+	float hy = fabs(aabb.half_width.y);
+	float hz = fabs(aabb.half_width.z);
+
+	AABB new_aabb;
+	new_aabb.center = transform * aabb.center;
+	new_aabb.half_width = lm::vec3(
+		fabs(m[0]) * hx + fabs(m[4]) * hy + fabs(m[8]) * hz,
+		fabs(m[1]) * hx + fabs(m[5]) * hy + fabs(m[9]) * hz,
+		fabs(m[2]) * hx + fabs(m[6]) * hy + fabs(m[10]) * hz);
+
+	return new_aabb;
+}
+
+void BVH::build(const std::vector<AABB>& boxes) {
+    nodes_.clear();
+    items_.resize(boxes.size());
+    item_bounds_.resize(boxes.size());
+    centers_.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        items_[i] = (int)i;
+        centers_[i] = boxes[i].center;
+    }
+    if (boxes.empty()) return;
+
+    nodes_.reserve(boxes.size() * 2 / MAX_LEAF_ITEMS + 1);
+    buildNode_(boxes, 0, (int)boxes.size());
+}
+
+int BVH::buildNode_(const std::vector<AABB>& boxes, int first, int count) {
+    int node_index = (int)nodes_.size();
+    nodes_.emplace_back();
+    nodes_[node_index].first = first;
+    nodes_[node_index].count = count;
+
+    if (count <= MAX_LEAF_ITEMS) {
+        setLeafBounds_(nodes_[node_index], boxes);
+        return node_index;
+    }
+
+    //find longest axis of box centers
+    lm::vec3 c_min = centers_[items_[first]], c_max = c_min;
+    for (int i = first + 1; i < first + count; i++) {
+        const lm::vec3& c = centers_[items_[i]];
+        c_min = lm::vec3(std::min(c_min.x, c.x), std::min(c_min.y, c.y), std::min(c_min.z, c.z));
+        c_max = lm::vec3(std::max(c_max.x, c.x), std::max(c_max.y, c.y), std::max(c_max.z, c.z));
+    }
+    lm::vec3 extent = c_max - c_min;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent.value_[axis]) axis = 2;
+
+    //split at median along that axis
+    int half = count / 2;
+    std::nth_element(items_.begin() + first, items_.begin() + first + half, items_.begin() + first + count,
+                     [this, axis](int a, int b) { return centers_[a].value_[axis] < centers_[b].value_[axis]; });
+
+    //note nodes_ may reallocate while building children, so don't keep references
+    int left = buildNode_(boxes, first, half);
+    int right = buildNode_(boxes, first + half, count - half);
+    Node& node = nodes_[node_index];
+    node.left = left;
+    node.right = right;
+    const Node& l = nodes_[left];
+    const Node& r = nodes_[right];
+    node.min = lm::vec3(std::min(l.min.x, r.min.x), std::min(l.min.y, r.min.y), std::min(l.min.z, r.min.z));
+    node.max = lm::vec3(std::max(l.max.x, r.max.x), std::max(l.max.y, r.max.y), std::max(l.max.z, r.max.z));
+    return node_index;
+}
+
+void BVH::refit(const std::vector<AABB>& boxes) {
+    //children are always after parents, so going backwards they are ready first
+    for (int i = (int)nodes_.size() - 1; i >= 0; i--) {
+        Node& node = nodes_[i];
+        if (node.left == -1) {
+            setLeafBounds_(node, boxes);
+            continue;
+        }
+        const Node& l = nodes_[node.left];
+        const Node& r = nodes_[node.right];
+        node.min = lm::vec3(std::min(l.min.x, r.min.x), std::min(l.min.y, r.min.y), std::min(l.min.z, r.min.z));
+        node.max = lm::vec3(std::max(l.max.x, r.max.x), std::max(l.max.y, r.max.y), std::max(l.max.z, r.max.z));
+    }
+}
+
+void BVH::setLeafBounds_(Node& node, const std::vector<AABB>& boxes) {
+    float big = 1000000.0f;
+    node.min = lm::vec3(big, big, big);
+    node.max = lm::vec3(-big, -big, -big);
+    for (int i = node.first; i < node.first + node.count; i++) {
+        const AABB& box = boxes[items_[i]];
+        lm::vec3 b_min = box.center - box.half_width;
+        lm::vec3 b_max = box.center + box.half_width;
+        item_bounds_[i].min = b_min;
+        item_bounds_[i].max = b_max;
+        node.min = lm::vec3(std::min(node.min.x, b_min.x), std::min(node.min.y, b_min.y), std::min(node.min.z, b_min.z));
+        node.max = lm::vec3(std::max(node.max.x, b_max.x), std::max(node.max.y, b_max.y), std::max(node.max.z, b_max.z));
+    }
+}
+
+void BVH::cullFrustum(const Frustum& frustum, std::vector<int>& result) const {
+    if (nodes_.empty()) return;
+    cullNode_(0, frustum, 0x3F, result);
+}
+
+//tests box against the planes with a bit set in plane_mask. Returns -1 if box
+//is fully outside one of them, otherwise the mask of planes the box crosses
+int BVH::testPlanes_(const lm::vec3& min, const lm::vec3& max, const Frustum& frustum, int plane_mask) {
+    for (int p = 0; p < 6; p++) {
+        if (!(plane_mask & (1 << p))) continue;
+        const lm::vec4& plane = frustum.planes[p];
+
+        //corner furthest along plane normal. If it is outside, whole box is
+        float px = plane.x > 0 ? max.x : min.x;
+        float py = plane.y > 0 ? max.y : min.y;
+        float pz = plane.z > 0 ? max.z : min.z;
+        if (plane.x * px + plane.y * py + plane.z * pz + plane.w < 0) return -1;
+
+        //opposite corner. If it is inside, whole box is
+        float nx = plane.x > 0 ? min.x : max.x;
+        float ny = plane.y > 0 ? min.y : max.y;
+        float nz = plane.z > 0 ? min.z : max.z;
+        if (plane.x * nx + plane.y * ny + plane.z * nz + plane.w >= 0) plane_mask &= ~(1 << p);
+    }
+    return plane_mask;
+}
+
+//plane_mask has a bit set for each plane the node still has to be tested
+//against. Planes which fully contain a node are never tested for its children
+void BVH::cullNode_(int node_index, const Frustum& frustum, int plane_mask, std::vector<int>& result) const {
+    const Node& node = nodes_[node_index];
+
+    plane_mask = testPlanes_(node.min, node.max, frustum, plane_mask);
+    if (plane_mask == -1) return;
+
+    //fully inside frustum: accept whole subtree without visiting it
+    if (plane_mask == 0) {
+        result.insert(result.end(), items_.begin() + node.first, items_.begin() + node.first + node.count);
+        return;
+    }
+
+    //leaf: test items against the planes the leaf crosses
+    if (node.left == -1) {
+        for (int i = node.first; i < node.first + node.count; i++) {
+            if (testPlanes_(item_bounds_[i].min, item_bounds_[i].max, frustum, plane_mask) != -1)
+                result.push_back(items_[i]);
+        }
+        return;
+    }
+
+    cullNode_(node.left, frustum, plane_mask, result);
+    cullNode_(node.right, frustum, plane_mask, result);
+}
+
+void BVH::querySegment(const lm::vec3& p, const lm::vec3& q, std::vector<int>& result) const {
+    if (nodes_.empty()) return;
+    lm::vec3 d = q - p;
+
+    //median split keeps depth well under 64 for any realistic item count
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const Node& node = nodes_[stack[--stack_size]];
+        if (!segmentOverlaps_(p, d, node.min, node.max)) continue;
+
+        if (node.left == -1) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                if (segmentOverlaps_(p, d, item_bounds_[i].min, item_bounds_[i].max))
+                    result.push_back(items_[i]);
+            }
+        }
+        else {
+            stack[stack_size++] = node.right;
+            stack[stack_size++] = node.left;
+        }
+    }
+}
+
+//slab test of segment p + t*d, t in [0, 1], against box. Box is grown by a
+//small epsilon so that segments grazing a face are still reported
+bool BVH::segmentOverlaps_(const lm::vec3& p, const lm::vec3& d, const lm::vec3& min, const lm::vec3& max) {
+    const float epsilon = 0.0001f;
+    float t_min = 0.0f;
+    float t_max = 1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float start = p.value_[axis];
+        float dir = d.value_[axis];
+        float lo = min.value_[axis] - epsilon;
+        float hi = max.value_[axis] + epsilon;
+        if (fabs(dir) < 1e-12f) {
+            //parallel to slab, must start inside it
+            if (start < lo || start > hi) return false;
+            continue;
+        }
+        float inv_dir = 1.0f / dir;
+        float t1 = (lo - start) * inv_dir;
+        float t2 = (hi - start) * inv_dir;
+        if (t1 > t2) std::swap(t1, t2);
+        t_min = std::max(t_min, t1);
+        t_max = std::min(t_max, t2);
+        if (t_min > t_max) return false;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "linmath.h"
+#include <vector>
+
+//axis aligned bounding box, stored as center and half widths
+struct AABB {
+	lm::vec3 center;
+	lm::vec3 half_width;
+};
+
+//returns AABB enclosing aabb after transforming it by transform
+AABB transformAABB(const AABB& aabb, const lm::mat4& transform);
+
+//planes of a view frustum as (a, b, c, d), with normals pointing inwards,
+//so a point p is inside if a*p.x + b*p.y + c*p.z + d >= 0 for all planes
+struct Frustum {
+    lm::vec4 planes[6];
+
+    //extracts planes from a (model) view projection matrix
+    void fromViewProjection(const lm::mat4& vp);
+};
+
+// Bounding volume hierarchy over an array of AABBs
+// - nodes are stored in a flat array with children always after their parent,
+//   so refit can update all bounds with a single backwards pass
+// - every node covers a contiguous range of the internal item array, so whole
+//   subtrees can be accepted without visiting them
+// - items are referred to by their index in the array passed to build
+class BVH {
+public:
+    //builds tree top-down, splitting at the median of the longest axis
+    void build(const std::vector<AABB>& boxes);
+    //recomputes all node bounds for moved boxes, keeping the same tree
+    void refit(const std::vector<AABB>& boxes);
+
+    //appends index of every box which is at least partly inside frustum
+    void cullFrustum(const Frustum& frustum, std::vector<int>& result) const;
+    //appends index of every box touched by segment from p to q
+    void querySegment(const lm::vec3& p, const lm::vec3& q, std::vector<int>& result) const;
+
+    int getNumItems() const { return (int)items_.size(); }
+
+private:
+    struct Node {
+        lm::vec3 min;
+        lm::vec3 max;
+        int left = -1; //-1 if leaf
+        int right = -1;
+        int first = 0; //range in items_
+        int count = 0;
+    };
+    //bounds of an item, as min and max corners
+    struct ItemBounds {
+        lm::vec3 min;
+        lm::vec3 max;
+    };
+    std::vector<Node> nodes_;
+    std::vector<int> items_;
+    std::vector<ItemBounds> item_bounds_; //in same order as items_
+    std::vector<lm::vec3> centers_; //scratch for build
+
+    static const int MAX_LEAF_ITEMS = 4;
+
+    int buildNode_(const std::vector<AABB>& boxes, int first, int count);
+    void setLeafBounds_(Node& node, const std::vector<AABB>& boxes);
+    void cullNode_(int node_index, const Frustum& frustum, int plane_mask, std::vector<int>& result) const;
+    static bool segmentOverlaps_(const lm::vec3& p, const lm::vec3& d, const lm::vec3& min, const lm::vec3& max);
+    static int testPlanes_(const lm::vec3& min, const lm::vec3& max, const Frustum& frustum, int plane_mask);
+};
@@ -1,5 +1,6 @@
 #include "CollisionSystem.h"
 #include "extern.h"
+#include <algorithm>
 
 using namespace lm;
 
@@ -12,46 +13,111 @@ void CollisionSystem::update(float dt) {
     //necesary variables
     lm::vec3 col_point;
     
-    //reset all collisions every frame
+    //reset all collisions every frame. Only hot state is touched
     auto& colliders = ECS.getAllComponents<Collider>();
-    for (auto& col : colliders){
-        col.colliding = false;
-        col.collision_distance = 10000000.0f;
-        col.other = -1;
-    }
+    auto& states = ECS.getAllComponents<ColliderState>();
+    std::fill(states.begin(), states.end(), ColliderState());
+
+    //bring box bounds and tree up to date with this frame's transforms
+    updateBroadphase_(colliders);
     
-    //test ray-box collision. This works by looping over ray colliders. For each one, we loop over box colliders
-    //test collision between ray and box, updating collision distance for each collision found
+    //test ray-box collision. This works by looping over ray colliders. For each one, we ask the
+    //broadphase for the boxes its segment passes close to, and test collision with those only,
+    //updating collision distance for each collision found
     //then for future collision tests only look as far as existing stored collision distance
     for (size_t i = 0; i < colliders.size(); i++) {
         
         //if collider is ray
         if (colliders[i].collider_type == ColliderTypeRay) {
+
+            //ray in world space
+            vec3 p, direction;
+            computeRaySegment_(colliders[i], p, direction);
+
+            //candidate boxes along whole segment, tested in collider order so
+            //results are the same as testing every box
+            candidates_.clear();
+            box_bvh_.querySegment(p, p + direction * colliders[i].max_distance, candidates_);
+            std::sort(candidates_.begin(), candidates_.end());
             
-            //test all other colliders
-            for (size_t j = 0; j < colliders.size(); j++) {
+            for (int box_index : candidates_) {
+                size_t j = (size_t)boxes_[box_index].collider;
                 if (j == i) continue; // no self-test
-                
-                //if box
-                if (colliders[j].collider_type == ColliderTypeBox) {
-                    //test collision
-                    float col_distance = 0; //temp var to store distance
-                    if (intersectSegmentBox(colliders[i], //the ray
-                                            colliders[j], //the box
-                                            col_point, //reference to collision point
-                                            col_distance, //reference to collision distance
-                                            colliders[i].collision_distance)){ //only look as far as current nearest collider
-                        colliders[i].colliding = colliders[j].colliding = true;
-						colliders[i].other = (int)j; colliders[j].other = (int)i;
-                        colliders[i].collision_point = colliders[j].collision_point = col_point;
-                        colliders[i].collision_distance = colliders[j].collision_distance = col_distance;
-                    }
+
+                //only look as far as current nearest collider
+                float test_distance = (colliders[i].max_distance < states[i].collision_distance ?
+                                       colliders[i].max_distance : states[i].collision_distance);
+                vec3 q = p + direction * test_distance;
+
+                //test collision
+                float col_distance = 0; //temp var to store distance
+                if (intersectSegmentCorners_(p, q, boxes_[box_index].corners, col_point, col_distance)) {
+                    states[i].colliding = states[j].colliding = true;
+					states[i].other = (int)j; states[j].other = (int)i;
+                    states[i].collision_point = states[j].collision_point = col_point;
+                    states[i].collision_distance = states[j].collision_distance = col_distance;
                 }
             }
         }
     }
 }
 
+//keeps boxes_ and box_bvh_ in sync with the box colliders. Tree is rebuilt if
+//colliders were added, removed or changed type, otherwise only boxes that
+//moved or were resized are recomputed, and the tree refitted
+void CollisionSystem::updateBroadphase_(std::vector<Collider>& colliders) {
+    box_ids_.clear();
+    for (size_t i = 0; i < colliders.size(); i++) {
+        if (colliders[i].collider_type == ColliderTypeBox) box_ids_.push_back((int)i);
+    }
+
+    bool rebuild = !box_bvh_valid_ || box_bvh_version_ != ECS.structure_version || box_ids_.size() != boxes_.size();
+    for (size_t k = 0; k < box_ids_.size() && !rebuild; k++) {
+        if (boxes_[k].collider != box_ids_[k]) rebuild = true;
+    }
+    if (rebuild) {
+        boxes_.resize(box_ids_.size());
+        box_aabbs_.resize(box_ids_.size());
+    }
+
+    bool refit = false;
+    for (size_t k = 0; k < boxes_.size(); k++) {
+        BoxCache& cache = boxes_[k];
+        Collider& box = colliders[box_ids_[k]];
+        TransformWorld& transform = ECS.getComponentFromEntity<TransformWorld>(box.owner);
+        if (!rebuild && !transform.world_changed &&
+            cache.local_center.x == box.local_center.x && cache.local_center.y == box.local_center.y &&
+            cache.local_center.z == box.local_center.z && cache.local_halfwidth.x == box.local_halfwidth.x &&
+            cache.local_halfwidth.y == box.local_halfwidth.y && cache.local_halfwidth.z == box.local_halfwidth.z)
+            continue;
+
+        cache.collider = box_ids_[k];
+        cache.local_center = box.local_center;
+        cache.local_halfwidth = box.local_halfwidth;
+        computeBoxCorners_(box, cache.corners);
+
+        //world aabb is bounds of the eight corners
+        vec3 min = cache.corners[0], max = cache.corners[0];
+        for (int c = 1; c < 8; c++) {
+            const vec3& v = cache.corners[c];
+            min = vec3(std::min(min.x, v.x), std::min(min.y, v.y), std::min(min.z, v.z));
+            max = vec3(std::max(max.x, v.x), std::max(max.y, v.y), std::max(max.z, v.z));
+        }
+        box_aabbs_[k].center = (min + max) * 0.5f;
+        box_aabbs_[k].half_width = (max - min) * 0.5f;
+        refit = true;
+    }
+
+    if (rebuild) {
+        box_bvh_.build(box_aabbs_);
+        box_bvh_version_ = ECS.structure_version;
+        box_bvh_valid_ = true;
+    }
+    else if (refit) {
+        box_bvh_.refit(box_aabbs_);
+    }
+}
+
 // Calculates whether a Ray collider (treated as a segment with a finite distance)
 // collides with a box collider.
 // - ray: reference to ray collider object
@@ -64,97 +130,87 @@ bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3
     // - transform ray and box into world space and apply any offsets
     // - create six planes of box
     // - calculate collision of ray with each plane
-    // note that there is an inherent optimization in that the intersectSegmentQuad
-    // function already discards cases where ray points in same direction as quad
-    // normal, so in fact we only test collisions for maximum 3 faces
-    
-    //get model matrices
-    Transform& ray_model = ECS.getComponentFromEntity<Transform>(ray.owner);
-    Transform& box_model = ECS.getComponentFromEntity<Transform>(box.owner);
-    //get reference to all transforms in ECS, for world pos calculations
-    std::vector<Transform>& all_transforms = ECS.getAllComponents<Transform>();
     
     //*** TRANSFORM BOX TO WORLD ***//
-    //get world matrices from scene graph
-    mat4 box_global = box_model.getGlobalMatrix(all_transforms);
+    vec3 corners[8];
+    computeBoxCorners_(box, corners);
+    
+    //*** TRANSFORM RAY TO WORLD ***//
+    vec3 p, q;
+    computeRaySegment_(ray, p, q);
+    
+    //now scale q by max distance to get segment size - safe to do this as direction was normalized
+    float test_distance = (ray.max_distance < max_distance ? ray.max_distance : max_distance);
+    q = q * test_distance;
+    
+    //so far q was DIRECTION (length = ray.max_distance), now make it POINT from p
+    q = p + q;
+
+    return intersectSegmentCorners_(p, q, corners, col_point, col_distance);
+}
+
+//gets the eight corners of a box collider in world space
+void CollisionSystem::computeBoxCorners_(Collider& box, lm::vec3* corners) {
+    //get cached world matrix from scene graph
+    const mat4& box_global = ECS.getComponentFromEntity<TransformWorld>(box.owner).world_matrix;
     
     //get each corner of box in local space
     float x = box.local_halfwidth.x;
     float y = box.local_halfwidth.y;
     float z = box.local_halfwidth.z;
     vec3 off = box.local_center;
-    vec3 a( -x,   y,  z);
-    vec3 b( -x,  -y,  z);
-    vec3 c(  x,  -y,  z);
-    vec3 d(  x,   y,  z);
-    vec3 e( -x,   y,  -z);
-    vec3 f( -x,  -y,  -z);
-    vec3 g(  x,  -y,  -z);
-    vec3 h(  x,   y,  -z);
-    
-    //move center
-    a = a + off; b = b + off; c = c + off; d = d + off;
-    e = e + off; f = f + off; g = g + off; h = h + off;
+    corners[0] = vec3( -x,   y,  z); //a
+    corners[1] = vec3( -x,  -y,  z); //b
+    corners[2] = vec3(  x,  -y,  z); //c
+    corners[3] = vec3(  x,   y,  z); //d
+    corners[4] = vec3( -x,   y,  -z); //e
+    corners[5] = vec3( -x,  -y,  -z); //f
+    corners[6] = vec3(  x,  -y,  -z); //g
+    corners[7] = vec3(  x,   y,  -z); //h
     
-    //multiply by model matrix
-    a = box_global * a; b = box_global * b; c = box_global * c; d = box_global * d;
-    e = box_global * e; f = box_global * f; g = box_global * g; h = box_global * h;
-    
-    
-    //*** TRANSFORM RAY TO WORLD ***//
-    mat4 ray_global = ray_model.getGlobalMatrix(all_transforms);
+    //move center and multiply by model matrix
+    for (int i = 0; i < 8; i++)
+        corners[i] = corners[i] + off;
+    lm::transformPoints(box_global, corners, corners, 8);
+}
+
+//gets start point p and direction of a ray collider in world space. direction
+//is unit length in the ray's local space, so can be scaled by a distance
+void CollisionSystem::computeRaySegment_(Collider& ray, lm::vec3& p, lm::vec3& direction) {
+    mat4 ray_global = ECS.getComponentFromEntity<TransformWorld>(ray.owner).world_matrix;
     
     //translate the center of ray locally before applying global positionthen get position
     ray_global.translateLocal(ray.local_center.x, ray.local_center.y, ray.local_center.z);
-    vec3 p = ray_global.position();
+    p = ray_global.position();
     
     //direction is more complex as we must rotate the it without translation or scale
     //To do this we muts multiply the direction by the InverseTranspose of the global model
     //setting translation component to zero first. This is similar to the normal matrix in a shader
     mat4 inv = ray_global;
     inv.m[12] = 0.0; inv.m[13] = 0.0; inv.m[14] = 0.0;
-    inv.inverse();
+    inv.inverseAffine();
     mat4 inv_trans = inv.transpose();
-    vec3 q = inv_trans * ray.direction.normalize(); //normalize direction as there's no guarantee it's length = 1!
-    
-    //now scale q by max distance to get segment size - safe to do this as direction was normalized
-    float test_distance = (ray.max_distance < max_distance ? ray.max_distance : max_distance);
-    q = q * test_distance;
-    
-    //so far q was DIRECTION (length = ray.max_distance), now make it POINT from p
-    q = p + q;
-    
-    //now do tests
+    direction = inv_trans * ray.direction.normalize(); //normalize direction as there's no guarantee it's length = 1!
+}
+
+//tests segment pq against the six faces of a box given by its world corners
+//(order a-h), and sets collision point and its distance from p
+bool CollisionSystem::intersectSegmentCorners_(lm::vec3 p, lm::vec3 q, const lm::vec3* corners, lm::vec3& col_point, float& col_distance) {
+    const vec3& a = corners[0]; const vec3& b = corners[1]; const vec3& c = corners[2]; const vec3& d = corners[3];
+    const vec3& e = corners[4]; const vec3& f = corners[5]; const vec3& g = corners[6]; const vec3& h = corners[7];
+
+    //note that there is an inherent optimization in that the intersectSegmentQuad
+    //function already discards cases where ray points in same direction as quad
+    //normal, so in fact we only test collisions for maximum 3 faces
     //quads are:
     //abcd; dcgh, hgfe, efba, adhe, bfgc
-    bool abcd = intersectSegmentQuad(p, q, a, b, c, d, col_point);
-    if (abcd) {
-        col_distance = (ray_global.position()-col_point).length();
-        return true;
-    }
-    bool dcgh = intersectSegmentQuad(p, q, d, c, g, h, col_point);
-    if (dcgh) {
-        col_distance = (ray_global.position()-col_point).length();
-        return true;
-    }
-    bool hgfe = intersectSegmentQuad(p, q, h, g, f, e, col_point);
-    if (hgfe) {
-        col_distance = (ray_global.position()-col_point).length();
-        return true;
-    }
-    bool efba = intersectSegmentQuad(p, q, e, f, b, a, col_point);
-    if (efba) {
-        col_distance = (ray_global.position()-col_point).length();
-        return true;
-    }
-    bool adhe = intersectSegmentQuad(p, q, a, d, h, e, col_point);
-    if (adhe) {
-        col_distance = (ray_global.position()-col_point).length();
-        return true;
-    }
-    bool bfgc = intersectSegmentQuad(p, q, b, f, g, c, col_point);
-    if (bfgc) {
-        col_distance = (ray_global.position()-col_point).length();
+    if (intersectSegmentQuad(p, q, a, b, c, d, col_point) ||
+        intersectSegmentQuad(p, q, d, c, g, h, col_point) ||
+        intersectSegmentQuad(p, q, h, g, f, e, col_point) ||
+        intersectSegmentQuad(p, q, e, f, b, a, col_point) ||
+        intersectSegmentQuad(p, q, a, d, h, e, col_point) ||
+        intersectSegmentQuad(p, q, b, f, g, c, col_point)) {
+        col_distance = (p - col_point).length();
         return true;
     }
     
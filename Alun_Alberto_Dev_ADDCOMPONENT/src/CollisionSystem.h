@@ -1,6 +1,7 @@
 #pragma once
 #include "includes.h"
 #include "Components.h"
+#include "BVH.h"
 
 class CollisionSystem {
 public:
@@ -13,5 +14,26 @@ public:
     
     //LINE not segment
     bool intersectLineQuad(lm::vec3 p, lm::vec3 q, lm::vec3 a, lm::vec3 b, lm::vec3 c, lm::vec3 d, lm::vec3& r);
+
+private:
+    //broadphase: BVH over world bounds of all box colliders
+    struct BoxCache {
+        int collider; //index in collider array
+        lm::vec3 local_center; //values corners were computed with
+        lm::vec3 local_halfwidth;
+        lm::vec3 corners[8]; //world space, in order a-h used by intersectSegmentBox
+    };
+    std::vector<BoxCache> boxes_;
+    std::vector<AABB> box_aabbs_; //world aabb of each entry in boxes_
+    std::vector<int> box_ids_; //scratch, collider index of every box
+    std::vector<int> candidates_; //scratch, result of broadphase query
+    BVH box_bvh_;
+    unsigned int box_bvh_version_ = 0; //ECS structure version tree was built for
+    bool box_bvh_valid_ = false;
+
+    void updateBroadphase_(std::vector<Collider>& colliders);
+    void computeBoxCorners_(Collider& box, lm::vec3* corners);
+    void computeRaySegment_(Collider& ray, lm::vec3& p, lm::vec3& direction);
+    bool intersectSegmentCorners_(lm::vec3 p, lm::vec3 q, const lm::vec3* corners, lm::vec3& col_point, float& col_distance);
 };
 
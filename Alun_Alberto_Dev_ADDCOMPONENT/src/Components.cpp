@@ -48,15 +48,10 @@ void Transform::Load(rapidjson::Value & entity, int ent_id) {
     auto jr = entity["transform"]["rotation"].GetArray();
     auto js = entity["transform"]["scale"].GetArray();
 
-    lm::vec3 rotate; rotate.x = jr[0].GetFloat(); rotate.y = jr[1].GetFloat(); rotate.z = jr[2].GetFloat();
-    lm::quat qR(rotate.x*DEG2RAD, rotate.y*DEG2RAD, rotate.z*DEG2RAD);
-    lm::mat4 R;
-    R.rotateLocal(rotate.x*DEG2RAD, lm::vec3(1, 0, 0));
-    R.rotateLocal(rotate.y*DEG2RAD, lm::vec3(0, 1, 0));
-    R.rotateLocal(rotate.z*DEG2RAD, lm::vec3(0, 0, 1));
-    this->set(*this * R);
-    this->scaleLocal(js[0].GetFloat(), js[1].GetFloat(), js[2].GetFloat());
-    this->translate(jt[0].GetFloat(), jt[1].GetFloat(), jt[2].GetFloat());
+    applySceneTransform(*this,
+                        lm::vec3(jt[0].GetFloat(), jt[1].GetFloat(), jt[2].GetFloat()),
+                        lm::vec3(jr[0].GetFloat(), jr[1].GetFloat(), jr[2].GetFloat()),
+                        lm::vec3(js[0].GetFloat(), js[1].GetFloat(), js[2].GetFloat()));
 }
 
 void Transform::debugRender() {
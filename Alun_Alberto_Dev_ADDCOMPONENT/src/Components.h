@@ -14,9 +14,19 @@
 //    - add it as a subtemplate of typetoint() and increment 'result' variable
 //    - increment NUM_TYPE_COMPONENTS
 //
+//    Fields which are read or written every frame by a few systems (hot) can be
+//    split from the rest of a component (cold) into a struct of their own. Hot
+//    structs are stored in arrays parallel to their component's array, so loops
+//    which only touch hot fields stream through less memory. TO ADD ONE:
+//    - add its vector at the end of the ComponentArrays tuple
+//    - give it the same type2int result as its component
+//    - map the component to it in hot_fields
+//    It is then accessed like a component, e.g. ECS.getComponentFromEntity<TransformWorld>(id)
+//
 #pragma once
 #include "includes.h"
 #include <vector>
+#include <type_traits>
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
 /**** COMPONENTS ****/
@@ -39,20 +49,48 @@ struct Component {
 };
 
 // Transform Component
-// - inherits a mat4 which represents a model matrix
-// - all_transform - reference to vector of all transforms
+// - inherits a mat4 which represents a local model matrix
+// - parent - index of parent transform in ECS array, -1 if root
+// world matrices are in the hot TransformWorld with the same index
 struct Transform : public Component, public lm::mat4 {
     int parent = -1;
-    lm::mat4 getGlobalMatrix(std::vector<Transform>& transforms) {
-        if (parent != - 1){
-            return transforms.at(parent).getGlobalMatrix(transforms) * *this;
-        }
-        else return *this;
-    }
+
+    //local matrix and parent used for last world_matrix, so that TransformSystem
+    //can detect local edits without every caller having to flag them
+    lm::mat4 cached_local;
+    int cached_parent = -2;
 
     void Save(rapidjson::Document& json, rapidjson::Value & entity);
     void Load(rapidjson::Value & entity, int ent_id);
     void debugRender();
+
+    //applies transform of a scene file to matrix: rotation in degrees (local,
+    //around x then y then z), then scale, then translation. Also used by the
+    //cooker to compile scenes, so must stay inline
+    static void applySceneTransform(lm::mat4& matrix, const lm::vec3& translation,
+                                    const lm::vec3& rotation, const lm::vec3& scale) {
+        lm::mat4 R;
+        R.rotateLocal(rotation.x*DEG2RAD, lm::vec3(1, 0, 0));
+        R.rotateLocal(rotation.y*DEG2RAD, lm::vec3(0, 1, 0));
+        R.rotateLocal(rotation.z*DEG2RAD, lm::vec3(0, 0, 1));
+        matrix.set(matrix * R);
+        matrix.scaleLocal(scale.x, scale.y, scale.z);
+        matrix.translate(translation.x, translation.y, translation.z);
+    }
+};
+
+//hot fields of Transform, written by TransformSystem
+// - world_matrix - cached global matrix, updated once per simulation step.
+//   Read this for simulation
+// - world_changed - true if world_matrix was recomputed in the last update
+// - render_matrix - world matrix blended between the last two simulation steps,
+//   for drawing. render_changed is true if it changed this frame
+struct TransformWorld {
+    lm::mat4 world_matrix;
+    lm::mat4 prev_world_matrix;
+    lm::mat4 render_matrix;
+    bool world_changed = true;
+    bool render_changed = true;
 };
 
 // Mesh Component
@@ -141,18 +179,11 @@ struct Collider : public Component {
     lm::vec3 local_halfwidth; // for box
     lm::vec3 direction; // for ray
     float max_distance; // for segment
-
-                        //collision state
-    bool colliding;
-    int other;
-    lm::vec3 collision_point;
-    float collision_distance;
+    //collision state is in the hot ColliderState with the same index
 
     Collider() {
         local_halfwidth = lm::vec3(0.5, 0.5, 0.5); //default dimensions = 1 in each axis
         max_distance = 10000000.0f; //infinite ray by default
-        colliding = false; // not colliding
-        other = -1; //no other collider
     }
 
     void Save(rapidjson::Document& json, rapidjson::Value & entity);
@@ -160,6 +191,14 @@ struct Collider : public Component {
     void debugRender();
 };
 
+//hot fields of Collider: collision state, reset and written by CollisionSystem every frame
+struct ColliderState {
+    bool colliding = false;
+    int other = -1; //index of other collider, -1 if none
+    lm::vec3 collision_point;
+    float collision_distance = 10000000.0f;
+};
+
 /**** COMPONENT STORAGE ****/
 struct comp_rotator;
 struct comp_elevator;
@@ -171,7 +210,10 @@ std::vector<Camera>,
 std::vector<Light>,
 std::vector<Collider>,
 std::vector<comp_rotator>,
-std::vector<comp_elevator>
+std::vector<comp_elevator>,
+//hot field groups, after all components
+std::vector<TransformWorld>,
+std::vector<ColliderState>
 > ComponentArrays;
 
 //way of mapping different types to an integer value i.e.
@@ -185,18 +227,41 @@ template<> struct type2int<Light> { enum { result = 3 }; };
 template<> struct type2int<Collider> { enum { result = 4 }; };
 template<> struct type2int<comp_rotator> { enum { result = 5 }; };
 template<> struct type2int<comp_elevator> { enum { result = 6 }; };
-//UPDATE THIS!
+//hot field groups share the index of their component
+template<> struct type2int<TransformWorld> { enum { result = 0 }; };
+template<> struct type2int<ColliderState> { enum { result = 4 }; };
+//UPDATE THIS! (components only)
 const int NUM_TYPE_COMPONENTS = 7;
 
+//hot field group of a component, void if it has none
+template< typename T >
+struct hot_fields { typedef void type; };
+template<> struct hot_fields<Transform> { typedef TransformWorld type; };
+template<> struct hot_fields<Collider> { typedef ColliderState type; };
+
 /**** ENTITY ****/
 
+//Entity handles are 32 bits: the low bits store the slot of the entity in the
+//ECS entities array, the high bits store the generation of that slot. The generation
+//is incremented every time the slot is freed, so handles to destroyed entities
+//can be detected even after the slot has been reused
+typedef uint32_t EntityHandle;
+const int ENTITY_INDEX_BITS = 20;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const uint32_t ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+const EntityHandle INVALID_ENTITY_HANDLE = 0xFFFFFFFF;
+
 struct Entity {
-    //name is used to store entity
+    //name is used to store entity. Change it with ECS.renameEntity
     std::string name;
     //array of handles into ECM component arrays
     int components[NUM_TYPE_COMPONENTS];
     //sets active or not
     bool active = true;
+    //false when the entity has been destroyed and its slot is in the free list
+    bool alive = true;
+    //generation of this slot, see EntityHandle
+    uint32_t generation = 0;
     
     Entity() {
         for (int i = 0; i < NUM_TYPE_COMPONENTS; i++) { components[i] = -1;}
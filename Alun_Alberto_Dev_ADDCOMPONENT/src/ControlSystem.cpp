@@ -5,6 +5,7 @@
 void ControlSystem::init() {
 	//set all keys and buttons to 0
 	for (int i = 0; i < GLFW_KEY_LAST; i++) input[i] = 0;
+	mouse = { 0, 0, 0, 0 };
 }
 
 //called from hardware input (via game)
@@ -15,19 +16,21 @@ void ControlSystem::key_mouse_callback(int key_button, int action, int mods) {
 
 }
 
-//called from hardware input (via game)
+//called from hardware input (via game). Movement adds up until the next
+//simulation step uses it, as a frame may run no steps or several
 void ControlSystem::updateMousePosition(int new_x, int new_y) {
 
-	mouse.delta_x = new_x - mouse.x;
-	mouse.delta_y = new_y - mouse.y;
+	mouse.delta_x += new_x - mouse.x;
+	mouse.delta_y += new_y - mouse.y;
 	mouse.x = new_x;
 	mouse.y = new_y;
 }
 
-//called once per frame
+//called once per simulation step
 void ControlSystem::update(float dt) {
 
     updateFree(dt);
+    mouse.delta_x = mouse.delta_y = 0;
 
 	//check if switch to Debug cam
 	if (input[GLFW_KEY_O] == true) {
@@ -43,6 +46,7 @@ void ControlSystem::update(float dt) {
 //update an entity with a free movement control component 
 void ControlSystem::updateFree(float dt) {
 
+	if (ECS.main_camera == -1) return;
 	Camera& camera = ECS.getComponentInArray<Camera>(ECS.main_camera);
 	Transform& transform = ECS.getComponentFromEntity<Transform>(camera.owner);
 
@@ -1,6 +1,8 @@
 #include "DebugSystem.h"
 #include "extern.h"
 #include "Parsers.h"
+#include "render/RenderDevice.h"
+#include "Profiler.h"
 
 DebugSystem::~DebugSystem() {
 
@@ -48,7 +50,11 @@ void DebugSystem::setActive(bool a) {
 
 //called once per frame
 void DebugSystem::update(float dt) {
+    PROFILE_SCOPE("DebugSystem::update");
     
+    //nothing to draw from without a camera
+    if (ECS.main_camera == -1) return;
+
     //get the camera view projection matrix
     lm::mat4 vp = ECS.getComponentInArray<Camera>(ECS.main_camera).view_projection;
     
@@ -56,24 +62,24 @@ void DebugSystem::update(float dt) {
     if (draw_grid_ || draw_frustra_) {
     
         //use line shader to draw all lines and boxes
-        glUseProgram(grid_shader_->program);
-        GLint u_mvp = glGetUniformLocation(grid_shader_->program, "u_mvp");
-        GLint u_color = glGetUniformLocation(grid_shader_->program, "u_color");
-        GLint u_color_mod = glGetUniformLocation(grid_shader_->program, "u_color_mod");
-        GLint u_size_scale = glGetUniformLocation(grid_shader_->program, "u_size_scale");
-        GLint u_center_mod = glGetUniformLocation(grid_shader_->program, "u_center_mod");
+        GPU->state.useProgram(grid_shader_->program);
+        GLint u_mvp = GPU->state.getUniformLocation(grid_shader_->program, "u_mvp");
+        GLint u_color = GPU->state.getUniformLocation(grid_shader_->program, "u_color");
+        GLint u_color_mod = GPU->state.getUniformLocation(grid_shader_->program, "u_color_mod");
+        GLint u_size_scale = GPU->state.getUniformLocation(grid_shader_->program, "u_size_scale");
+        GLint u_center_mod = GPU->state.getUniformLocation(grid_shader_->program, "u_center_mod");
         
 
     
         if (draw_grid_) {
             //set uniforms and draw grid
-            glUniformMatrix4fv(u_mvp, 1, GL_FALSE, vp.m);
-            glUniform3fv(u_color, 4, grid_colors);
-            glUniform3f(u_size_scale, 1.0, 1.0, 1.0);
-            glUniform3f(u_center_mod, 0.0, 0.0, 0.0);
-            glUniform1i(u_color_mod, 0);
-            glBindVertexArray(grid_vao_); //GRID
-            glDrawElements(GL_LINES, grid_num_indices, GL_UNSIGNED_INT, 0);
+            GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, vp.m);
+            GPU->state.uniform3fv(u_color, 4, grid_colors);
+            GPU->state.uniform3f(u_size_scale, 1.0, 1.0, 1.0);
+            GPU->state.uniform3f(u_center_mod, 0.0, 0.0, 0.0);
+            GPU->state.uniform1i(u_color_mod, 0);
+            GPU->state.bindVertexArray(grid_vao_); //GRID
+            GPU->drawElements(GL_LINES, grid_num_indices, GL_UNSIGNED_INT, 0);
         }
         
         if (draw_frustra_) {
@@ -89,10 +95,10 @@ void DebugSystem::update(float dt) {
                 lm::mat4 mvp =  vp * cam_ivp;
                 
                 //set uniforms and draw cube
-                glUniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
-                glUniform1i(u_color_mod, 1); //set color to index 1 (red)
-                glBindVertexArray(cube_vao_); //CUBE
-                glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+                GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
+                GPU->state.uniform1i(u_color_mod, 1); //set color to index 1 (red)
+                GPU->state.bindVertexArray(cube_vao_); //CUBE
+                GPU->drawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
             }
         }    
 
@@ -101,9 +107,9 @@ void DebugSystem::update(float dt) {
             auto& colliders = ECS.getAllComponents<Collider>();
             for (auto& cc : colliders) {
                 //get transform for collider
-                Transform& tc = ECS.getComponentFromEntity<Transform>(cc.owner);
+                TransformWorld& tc = ECS.getComponentFromEntity<TransformWorld>(cc.owner);
                 //get the colliders local model matrix in order to draw correctly
-                lm::mat4 collider_matrix = tc.getGlobalMatrix(ECS.getAllComponents<Transform>());
+                lm::mat4 collider_matrix = tc.render_matrix;
 
                 if (cc.collider_type == ColliderTypeBox) {
 
@@ -115,10 +121,10 @@ void DebugSystem::update(float dt) {
                     lm::mat4 mvp = vp * collider_matrix;
 
                     //set uniforms and draw
-                    glUniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
-                    glUniform1i(u_color_mod, 2); //set color to index 2 (green)
-                    glBindVertexArray(cube_vao_); //CUBE
-                    glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+                    GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
+                    GPU->state.uniform1i(u_color_mod, 2); //set color to index 2 (green)
+                    GPU->state.bindVertexArray(cube_vao_); //CUBE
+                    GPU->drawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
                 }
 
                 if (cc.collider_type == ColliderTypeRay) {
@@ -148,13 +154,13 @@ void DebugSystem::update(float dt) {
 
                     //set uniforms
                     lm::mat4 mvp = vp * collider_matrix;
-                    glUniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
+                    GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp.m);
                     //set color to index 2 (green)
-                    glUniform1i(u_color_mod, 3);
+                    GPU->state.uniform1i(u_color_mod, 3);
 
                     //bind the cube vao
-                    glBindVertexArray(collider_ray_vao_);
-                    glDrawElements(GL_LINES, 2, GL_UNSIGNED_INT, 0);
+                    GPU->state.bindVertexArray(collider_ray_vao_);
+                    GPU->drawElements(GL_LINES, 2, GL_UNSIGNED_INT, 0);
                 }
             }
         }
@@ -162,23 +168,22 @@ void DebugSystem::update(float dt) {
 
     if (draw_icons_) {
         //switch to icon shader
-        glUseProgram(icon_shader_->program);
+        GPU->state.useProgram(icon_shader_->program);
         
         //get uniforms
-        GLint u_mvp = glGetUniformLocation(icon_shader_->program, "u_mvp");
-        GLint u_icon = glGetUniformLocation(icon_shader_->program, "u_icon");
-        glUniform1i(u_icon, 0);
+        GLint u_mvp = GPU->state.getUniformLocation(icon_shader_->program, "u_mvp");
+        GLint u_icon = GPU->state.getUniformLocation(icon_shader_->program, "u_icon");
+        GPU->state.uniform1i(u_icon, 0);
         
         
         //for each light - bind light texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, icon_light_texture_);
+        GPU->state.bindTexture(0, GL_TEXTURE_2D, icon_light_texture_);
     
         auto& lights = ECS.getAllComponents<Light>();
         for (auto& curr_light : lights) {
-            Transform& curr_light_transform = ECS.getComponentFromEntity<Transform>(curr_light.owner);
+            TransformWorld& curr_light_transform = ECS.getComponentFromEntity<TransformWorld>(curr_light.owner);
 
-            lm::mat4 mvp_matrix = vp * curr_light_transform.getGlobalMatrix(ECS.getAllComponents<Transform>());;
+            lm::mat4 mvp_matrix = vp * curr_light_transform.render_matrix;
             //BILLBOARDS
             //the mvp for the light contains rotation information. We want it to look at the camera always.
             //So we zero out first three columns of matrix, which contain the rotation information
@@ -187,31 +192,30 @@ void DebugSystem::update(float dt) {
             for (int i = 12; i < 16; i++) bill_matrix.m[i] = mvp_matrix.m[i];
             
             //send this new matrix as the MVP
-            glUniformMatrix4fv(u_mvp, 1, GL_FALSE, bill_matrix.m);
-            glBindVertexArray(icon_vao_);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, bill_matrix.m);
+            GPU->state.bindVertexArray(icon_vao_);
+            GPU->drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         }
         
         //bind camera texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, icon_camera_texture_);
+        GPU->state.bindTexture(0, GL_TEXTURE_2D, icon_camera_texture_);
         
         //for each camera, exactly the same but with camera texture
         auto& cameras = ECS.getAllComponents<Camera>();
         for (auto& curr_camera : cameras) {
-            Transform& curr_cam_transform = ECS.getComponentFromEntity<Transform>(curr_camera.owner);
-            lm::mat4 mvp_matrix = vp * curr_cam_transform.getGlobalMatrix(ECS.getAllComponents<Transform>());
+            TransformWorld& curr_cam_transform = ECS.getComponentFromEntity<TransformWorld>(curr_camera.owner);
+            lm::mat4 mvp_matrix = vp * curr_cam_transform.render_matrix;
             
             // billboard as above
             lm::mat4 bill_matrix;
             for (int i = 12; i < 16; i++) bill_matrix.m[i] = mvp_matrix.m[i];
-            glUniformMatrix4fv(u_mvp, 1, GL_FALSE, bill_matrix.m);
-            glBindVertexArray(icon_vao_);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            GPU->state.uniformMatrix4fv(u_mvp, 1, GL_FALSE, bill_matrix.m);
+            GPU->state.bindVertexArray(icon_vao_);
+            GPU->drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
             
         }
     }
-    glBindVertexArray(0);
+    GPU->state.bindVertexArray(0);
 }
 
 ///////////////////////////////////////////////
@@ -224,29 +228,29 @@ void DebugSystem::createIcon_() {
     GLfloat icon_vertices[12]{-is, -is, 0, is, -is, 0, is, is, 0, -is, is, 0};
     GLfloat icon_uvs[8]{ 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
     GLuint icon_indices[6]{ 0, 1, 2, 0, 2, 3 };
-    glGenVertexArrays(1, &icon_vao_);
-    glBindVertexArray(icon_vao_);
+    GPU->genVertexArrays(1, &icon_vao_);
+    GPU->state.bindVertexArray(icon_vao_);
     GLuint vbo;
     //positions
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,  sizeof(icon_vertices), icon_vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER,  sizeof(icon_vertices), icon_vertices, GL_STATIC_DRAW);
+    GPU->enableVertexAttribArray(0);
+    GPU->vertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
     //uvs
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(icon_uvs), icon_uvs, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER, sizeof(icon_uvs), icon_uvs, GL_STATIC_DRAW);
+    GPU->enableVertexAttribArray(1);
+    GPU->vertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
     //indices
     GLuint ibo;
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(icon_indices), icon_indices, GL_STATIC_DRAW);
+    GPU->genBuffers(1, &ibo);
+    GPU->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    GPU->bufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(icon_indices), icon_indices, GL_STATIC_DRAW);
     //unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
+    GPU->state.bindVertexArray(0);
 }
 
 void DebugSystem::createRay_() {
@@ -254,23 +258,23 @@ void DebugSystem::createRay_() {
     GLfloat icon_vertices[8]{ 0, 0, 0, 0,
         0, 0, 1, 0 };
     GLuint icon_indices[2]{ 0, 1 };
-    glGenVertexArrays(1, &collider_ray_vao_);
-    glBindVertexArray(collider_ray_vao_);
+    GPU->genVertexArrays(1, &collider_ray_vao_);
+    GPU->state.bindVertexArray(collider_ray_vao_);
     GLuint vbo;
     //positions
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(icon_vertices), icon_vertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER, sizeof(icon_vertices), icon_vertices, GL_STATIC_DRAW);
+    GPU->enableVertexAttribArray(0);
+    GPU->vertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     //indices
     GLuint ibo;
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(icon_indices), icon_indices, GL_STATIC_DRAW);
+    GPU->genBuffers(1, &ibo);
+    GPU->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    GPU->bufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(icon_indices), icon_indices, GL_STATIC_DRAW);
     //unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
+    GPU->state.bindVertexArray(0);
 }
 
 void DebugSystem::createCube_() {
@@ -294,22 +298,22 @@ void DebugSystem::createCube_() {
         5,1, 6,2, //right
     };
     
-    glGenVertexArrays(1, &cube_vao_);
-    glBindVertexArray(cube_vao_);
+    GPU->genVertexArrays(1, &cube_vao_);
+    GPU->state.bindVertexArray(cube_vao_);
     
     GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_buffer_data), quad_vertex_buffer_data, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER, sizeof(quad_vertex_buffer_data), quad_vertex_buffer_data, GL_STATIC_DRAW);
+    GPU->enableVertexAttribArray(0);
+    GPU->vertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_index_buffer_data), quad_index_buffer_data, GL_STATIC_DRAW);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_index_buffer_data), quad_index_buffer_data, GL_STATIC_DRAW);
     
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GPU->state.bindVertexArray(0);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 //creates the debug grid for our scene
@@ -367,24 +371,24 @@ void DebugSystem::createGrid_() {
     grid_num_indices = num_indices;
     
     //gl buffers
-    glGenVertexArrays(1, &grid_vao_);
-    glBindVertexArray(grid_vao_);
+    GPU->genVertexArrays(1, &grid_vao_);
+    GPU->state.bindVertexArray(grid_vao_);
     GLuint vbo;
     //positions
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, grid_vertices.size() * sizeof(float), &(grid_vertices[0]), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER, grid_vertices.size() * sizeof(float), &(grid_vertices[0]), GL_STATIC_DRAW);
+    GPU->enableVertexAttribArray(0);
+    GPU->vertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     
     //indices
     GLuint ibo;
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(grid_line_indices), grid_line_indices, GL_STATIC_DRAW);
+    GPU->genBuffers(1, &ibo);
+    GPU->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    GPU->bufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(grid_line_indices), grid_line_indices, GL_STATIC_DRAW);
     
     //unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
+    GPU->state.bindVertexArray(0);
 }
 
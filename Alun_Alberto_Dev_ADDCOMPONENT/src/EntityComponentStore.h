@@ -3,8 +3,10 @@
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <algorithm>
 #include "components/comp_rotator.h"
 #include "components/comp_elevator.h"
+#include "JobSystem.h"
 using namespace std;
 
 /**** ENTITY COMPONENT STORE ****/
@@ -13,7 +15,8 @@ using namespace std;
 //all the entities, and an array to store each of the component types
 struct EntityComponentStore {
     
-    //vector of all entities
+    //vector of all entities. Slots of destroyed entities stay in the vector
+    //(with alive = false) until they are reused by createEntity
     vector<Entity> entities;
     
     ComponentArrays components; // defined at bottom of Components.h
@@ -21,32 +24,91 @@ struct EntityComponentStore {
     //create Entity and add transform component by default
     //return array id of new entity
     int createEntity(string name) {
-        entities.emplace_back(name);
-        createComponentForEntity<Transform>((int)entities.size() - 1);
-        return (int)entities.size() - 1;
+        int entity_id;
+        if (!free_entities_.empty()) {
+            //reuse the most recently freed slot, keeping its generation
+            entity_id = free_entities_.back();
+            free_entities_.pop_back();
+            Entity& ent = entities[entity_id];
+            ent.name = name;
+            ent.active = true;
+            ent.alive = true;
+        }
+        else {
+            assert(entities.size() < ENTITY_INDEX_MASK);
+            entities.emplace_back(name);
+            entity_id = (int)entities.size() - 1;
+        }
+        addEntityName_(entity_id);
+        createComponentForEntity<Transform>(entity_id);
+        return entity_id;
+    }
+
+    //destroys entity and all its components. Component arrays are kept dense
+    //by moving the last component of each array into the freed slot.
+    //Children of the entity are detached from it and become root transforms.
+    //The entity slot is recycled, and all handles to it become invalid
+    void destroyEntity(int entity_id) {
+        Entity& ent = entities[entity_id];
+        if (!ent.alive) return;
+
+        removeAllComponents_(entity_id);
+        removeEntityName_(entity_id);
+
+        ent.alive = false;
+        ent.name = "";
+        ent.generation = (ent.generation + 1) & ENTITY_GENERATION_MASK;
+        free_entities_.push_back(entity_id);
     }
 
-	//returns id of entity
-	int getEntity(string name) {
-		for (size_t i = 0; i < entities.size(); i++)
-			if (entities[i].name == name) return (int)i;
-		return -1;
+    //returns a generational handle which can be stored to refer to the entity
+    EntityHandle getEntityHandle(int entity_id) {
+        return (entities[entity_id].generation << ENTITY_INDEX_BITS) | (uint32_t)entity_id;
+    }
+
+    //returns id of entity referred to by handle, or -1 if it has been destroyed
+    int getEntityFromHandle(EntityHandle handle) {
+        const uint32_t entity_id = handle & ENTITY_INDEX_MASK;
+        if (entity_id >= entities.size()) return -1;
+        const Entity& ent = entities[entity_id];
+        if (!ent.alive || ent.generation != (handle >> ENTITY_INDEX_BITS)) return -1;
+        return (int)entity_id;
+    }
+
+    bool isEntityValid(EntityHandle handle) {
+        return getEntityFromHandle(handle) != -1;
+    }
+
+	//returns id of entity, or -1 if there is none with that name.
+	//If several entities share the name, the one with the lowest id is returned
+	int getEntity(const string& name) {
+		auto it = entity_names_.find(name);
+		if (it == entity_names_.end()) return -1;
+		return it->second.front();
+	}
+
+	//changes the name of an entity. Always use this rather than writing
+	//Entity::name directly, so that getEntity can still find it
+	void renameEntity(int entity_id, const string& name) {
+		removeEntityName_(entity_id);
+		entities[entity_id].name = name;
+		addEntityName_(entity_id);
 	}
 
     //returns id of entity
     void update(float dt) {
 
         auto& meshes = getAllComponents<Mesh>();
-        auto& lights = getAllComponents<Light>();
-        auto& colliders = getAllComponents<Collider>();
         auto& rotators = getAllComponents<comp_rotator>();
 		auto& elevators = getAllComponents<comp_elevator>();
         //auto& tags = getAllComponents<Tag>();
 
-        for (auto& light : lights) light.update(dt);
-        for (auto& col : colliders) col.update(dt);
+        //lights and colliders have nothing to update. Each elevator only moves
+        //its own transform, so they are split across worker threads
         for (auto& rot : rotators) rot.update(dt);
-		for (auto& elev : elevators) elev.update(dt);
+        JobSystem::get().parallelFor((int)elevators.size(), 64, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) elevators[i].update(dt);
+        });
         //for (auto& tag : tags) tag.update(dt);
     }
     
@@ -68,6 +130,7 @@ struct EntityComponentStore {
         vector<T>& the_vec = get<vector<T>>(components);
         // add a new object at back of vector
         the_vec.emplace_back();
+        addHotFields_<T>();
         // return index of new object in vector
         return (int)the_vec->size() - 1;
     }
@@ -79,6 +142,7 @@ struct EntityComponentStore {
         vector<T>& the_vec = get<vector<T>>(components);
         // add a new object at back of vector
         the_vec.emplace_back();
+        addHotFields_<T>();
         
         //get index type of ComponentType
         const int type_index = type2int<T>::result;
@@ -89,10 +153,37 @@ struct EntityComponentStore {
         //set owner of component to entity
         Component& new_comp = the_vec.back();
         new_comp.owner = entity_id;
+
+        structure_version++;
         
         return the_vec.back(); // return pointer to new component
     }
     
+    //removes the component of type T from an entity, if it has one.
+    //The last component of the array is moved into the freed position (swap and
+    //pop) so the array stays dense, and its owner is updated with the new index.
+    //Hot fields of the component are moved the same way
+    template<typename T>
+    void removeComponentFromEntity(int entity_id) {
+        //get index type of ComponentType
+        const int type_index = type2int<T>::result;
+        const int comp_index = entities[entity_id].components[type_index];
+        if (comp_index == -1) return;
+
+        vector<T>& the_vec = get<vector<T>>(components);
+        const int last_index = (int)the_vec.size() - 1;
+        if (comp_index != last_index) {
+            the_vec[comp_index] = the_vec[last_index];
+            entities[the_vec[comp_index].owner].components[type_index] = comp_index;
+        }
+        the_vec.pop_back();
+        removeHotFields_<T>(comp_index, last_index);
+        entities[entity_id].components[type_index] = -1;
+        structure_version++;
+
+        fixComponentReferences_((T*)nullptr, comp_index, last_index);
+    }
+
     //return reference to component at id in array
     template<typename T>
     T& getComponentInArray(int an_id) {
@@ -174,7 +265,87 @@ struct EntityComponentStore {
     std::vector<T>& getAllComponents() {
         return get<vector<T>>(components);
     }
-    //stores main camera id
+    //stores main camera id. -1 while there is none (e.g. its entity was
+    //destroyed), which every reader must check for
     int main_camera = -1;
-    
+
+    //incremented whenever a component is added or removed, so that systems
+    //which cache data about the component arrays know when to rebuild it
+    unsigned int structure_version = 0;
+
+private:
+    //slots of destroyed entities, ready to be reused
+    vector<int> free_entities_;
+
+    //name -> ids of all alive entities with that name, sorted by id
+    unordered_map<string, vector<int>> entity_names_;
+
+    void addEntityName_(int entity_id) {
+        vector<int>& ids = entity_names_[entities[entity_id].name];
+        ids.insert(std::lower_bound(ids.begin(), ids.end(), entity_id), entity_id);
+    }
+
+    void removeEntityName_(int entity_id) {
+        auto it = entity_names_.find(entities[entity_id].name);
+        if (it == entity_names_.end()) return;
+        vector<int>& ids = it->second;
+        auto pos = std::lower_bound(ids.begin(), ids.end(), entity_id);
+        if (pos != ids.end() && *pos == entity_id) ids.erase(pos);
+        if (ids.empty()) entity_names_.erase(it);
+    }
+
+    //removes every type of component from an entity
+    template<std::size_t I = 0>
+    typename std::enable_if<(I == NUM_TYPE_COMPONENTS), void>::type
+        removeAllComponents_(int entity_id) {}
+
+    template<std::size_t I = 0>
+    typename std::enable_if<(I < NUM_TYPE_COMPONENTS), void>::type
+        removeAllComponents_(int entity_id)
+    {
+        typedef typename std::tuple_element<I, ComponentArrays>::type::value_type T;
+        removeComponentFromEntity<T>(entity_id);
+        removeAllComponents_<I + 1>(entity_id);
+    }
+
+    //keep the hot field array of T (if it has one) parallel to the array of T
+    template<typename T>
+    typename std::enable_if<std::is_void<typename hot_fields<T>::type>::value, void>::type
+        addHotFields_() {}
+
+    template<typename T>
+    typename std::enable_if<!std::is_void<typename hot_fields<T>::type>::value, void>::type
+        addHotFields_() {
+        getAllComponents<typename hot_fields<T>::type>().emplace_back();
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_void<typename hot_fields<T>::type>::value, void>::type
+        removeHotFields_(int removed, int moved_from) {}
+
+    template<typename T>
+    typename std::enable_if<!std::is_void<typename hot_fields<T>::type>::value, void>::type
+        removeHotFields_(int removed, int moved_from) {
+        auto& hot = getAllComponents<typename hot_fields<T>::type>();
+        if (removed != moved_from) hot[removed] = hot[moved_from];
+        hot.pop_back();
+    }
+
+    //some components are referred to by their index in the component array.
+    //After a removal, 'removed' no longer exists and whatever was at 'moved_from'
+    //is now at 'removed' (if they are equal, nothing was moved)
+    template<typename T>
+    void fixComponentReferences_(T*, int removed, int moved_from) {}
+
+    void fixComponentReferences_(Transform*, int removed, int moved_from) {
+        for (auto& transform : getAllComponents<Transform>()) {
+            if (transform.parent == removed) transform.parent = -1;
+            else if (transform.parent == moved_from) transform.parent = removed;
+        }
+    }
+
+    void fixComponentReferences_(Camera*, int removed, int moved_from) {
+        if (main_camera == removed) main_camera = -1;
+        else if (main_camera == moved_from) main_camera = removed;
+    }
 };
@@ -9,6 +9,8 @@
 #include "extern.h"
 #include "Parsers.h"
 #include "render/RenderToTexture.h"
+#include "Profiler.h"
+#include <cmath>
 
 Game* Game::game_instance = nullptr;
 
@@ -16,6 +18,7 @@ Game::Game() {
 
     assert(game_instance == nullptr);
     game_instance = this;
+    fps = 0;
 }
 
 int createFree(float aspect, ControlSystem& sys) {
@@ -38,12 +41,20 @@ int createFree(float aspect, ControlSystem& sys) {
 //Nothing here yet
 void Game::init(int window_width, int window_height) {
 
+    window_width_ = window_width;
+    window_height_ = window_height;
+
 	//******* INIT SYSTEMS *******
 
+    //worker threads used by scheduler and systems
+    JobSystem::get().init();
+
 	//init systems except debug, which needs info about scene
 	control_system_.init();
+    transform_system_.init();
 	graphics_system_.init(window_width_, window_height_);
     editor_system_.Init();
+    if (headless_) editor_system_.SetEditorStatus(false);
 
     //******** AUTOMATIC LOADING **********//
     
@@ -87,51 +98,95 @@ void Game::init(int window_width, int window_height) {
 	createFree((float)window_width_ / (float)window_height_, control_system_);
 
     //******* INIT DEBUG SYSTEM *******
-    graphics_system_.lateInit();
     debug_system_.init();
     debug_system_.setActive(true);
 
     main_buffer = new RenderToTexture("main_buffer", window_width, window_height);
+
+    addSystemsToScheduler_();
+    addPassesToPipeline_();
+
+    //world matrices for first frame, which may come before first step
+    transform_system_.update(0.0f);
 }
 
 //Entry point for game update code
+//Simulation runs in fixed steps of SIMULATION_DT, as many as fit in the time
+//since last frame, so gameplay doesn't depend on frame rate. Then the frame is
+//drawn with transforms blended between the last two steps
 void Game::update(float dt) {
+    PROFILE_SCOPE("Game::update");
+
+    accumulator_ += dt;
+    int steps = 0;
+    while (accumulator_ >= SIMULATION_DT && steps < MAX_SIMULATION_STEPS) {
+        //update each system, in parallel where they do not touch the same components
+        simulation_scheduler_.update(SIMULATION_DT);
+        accumulator_ -= SIMULATION_DT;
+        steps++;
+    }
+    //too far behind (e.g. after a hitch or a breakpoint): drop the time we
+    //couldn't simulate instead of trying to catch up over the next frames
+    if (accumulator_ >= SIMULATION_DT)
+        accumulator_ = fmodf(accumulator_, SIMULATION_DT);
+
+    transform_system_.interpolate(accumulator_ / SIMULATION_DT);
+    //view follows interpolated camera transform. Control sets position from
+    //transform every step, so this is overwritten before simulation reads it
+    if (ECS.main_camera != -1) {
+        Camera& cam = ECS.getComponentInArray<Camera>(ECS.main_camera);
+        cam.position = ECS.getComponentFromEntity<TransformWorld>(cam.owner).render_matrix.position();
+    }
+
+    frame_pipeline_.setSceneTarget(editor_system_.GetEditorStatus() ? main_buffer : nullptr);
+    frame_pipeline_.execute(dt);
+}
+
+//registers each system with the components it reads and writes, in the
+//order they must run. See SystemScheduler for how they are grouped. Collision
+//only reads world matrices and components only move local transforms, so the
+//two share a phase
+void Game::addSystemsToScheduler_() {
 
-	//update each system in turn
+    unsigned int transform = componentMask<Transform>();
+    unsigned int camera = componentMask<Camera>();
+    unsigned int collider = componentMask<Collider>();
+    unsigned int behaviours = componentMask<comp_rotator>() | componentMask<comp_elevator>();
 
 	//update input
-	control_system_.update(dt);
+    simulation_scheduler_.addSystem("control", RESOURCE_INPUT, transform | camera, true,
+                                    [this](float dt) { control_system_.update(dt); });
+
+    //world matrices, must run before anything reads TransformWorld
+    simulation_scheduler_.addSystem("transform", transform, transform | RESOURCE_WORLD_MATRICES, false,
+                                    [this](float dt) { transform_system_.update(dt); });
 
     //collision
-    collision_system_.update(dt);
+    simulation_scheduler_.addSystem("collision", RESOURCE_WORLD_MATRICES | collider, collider, false,
+                                    [this](float dt) { collision_system_.update(dt); });
 
-	//render
-	graphics_system_.update(dt);
-    
-    //debug
-    debug_system_.update(dt);
-
-    // Rendering modules
-    {
-        if (editor_system_.GetEditorStatus()) {
-            main_buffer->Activate();
-            graphics_system_.update(dt);
-            debug_system_.update(dt);
-            main_buffer->Deactivate();
-        }
-        else {
-            graphics_system_.update(dt);
-            debug_system_.update(dt);
-        }
-    }
+    // Components. Elevators move local transforms, which collision doesn't read
+    simulation_scheduler_.addSystem("components", transform | behaviours, transform | behaviours, false,
+                                    [](float dt) { ECS.update(dt); });
+}
 
-    // Components
-    ECS.update(dt);
+//scene and debug draw into the scene target, which is the editor viewport
+//texture while the editor is open. Editor draws to the screen
+void Game::addPassesToPipeline_() {
 
-    // Editor window
-    editor_system_.update(dt);
-   
+    frame_pipeline_.addPass("scene", FRAME_TARGET_SCENE, 0,
+                            [this](float dt) { graphics_system_.update(dt); });
+
+    frame_pipeline_.addPass("debug", FRAME_TARGET_SCENE, 0,
+                            [this](float dt) { debug_system_.update(dt); });
+
+    // Editor window, shows scene target. Needs ImGui backends, so not headless
+    if (!headless_) {
+        frame_pipeline_.addPass("editor", FRAME_TARGET_SCREEN, frameTargetMask(FRAME_TARGET_SCENE),
+                                [this](float dt) { editor_system_.update(dt); });
+    }
 }
+
 //update game viewports
 void Game::update_viewports(int window_width, int window_height) {
 
@@ -10,10 +10,18 @@
 #include "ControlSystem.h"
 #include "DebugSystem.h"
 #include "CollisionSystem.h"
+#include "TransformSystem.h"
+#include "SystemScheduler.h"
+#include "render/FramePipeline.h"
 #include "tools/EditorSystem.h"
 
 class RenderToTexture;
 
+//length of a simulation step, independent of how fast frames are rendered
+const float SIMULATION_DT = 1.0f / 60.0f;
+//most simulation steps run in one frame, so a slow frame can't snowball
+const int MAX_SIMULATION_STEPS = 5;
+
 class Game
 {
 public:
@@ -23,6 +31,9 @@ public:
 
 	Game();
     void init(int window_width, int window_height);
+    //without window: editor is disabled, so nothing calls ImGui backends
+    void setHeadless(bool headless) { headless_ = headless; }
+	//dt is real time since last frame
 	void update(float dt);
 
     static Game* game_instance;
@@ -61,10 +72,20 @@ private:
 	ControlSystem control_system_;
     DebugSystem debug_system_;
     CollisionSystem collision_system_;
+    TransformSystem transform_system_;
+    //systems run every simulation step, and passes drawn every frame
+    SystemScheduler simulation_scheduler_;
+    FramePipeline frame_pipeline_;
+    //time not yet simulated
+    float accumulator_ = 0.0f;
+
+    void addSystemsToScheduler_();
+    void addPassesToPipeline_();
     EditorSystem editor_system_;
 
 	int window_width_;
 	int window_height_;
+    bool headless_ = false;
     int mouse_x_;
     int mouse_y_;
 };
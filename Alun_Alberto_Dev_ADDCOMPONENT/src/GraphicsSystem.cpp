@@ -2,6 +2,8 @@
 //  Copyright 2018 Alun Evans. All rights reserved.
 //
 #include "GraphicsSystem.h"
+#include "MappedFile.h"
+#include "render/RenderDevice.h"
 #include "Parsers.h"
 #include "extern.h"
 #include <algorithm>
@@ -9,9 +11,13 @@
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
 #include <fstream>
+#include <cstddef>
+#include <cstring>
+#include "Profiler.h"
 
 std::unordered_map<std::string, int> Material::materials;
 std::unordered_map<std::string, int> Material::textures;
+std::unordered_map<std::string, MaterialFile> Material::files;
 std::unordered_map<std::string, int> Geometry::geometries;
 
 //destructor
@@ -21,91 +27,48 @@ GraphicsSystem::~GraphicsSystem() {
 		if (shader_pair.second)
 			delete shader_pair.second;
 	}
+    if (instance_vbo_) GPU->deleteBuffers(1, &instance_vbo_);
+    if (frame_ubo_) GPU->deleteBuffers(1, &frame_ubo_);
+    if (material_ubo_) GPU->deleteBuffers(1, &material_ubo_);
 }
 
 //set initial state of graphics system
 void GraphicsSystem::init(int window_width, int window_height) {
     //set 'background' colour of framebuffer
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glViewport(0, 0, window_width, window_height);
+    GPU->clearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	GPU->viewport(0, 0, window_width, window_height);
     //enable culling and depth test
-    glEnable(GL_DEPTH_TEST);
-
-    glEnable(GL_CULL_FACE); //enable culling
-    glCullFace(GL_BACK); //which face to cull
-}
-
-//called after loading everything
-void GraphicsSystem::lateInit() {
-
-	//sort meshes by shader and material
-    sortMeshes_();
+    GPU->enable(GL_DEPTH_TEST);
+
+    GPU->enable(GL_CULL_FACE); //enable culling
+    GPU->cullFace(GL_BACK); //which face to cull
+
+    //frame uniform block stays bound to its binding point
+    GPU->genBuffers(1, &frame_ubo_);
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, frame_ubo_);
+    GPU->bufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    GPU->state.bindBufferBase(GL_UNIFORM_BUFFER, UB_FRAME, frame_ubo_);
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    //materials are bound by range, and each range must start at an aligned offset
+    GLint alignment = 256;
+    GPU->getIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0) alignment = 256;
+    material_block_stride_ = ((GLint)sizeof(MaterialBlock) + alignment - 1) / alignment * alignment;
+    GPU->genBuffers(1, &material_ubo_);
 }
 
 void GraphicsSystem::updateMainViewport(int window_width, int window_height) {
-	glViewport(0, 0, window_width, window_height);
+	GPU->viewport(0, 0, window_width, window_height);
 }
 
 
-//This function executes two sorts:
-// i) sorts materials array by shader_id
-// ii) sorts Mesh components by material id
-//the result is that the mesh component array is
-//ordered by both shader and material
-void GraphicsSystem::sortMeshes_(){
-   
-    //sort materials by shader id
-    //first we store the old index of each material in materials_ array
-    for (size_t i = 0; i < materials_.size(); i++)
-        materials_[i].index = (int)i; // 'index' is a new property of Material
-    
-    //second, we sort materials by shader_id
-    std::sort(materials_.begin(), materials_.end(), [](const Material& a, const Material& b) {
-        return a.shader_id < b.shader_id;
-    });
-    
-    //now we map old indices to new indices
-    std::map<int, int> old_new;
-    for (size_t i = 0; i < materials_.size(); i++){
-        old_new[materials_[i].index] = (int)i;
-    }
-    
-    //now we swap index of materials in all meshes
-    auto& meshes = ECS.getAllComponents<Mesh>();
-    for (auto& mesh : meshes) {
-        int old_index = mesh.material;
-        int new_index = old_new[old_index];
-        mesh.material = new_index;
-    }
-    
-    //store old mesh indices
-    for (size_t i = 0; i < meshes.size(); i++)
-        meshes[i].index = (int)i;
-
-    //short meshes by material id
-    std::sort(meshes.begin(), meshes.end(), [](const Mesh& a, const Mesh& b) {
-        return a.material < b.material;
-    });
-    
-    //clear map and refill with mesh index map
-    old_new.clear();
-    for (size_t i = 0; i < meshes.size(); i++) {
-        old_new[meshes[i].index] = (int)i;
-    }
-    
-    //update all entities with new mesh id
-    auto& all_entities = ECS.entities;
-    for (auto& ent : ECS.entities) {
-        int old_index = ent.components[type2int<Mesh>::result];
-        int new_index = old_new[old_index];
-        ent.components[type2int<Mesh>::result] = new_index;
-    }
-}
-
 void GraphicsSystem::checkShaderAndMaterial(Mesh& mesh) {
     //get shader id from material. if same, don't change
+    //new shader has none of the material uniforms set, so force them too
     if (!shader_ || shader_->program != materials_[mesh.material].shader_id) {
 		useShader(materials_[mesh.material].shader_id);
+        current_material_ = -1;
     }
     //set material uniforms if required
     if (current_material_ != mesh.material) {
@@ -115,12 +78,13 @@ void GraphicsSystem::checkShaderAndMaterial(Mesh& mesh) {
 }
 
 void GraphicsSystem::update(float dt) {
+    PROFILE_SCOPE("GraphicsSystem::update");
     
-    //set initial OpenGL state
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    //reset shader and material
-    useShader((GLuint)0);
+    //target was bound and cleared by frame pipeline
+
+    //reset shader and material, as other passes change program. If it is
+    //still the same, state cache drops the bind
+    shader_ = nullptr;
     current_material_ = -1;
     
 	//update cameras
@@ -128,91 +92,320 @@ void GraphicsSystem::update(float dt) {
 	for (auto &cam : cameras) cam.update();
 
 	auto& mesh_components = ECS.getAllComponents<Mesh>();
-	for (auto &mesh : mesh_components) {
-        checkShaderAndMaterial(mesh);
-		renderMeshComponent_(mesh);
-	}
+
+    //release materials no longer used by any mesh
+    updateMaterialRefs_(mesh_components);
+
+    //next levels of textures still loading, before anything samples them
+    texture_streamer_.update();
+
+    //uniform blocks shared by all shaders
+    uploadFrameBlock_();
+    if (materials_dirty_) uploadMaterialBlocks_();
+
+    //find meshes inside camera frustum
+    cullMeshes_(mesh_components);
+
+    //group visible meshes which share shader, material and geometry, and stream the
+    //matrices of all of them to the instance buffer in a single upload
+    buildInstanceGroups_(mesh_components);
+    uploadInstanceData_(mesh_components);
+
+    PROFILE_SCOPE("GraphicsSystem draw");
+    for (auto& group : instance_groups_) {
+        auto instanced = instanced_shaders_.find(group.shader_id);
+        if (instanced != instanced_shaders_.end()) {
+            renderInstanceGroup_(group, instanced->second);
+        }
+        else {
+            //no instanced version of shader, draw meshes one by one
+            for (int i = group.first; i < group.first + group.count; i++) {
+                Mesh& mesh = mesh_components[draw_list_[i]];
+                checkShaderAndMaterial(mesh);
+                renderMeshComponent_(mesh);
+            }
+        }
+    }
+    GPU->state.bindVertexArray(0);
+}
+
+//updates world space bounds of meshes, and fills visible_meshes_ with the
+//meshes touching the main camera frustum, using a BVH over all meshes
+void GraphicsSystem::cullMeshes_(std::vector<Mesh>& meshes) {
+    PROFILE_SCOPE("GraphicsSystem::cullMeshes_");
+
+    //rebuild tree if mesh components were added, removed or reordered,
+    //otherwise only recompute bounds of meshes which moved and refit
+    bool rebuild = !mesh_bvh_valid_ || mesh_bvh_version_ != ECS.structure_version;
+    bool refit = false;
+    mesh_world_aabbs_.resize(meshes.size());
+    mesh_aabb_geometry_.resize(meshes.size(), -1);
+    for (size_t i = 0; i < meshes.size(); i++) {
+        TransformWorld& transform = ECS.getComponentFromEntity<TransformWorld>(meshes[i].owner);
+        if (!rebuild && !transform.render_changed && mesh_aabb_geometry_[i] == meshes[i].geometry)
+            continue;
+        mesh_world_aabbs_[i] = transformAABB(geometries_[meshes[i].geometry].aabb, transform.render_matrix);
+        mesh_aabb_geometry_[i] = meshes[i].geometry;
+        refit = true;
+    }
+    if (rebuild) {
+        mesh_bvh_.build(mesh_world_aabbs_);
+        mesh_bvh_version_ = ECS.structure_version;
+        mesh_bvh_valid_ = true;
+    }
+    else if (refit) {
+        mesh_bvh_.refit(mesh_world_aabbs_);
+    }
+
+    //hierarchical test against main camera frustum. Bounds are still kept up
+    //to date without one, as refits only see what moved since the last frame
+    visible_meshes_.clear();
+    if (ECS.main_camera == -1) {
+        meshes_visible_ = 0;
+        meshes_culled_ = (int)meshes.size();
+        return;
+    }
+    Camera& cam = ECS.getComponentInArray<Camera>(ECS.main_camera);
+    Frustum frustum;
+    frustum.fromViewProjection(cam.view_projection);
+    mesh_bvh_.cullFrustum(frustum, visible_meshes_);
+
+    meshes_visible_ = (int)visible_meshes_.size();
+    meshes_culled_ = (int)meshes.size() - meshes_visible_;
+}
+
+//sorts visible meshes into draw_list_ by shader, material, geometry and
+//distance to camera, using render_queue_, and stores each run of meshes
+//sharing shader, material and geometry as an instance group
+void GraphicsSystem::buildInstanceGroups_(std::vector<Mesh>& meshes) {
+    PROFILE_SCOPE("GraphicsSystem::buildInstanceGroups_");
+
+    //nothing is visible without a camera
+    if (ECS.main_camera == -1) {
+        draw_list_.clear();
+        instance_groups_.clear();
+        return;
+    }
+
+    //distances are scaled by furthest mesh, so depth keeps all its key bits
+    Camera& cam = ECS.getComponentInArray<Camera>(ECS.main_camera);
+    mesh_distances_.resize(visible_meshes_.size());
+    float max_distance = 0.0f;
+    for (size_t i = 0; i < visible_meshes_.size(); i++) {
+        mesh_distances_[i] = (mesh_world_aabbs_[visible_meshes_[i]].center - cam.position).length();
+        if (mesh_distances_[i] > max_distance) max_distance = mesh_distances_[i];
+    }
+    float depth_scale = max_distance > 0.0f ? 1.0f / max_distance : 0.0f;
+
+    render_queue_.clear();
+    for (size_t i = 0; i < visible_meshes_.size(); i++) {
+        const Mesh& mesh = meshes[visible_meshes_[i]];
+        uint64_t key = RenderQueue::makeKey(DRAW_PASS_OPAQUE, getShaderSortId_(materials_[mesh.material].shader_id),
+                                            mesh.material, mesh.geometry, mesh_distances_[i] * depth_scale);
+        render_queue_.push(key, visible_meshes_[i]);
+    }
+    render_queue_.sort();
+
+    draw_list_.resize(render_queue_.size());
+    const std::vector<DrawItem>& draws = render_queue_.getItems();
+    for (size_t i = 0; i < draws.size(); i++)
+        draw_list_[i] = draws[i].item;
+
+    instance_groups_.clear();
+    for (int i = 0; i < (int)draw_list_.size(); i++) {
+        const Mesh& mesh = meshes[draw_list_[i]];
+        int shader_id = materials_[mesh.material].shader_id;
+        if (!instance_groups_.empty()) {
+            InstanceGroup& last = instance_groups_.back();
+            if (last.shader_id == shader_id && last.material == mesh.material && last.geometry == mesh.geometry) {
+                last.count++;
+                continue;
+            }
+        }
+        InstanceGroup group = { shader_id, mesh.material, mesh.geometry, i, 1 };
+        instance_groups_.push_back(group);
+    }
+}
+
+//small number for shader in sort keys, as program ids may be any value
+int GraphicsSystem::getShaderSortId_(int shader_id) {
+    auto it = shader_sort_ids_.find(shader_id);
+    if (it != shader_sort_ids_.end()) return it->second;
+    int sort_id = (int)shader_sort_ids_.size();
+    shader_sort_ids_[shader_id] = sort_id;
+    return sort_id;
+}
+
+//fills per instance matrices of all groups which are drawn instanced, and
+//uploads them to the instance buffer. Entry i matches draw_list_[i]
+void GraphicsSystem::uploadInstanceData_(std::vector<Mesh>& meshes) {
+    PROFILE_SCOPE("GraphicsSystem::uploadInstanceData_");
+    instance_data_.resize(draw_list_.size());
+
+    bool any_instanced = false;
+    for (auto& group : instance_groups_) {
+        if (instanced_shaders_.find(group.shader_id) == instanced_shaders_.end()) continue;
+        any_instanced = true;
+
+        for (int i = group.first; i < group.first + group.count; i++) {
+            TransformWorld& transform = ECS.getComponentFromEntity<TransformWorld>(meshes[draw_list_[i]].owner);
+            InstanceData& instance = instance_data_[i];
+            //model matrix
+            instance.model = transform.render_matrix;
+            //normal matrix
+            instance.normal_matrix = instance.model;
+            instance.normal_matrix.inverseAffine();
+            instance.normal_matrix.transpose();
+        }
+    }
+    if (!any_instanced) return;
+
+    if (!instance_vbo_) GPU->genBuffers(1, &instance_vbo_);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    //grow if needed. Otherwise reallocating same size orphans the old storage,
+    //so we don't stall waiting for last frame's draws to finish reading it
+    if (instance_data_.size() > instance_vbo_capacity_)
+        instance_vbo_capacity_ = instance_data_.size();
+    GPU->bufferData(GL_ARRAY_BUFFER, instance_vbo_capacity_ * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    GPU->bufferSubData(GL_ARRAY_BUFFER, 0, instance_data_.size() * sizeof(InstanceData), instance_data_.data());
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//draws all meshes of a group with one instanced call
+void GraphicsSystem::renderInstanceGroup_(const InstanceGroup& group, Shader* instanced_shader) {
+    Geometry& geom = geometries_[group.geometry];
+
+    //new shader has none of the material uniforms set, so force them too
+    if (shader_ != instanced_shader) {
+        useShader(instanced_shader);
+        current_material_ = -1;
+    }
+    if (current_material_ != group.material) {
+        current_material_ = group.material;
+        setMaterialUniforms();
+    }
+
+    //camera is in frame block, model and normal matrices come from instance buffer
+
+    //point the instance attributes of geometry's vao at this group's slice
+    //of the instance buffer, unless they still do from last time it was drawn.
+    //A mat4 attribute takes four vec4 locations
+    GPU->state.bindVertexArray(geom.vao);
+    size_t offset = group.first * sizeof(InstanceData);
+    if (geom.instance_offset != offset) {
+        geom.instance_offset = offset;
+        setInstanceAttributes_(offset);
+    }
+
+    GPU->drawElementsInstanced(GL_TRIANGLES, geom.num_tris * 3, geom.index_type, 0, group.count);
+}
+
+//points instance attributes of bound vao at instance buffer, from offset
+void GraphicsSystem::setInstanceAttributes_(size_t offset) {
+    GPU->bindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    for (GLuint c = 0; c < 4; c++) {
+        size_t column = c * 4 * sizeof(float);
+        GPU->enableVertexAttribArray(3 + c);
+        GPU->vertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offset + offsetof(InstanceData, model) + column));
+        GPU->vertexAttribDivisor(3 + c, 1);
+        GPU->enableVertexAttribArray(7 + c);
+        GPU->vertexAttribPointer(7 + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offset + offsetof(InstanceData, normal_matrix) + column));
+        GPU->vertexAttribDivisor(7 + c, 1);
+    }
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 //sets uniforms for current material and current shader
 void GraphicsSystem::setMaterialUniforms() {
     Material& mat = materials_[current_material_];
-    
-    //material uniforms
-    /*GLint u_ambient = glGetUniformLocation(current_shader_->program, "u_ambient");
-    if (u_ambient != -1) glUniform3fv(u_ambient, 1, mat.ambient.value_);*/
-	shader_->setUniform(U_AMBIENT, mat.ambient);
-    
-    /*GLint u_diffuse = glGetUniformLocation(shader_->program, "u_diffuse");
-    if (u_diffuse != -1) glUniform3fv(u_diffuse, 1, mat.diffuse.value_);*/
-	shader_->setUniform(U_DIFFUSE, mat.diffuse);
-    
-    /*GLint u_specular = glGetUniformLocation(shader_->program, "u_specular");
-    if (u_specular != -1) glUniform3fv(u_specular, 1, mat.specular.value_);*/
-	shader_->setUniform(U_SPECULAR, mat.specular);
-    
-    //GLint u_specular_gloss = glGetUniformLocation(shader_->program, "u_specular_gloss");
-    //if (u_specular_gloss != -1) glUniform1f(u_specular_gloss, 200.0f); //...1f - for float
-	shader_->setUniform(U_SPECULAR_GLOSS, mat.specular_gloss);
-    
-    //texture uniforms
-    //GLint u_diffuse_map = glGetUniformLocation(shader_->program, "u_diffuse_map");
-    //if (u_diffuse_map != -1) glUniform1i(u_diffuse_map, 0); // ...1i - is integer
-    //glActiveTexture(GL_TEXTURE0);
-    //glBindTexture(GL_TEXTURE_2D, mat.diffuse_map);
 
+    //material parameters are already in material buffer, just point shader at them
+    if (shader_->hasUniformBlock(UB_MATERIAL)) {
+        GPU->state.bindBufferRange(GL_UNIFORM_BUFFER, UB_MATERIAL, material_ubo_,
+                          (GLintptr)current_material_ * material_block_stride_, sizeof(MaterialBlock));
+    }
+    else {
+        shader_->setUniform(U_AMBIENT, mat.ambient);
+        shader_->setUniform(U_DIFFUSE, mat.diffuse);
+        shader_->setUniform(U_SPECULAR, mat.specular);
+        shader_->setUniform(U_SPECULAR_GLOSS, mat.specular_gloss);
+    }
+
+    //texture uniforms
     if (mat.diffuse_map != -1)
         shader_->setTexture(U_DIFFUSE_MAP, mat.diffuse_map, 0);
+}
 
-    
-    //light uniforms
-    const std::vector<Light>& lights = ECS.getAllComponents<Light>();  // get number of lights in scene from ECM
-    
-    GLint u_num_lights = glGetUniformLocation(shader_->program, "u_num_lights"); //get/set uniform in shader
-    if (u_num_lights != -1) glUniform1i(u_num_lights, (int)lights.size());
-    
-    //for each light
-    for (size_t i = 0; i < lights.size(); i++) {
-        //get light transform
+//fills frame block with main camera and all lights
+void GraphicsSystem::uploadFrameBlock_() {
+    PROFILE_SCOPE("GraphicsSystem::uploadFrameBlock_");
+    FrameBlock frame;
+    memset(&frame, 0, sizeof(frame));
+
+    if (ECS.main_camera != -1) {
+        Camera& cam = ECS.getComponentInArray<Camera>(ECS.main_camera);
+        memcpy(frame.view_projection, cam.view_projection.m, sizeof(frame.view_projection));
+        memcpy(frame.cam_pos, cam.position.value_, 3 * sizeof(float));
+    }
+
+    const std::vector<Light>& lights = ECS.getAllComponents<Light>();
+    int num_lights = (int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+    for (int i = 0; i < num_lights; i++) {
         Transform& light_transform = ECS.getComponentFromEntity<Transform>(lights[i].owner);
-        
-        //position
-        std::string light_position_name = "lights[" + std::to_string(i) + "].position"; // create dynamic uniform name
-        GLint u_light_pos = glGetUniformLocation(shader_->program, light_position_name.c_str()); //find it
-        if (u_light_pos != -1) glUniform3fv(u_light_pos, 1, light_transform.position().value_); // light position
-        
-        //color
-        std::string light_color_name = "lights[" + std::to_string(i) + "].color";
-        GLint u_light_col = glGetUniformLocation(shader_->program, light_color_name.c_str());
-        if (u_light_col != -1) glUniform3fv(u_light_col, 1, lights[i].color.value_);
+        memcpy(frame.lights[i].position, light_transform.position().value_, 3 * sizeof(float));
+        memcpy(frame.lights[i].color, lights[i].color.value_, 3 * sizeof(float));
+    }
+    frame.num_lights = num_lights;
+
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, frame_ubo_);
+    GPU->bufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+//uploads parameters of all materials, each at an offset that can be bound by range
+void GraphicsSystem::uploadMaterialBlocks_() {
+    PROFILE_SCOPE("GraphicsSystem::uploadMaterialBlocks_");
+    std::vector<unsigned char> data(materials_.size() * material_block_stride_, 0);
+    for (size_t i = 0; i < materials_.size(); i++) {
+        const Material& mat = materials_[i];
+        MaterialBlock block;
+        memset(&block, 0, sizeof(block));
+        memcpy(block.ambient, mat.ambient.value_, 3 * sizeof(float));
+        memcpy(block.diffuse, mat.diffuse.value_, 3 * sizeof(float));
+        memcpy(block.specular, mat.specular.value_, 3 * sizeof(float));
+        block.specular_gloss = mat.specular_gloss;
+        memcpy(&data[i * material_block_stride_], &block, sizeof(block));
     }
+
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, material_ubo_);
+    GPU->bufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+    GPU->bindBuffer(GL_UNIFORM_BUFFER, 0);
+    materials_dirty_ = false;
 }
 
 //renders a given mesh component
 void GraphicsSystem::renderMeshComponent_(Mesh& comp) {
-    
+    if (ECS.main_camera == -1) return;
+
     //get transform of components entity
-    Transform& transform = ECS.getComponentFromEntity<Transform>(comp.owner);
+    TransformWorld& transform = ECS.getComponentFromEntity<TransformWorld>(comp.owner);
 	//get camera
 	Camera& cam = ECS.getComponentInArray<Camera>(ECS.main_camera);
     //get Geometry, material and textures
     Geometry& geom = geometries_[comp.geometry];
    
 	//model matrix
-	lm::mat4 model_matrix = transform.getGlobalMatrix(ECS.getAllComponents<Transform>());
+	lm::mat4 model_matrix = transform.render_matrix;
 	//Model view projection matrix
 	lm::mat4 mvp_matrix = cam.view_projection * model_matrix;
 
-	//view frustum culling
-    //if (!BBInFrustum_(geom.aabb, mvp_matrix)) {
-    //    return;
-    //}
-	
 	//std::cout << ECS.entities[comp.owner].name << "-";
 
 	//normal matrix
 	lm::mat4 normal_matrix = model_matrix;
-	normal_matrix.inverse();
+	normal_matrix.inverseAffine();
 	normal_matrix.transpose();
     
     //transform uniforms
@@ -228,17 +421,12 @@ void GraphicsSystem::renderMeshComponent_(Mesh& comp) {
 	//if (u_normal_matrix != -1) glUniformMatrix4fv(u_normal_matrix, 1, GL_FALSE, normal_matrix.m);
 	shader_->setUniform(U_NORMAL_MATRIX, normal_matrix);
 
-    //GLint u_cam_pos = glGetUniformLocation(shader_->program, "u_cam_pos");
-    //if (u_cam_pos != -1) glUniform3fv(u_cam_pos, 1, cam.position.value_); // ...3fv - is array of 3 floats
-	shader_->setUniform(U_CAM_POS, cam.position);
     
     //tell OpenGL we want to the the vao_ container with our buffers
-    glBindVertexArray(geom.vao);
+    GPU->state.bindVertexArray(geom.vao);
     //draw our geometry
-    glDrawElements(GL_TRIANGLES, geom.num_tris * 3, GL_UNSIGNED_INT, 0);
-    //tell OpenGL we don't want to use our container anymore
-    glBindVertexArray(0);
-    
+    GPU->drawElements(GL_TRIANGLES, geom.num_tris * 3, geom.index_type, 0);
+    //vao stays bound, next mesh of same geometry needs no bind
 }
 //
 ////********************************************
@@ -249,11 +437,11 @@ void GraphicsSystem::renderMeshComponent_(Mesh& comp) {
 //s - pointer to a shader object
 void GraphicsSystem::useShader(Shader* s) {
     if (!s) {
-        glUseProgram(0);
+        GPU->state.useProgram(0);
         shader_ = nullptr;
     }
     else if (!shader_ || shader_ != s){
-        glUseProgram(s->program);
+        GPU->state.useProgram(s->program);
         shader_ = s;
     }
 }
@@ -262,11 +450,11 @@ void GraphicsSystem::useShader(Shader* s) {
 //p - GL id of shader
 void GraphicsSystem::useShader(GLuint p) {
     if (!p) {
-        glUseProgram(0);
+        GPU->state.useProgram(0);
         shader_ = nullptr;
     }
     else if (!shader_ || shader_->program != p) {
-        glUseProgram(p);
+        GPU->state.useProgram(p);
         shader_ = shaders_[p];
     }
 }
@@ -288,12 +476,62 @@ Shader* GraphicsSystem::loadShader(std::string vs, std::string fs, bool compile_
 	return new_shader;
 }
 
+//registers instanced version of a shader, if it linked correctly
+void GraphicsSystem::setInstancedShader(Shader* base, Shader* instanced) {
+    GLint linked = 0;
+    GPU->getProgramiv(instanced->program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        std::cerr << "ERROR: instanced shader " << instanced->name << " did not link, using non instanced path" << std::endl;
+        return;
+    }
+    instanced_shaders_[base->program] = instanced;
+}
+
 //create a new material and return pointer to it
 int GraphicsSystem::createMaterial() {
+    materials_dirty_ = true;
+    if (!free_materials_.empty()) {
+        int mat_id = free_materials_.back();
+        free_materials_.pop_back();
+        materials_[mat_id] = Material();
+        return mat_id;
+    }
     materials_.emplace_back();
     return (int)materials_.size() - 1;
 }
 
+void GraphicsSystem::releaseMaterial(int mat_id) {
+    Material& mat = materials_.at(mat_id);
+    if (mat.ref_count > 0 && --mat.ref_count > 0) return;
+
+    auto cached = Material::materials.find(mat.name);
+    if (cached == Material::materials.end() || cached->second != mat_id) return; //not shared, so never recycled
+    Material::materials.erase(cached);
+    free_materials_.push_back(mat_id);
+}
+
+//mesh components may be destroyed anywhere, so when ECS structure changes
+//reference counts are recomputed from mesh array, and shared materials
+//no mesh uses any more are released
+void GraphicsSystem::updateMaterialRefs_(std::vector<Mesh>& meshes) {
+    PROFILE_SCOPE("GraphicsSystem::updateMaterialRefs_");
+    if (material_refs_version_ == ECS.structure_version) return;
+    material_refs_version_ = ECS.structure_version;
+
+    std::vector<int> counts(materials_.size(), 0);
+    for (auto& mesh : meshes)
+        if (mesh.material >= 0 && mesh.material < (int)counts.size()) counts[mesh.material]++;
+
+    for (size_t i = 0; i < materials_.size(); i++) {
+        if (counts[i] == 0 && materials_[i].ref_count > 0) {
+            materials_[i].ref_count = 1;
+            releaseMaterial((int)i);
+        }
+        else
+            materials_[i].ref_count = counts[i];
+    }
+}
+
 //creates a standard plane geometry and return its
 int GraphicsSystem::createPlaneGeometry(){
     
@@ -303,121 +541,161 @@ int GraphicsSystem::createPlaneGeometry(){
     uvs = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f };
     normals = { 0.0f, 0.0f, 1.0f,    0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,    0.0f, 0.0f, 1.0f };
     indices = { 0, 1, 2, 0, 2, 3 };
-    //generate the OpenGL buffers and create geometry
-    GLuint vao = generateBuffers_(vertices, uvs, normals, indices);
-    geometries_.emplace_back(vao, 2);
-    
-    return (int)geometries_.size() - 1;
+    //pack and upload like any other geometry
+    GeometryData data;
+    packGeometry_(getVertexSource_(vertices, uvs, normals), indices.data(), indices.size(), sizeof(GLuint), VertexFormat(), data);
+    return uploadGeometry(data);
 }
 
 //create geometry from
 //returns index in geometry array with stored geometry data
 int GraphicsSystem::createGeometryFromFile(std::string filename) {
-    
-    std::vector<GLfloat> vertices, uvs, normals;
-    std::vector<GLuint> indices;
+    GeometryData data;
+    if (!readGeometryFile(filename, data))
+        return -1;
+    return uploadGeometry(data);
+}
+
+//reads a geometry file and packs it in format, without any GL calls so is safe
+//to call from a worker thread
+bool GraphicsSystem::readGeometryFile(const std::string& filename, GeometryData& data, const VertexFormat& format) {
+    PROFILE_SCOPE("GraphicsSystem::readGeometryFile");
+    data.valid = false;
+    //read cooked version if there is one
+    std::string path = Parsers::getCookedFilename(filename);
     //check for supported format
-    std::string ext = filename.substr(filename.size() - 4, 4);
+    std::string ext = path.size() >= 4 ? path.substr(path.size() - 4, 4) : "";
     if (ext == ".obj" || ext == ".OBJ")
     {
         //fill it with data from object
-        if (Parsers::parseOBJ(filename, vertices, uvs, normals, indices)) {
-
-            //generate the OpenGL buffers and create geometry
-            GLuint vao = generateBuffers_(vertices, uvs, normals, indices);
-            geometries_.emplace_back(vao, (GLuint)indices.size() / 3);
-            return (int)geometries_.size() - 1;
-        }
-        else {
-            std::cerr << "ERROR: Could not parse mesh file" << std::endl;
-            return -1;
+        std::vector<GLfloat> vertices, uvs, normals;
+        std::vector<GLuint> indices;
+        if (!Parsers::parseOBJ(path, vertices, uvs, normals, indices)) {
+            std::cerr << "ERROR: Could not parse mesh file " << path << std::endl;
+            return false;
         }
+        packGeometry_(getVertexSource_(vertices, uvs, normals), indices.data(), indices.size(), sizeof(GLuint), format, data);
     }
     else if (ext == "mesh") {
-        std::cout << filename << std::endl;
-        //fill it with data from object
-        if (Parsers::parseBin(filename, vertices, uvs, normals, indices)) {
-
-            //generate the OpenGL buffers and create geometry
-            GLuint vao = generateBuffers_(vertices, uvs, normals, indices);
-            geometries_.emplace_back(vao, (GLuint)indices.size() / 3);
-            return (int)geometries_.size() - 1;
+        //map file, and pack its interleaved vertex and index chunks straight from the mapping
+        MappedFile file;
+        MeshView mesh;
+        if (!file.open(path) || !Parsers::parseBin(file, path, mesh)) {
+            std::cerr << "ERROR: Could not parse mesh file " << path << std::endl;
+            return false;
+        }
+        if (mesh.header.primitive_type != GL_TRIANGLES) {
+            std::cerr << "ERROR: Only triangle meshes are supported " << path << std::endl;
+            return false;
+        }
+        VertexLayout file_layout;
+        if (!getMeshFileLayout_(mesh.header.vertex_type_name, mesh.header.bytes_per_vtx, file_layout)) {
+            std::cerr << "ERROR: Unsupported vertex type " << mesh.header.vertex_type_name << " in " << path << std::endl;
+            return false;
+        }
+        VertexSource source;
+        source.num_vertices = mesh.header.num_vertexs;
+        bool quantized = false;
+        for (const VertexAttribute& attribute : file_layout.attributes) {
+            const unsigned char* start = mesh.vertices + attribute.offset;
+            if (attribute.location == 0) { source.positions = start; source.position_stride = file_layout.stride; }
+            if (attribute.location == 1) { source.uvs = start; source.uv_stride = file_layout.stride; }
+            if (attribute.location == 2) { source.normals = start; source.normal_stride = file_layout.stride; }
+            if (attribute.type != GL_FLOAT) quantized = true;
+        }
+        //uvs out of half float range are cooked as floats, so either layout is ours
+        VertexFormat float_uv_format = format;
+        float_uv_format.half_uvs = false;
+        if (file_layout.matches(format.getLayout(source.uvs != nullptr, source.normals != nullptr)) ||
+            file_layout.matches(float_uv_format.getLayout(source.uvs != nullptr, source.normals != nullptr))) {
+            //cooked in our format: vertices go to the GPU as they are in the file
+            data.aabb = mesh.has_aabb ? mesh.aabb : computeAABB_(source.positions, source.num_vertices, source.position_stride);
+            data.layout = file_layout;
+            data.vertices.assign(mesh.vertices, mesh.vertices + (size_t)source.num_vertices * file_layout.stride);
+            data.index_type = packIndices(mesh.indices, mesh.header.num_indices, mesh.header.bytes_per_idx,
+                                          source.num_vertices, data.indices);
+            data.num_indices = mesh.header.num_indices;
+        }
+        else if (quantized) {
+            //packVertices only reads floats
+            std::cerr << "ERROR: Mesh file was cooked for another vertex format " << path << std::endl;
+            return false;
         }
         else {
-            std::cerr << "ERROR: Could not parse mesh file" << std::endl;
-            return -1;
+            packGeometry_(source, mesh.indices, mesh.header.num_indices, mesh.header.bytes_per_idx, format, data);
         }
     }
     else {
-        std::cerr << "ERROR: Unsupported mesh format when creating geometry" << std::endl;
-        return -1;
+        std::cerr << "ERROR: Unsupported mesh format when creating geometry " << filename << std::endl;
+        return false;
     }
+    data.valid = true;
+    return true;
 }
 
-// Given an array of floats (in sets of three, representing vertices) calculates and
-// sets the AABB of a geometry
-void GraphicsSystem::setGeometryAABB_(Geometry& geom, std::vector<GLfloat>& vertices) {
-	//set very max and very min
-	float big = 1000000.0f;
-	float small = -1000000.0f;
-	lm::vec3 min(big, big, big);
-	lm::vec3 max(small, small, small);
+//source pointing at separate position, uv and normal arrays. uvs or normals
+//which don't have an entry per vertex are left out
+VertexSource GraphicsSystem::getVertexSource_(const std::vector<GLfloat>& vertices, const std::vector<GLfloat>& uvs,
+                                              const std::vector<GLfloat>& normals) {
+    VertexSource source;
+    source.num_vertices = vertices.size() / 3;
+    source.positions = (const unsigned char*)vertices.data();
+    source.position_stride = 3 * sizeof(GLfloat);
+    if (source.num_vertices && uvs.size() == source.num_vertices * 2) {
+        source.uvs = (const unsigned char*)uvs.data();
+        source.uv_stride = 2 * sizeof(GLfloat);
+    }
+    if (source.num_vertices && normals.size() == source.num_vertices * 3) {
+        source.normals = (const unsigned char*)normals.data();
+        source.normal_stride = 3 * sizeof(GLfloat);
+    }
+    return source;
+}
 
-	//for all verts, find max and min
-	for (size_t i = 0; i < vertices.size(); i += 3) {
-		float x = vertices[i];
-		float y = vertices[i + 1];
-		float z = vertices[i + 2];
+//fills data with vertices and indices packed in format, ready for upload
+void GraphicsSystem::packGeometry_(const VertexSource& source, const void* indices, size_t num_indices,
+                                   GLuint bytes_per_index, const VertexFormat& format, GeometryData& data) {
+    data.aabb = computeAABB_(source.positions, source.num_vertices, source.position_stride);
+    packVertices(source, format, data.layout, data.vertices);
+    data.index_type = packIndices(indices, num_indices, bytes_per_index, source.num_vertices, data.indices);
+    data.num_indices = (GLuint)num_indices;
+    data.valid = true;
+}
 
-		if (x < min.x) min.x = x;
-		if (y < min.y) min.y = y;
-		if (z < min.z) min.z = z;
+//creates GL buffers for geometry data packed by readGeometryFile. Must be
+//called on main thread. Releases packed data once uploaded
+int GraphicsSystem::uploadGeometry(GeometryData& data) {
+    PROFILE_SCOPE("GraphicsSystem::uploadGeometry");
+    if (!data.valid)
+        return -1;
 
-		if (x > max.x) max.x = x;
-		if (y > max.y) max.y = y;
-		if (z > max.z) max.z = z;
-	}
-	//set center and halfwidth based on max and min
-	geom.aabb.center = lm::vec3(
-		(min.x + max.x) / 2,
-		(min.y + max.y) / 2,
-		(min.z + max.z) / 2);
-	geom.aabb.half_width = lm::vec3(
-		max.x - geom.aabb.center.x,
-		max.y - geom.aabb.center.y,
-		max.z - geom.aabb.center.z);
-}
-
-//relcalculates AABB from OOB
-AABB GraphicsSystem::transformAABB_(const AABB& aabb, const lm::mat4& transform) {
-	//get aabb min and max
-	lm::vec3 aabb_min(
-		aabb.center.x - aabb.half_width.x,
-		aabb.center.y - aabb.half_width.y,
-		aabb.center.z - aabb.half_width.z);
-	lm::vec3 aabb_max(
-		aabb.center.x + aabb.half_width.x,
-		aabb.center.y + aabb.half_width.y,
-		aabb.center.z + aabb.half_width.z);
-
-	//transform min and max
-	lm::vec3 min_t = transform * aabb_min;
-	lm::vec3 max_t = transform * aabb_max;
-
-	//create array of coords for easier parsing
-	float vertices[6] = { min_t.x, min_t.y, min_t.z, max_t.x, max_t.y, max_t.z };
+    GLuint vao = generateInterleavedBuffers_(data.vertices.data(), data.vertices.size(), data.layout,
+                                             data.indices.data(), data.indices.size());
+    geometries_.emplace_back(vao, data.num_indices / 3);
+    geometries_.back().index_type = data.index_type;
+    geometries_.back().aabb = data.aabb;
+    std::vector<unsigned char>().swap(data.vertices);
+    std::vector<unsigned char>().swap(data.indices);
+    data.valid = false;
+    return (int)geometries_.size() - 1;
+}
 
+// Calculates AABB of positions in a buffer: positions points to the first x,
+// and each vertex is stride bytes apart
+AABB GraphicsSystem::computeAABB_(const unsigned char* positions, size_t num_vertices, size_t stride) {
 	//set very max and very min
 	float big = 1000000.0f;
 	float small = -1000000.0f;
 	lm::vec3 min(big, big, big);
 	lm::vec3 max(small, small, small);
 
-	//calculate new aabb based on transformed verts
-	for (int i = 0; i < 6; i += 3) {
-		float x = vertices[i];
-		float y = vertices[i + 1];
-		float z = vertices[i + 2];
+	//for all verts, find max and min
+	for (size_t i = 0; i < num_vertices; i++) {
+		float xyz[3];
+		memcpy(xyz, positions + i * stride, sizeof(xyz)); //mapped data may not be aligned
+		float x = xyz[0];
+		float y = xyz[1];
+		float z = xyz[2];
 
 		if (x < min.x) min.x = x;
 		if (y < min.y) min.y = y;
@@ -427,22 +705,19 @@ AABB GraphicsSystem::transformAABB_(const AABB& aabb, const lm::mat4& transform)
 		if (y > max.y) max.y = y;
 		if (z > max.z) max.z = z;
 	}
-
-	AABB new_aabb;
-	//set new center and halfwidth based on max and min
-	new_aabb.center = lm::vec3(
+	//set center and halfwidth based on max and min
+	AABB aabb;
+	aabb.center = lm::vec3(
 		(min.x + max.x) / 2,
 		(min.y + max.y) / 2,
 		(min.z + max.z) / 2);
-	new_aabb.half_width = lm::vec3(
-		max.x - new_aabb.center.x,
-		max.y - new_aabb.center.y,
-		max.z - new_aabb.center.z);
-
-	return new_aabb;
+	aabb.half_width = lm::vec3(
+		max.x - aabb.center.x,
+		max.y - aabb.center.y,
+		max.z - aabb.center.z);
+	return aabb;
 }
 
-
 //tests whether AABB or OOB is inside frustum or not, based on view_projection matrix
 bool GraphicsSystem::AABBInFrustum_(const AABB& aabb, const lm::mat4& to_clip) {
 	lm::vec4 points[8];
@@ -590,47 +865,90 @@ bool GraphicsSystem::BBInFrustum_(const AABB& aabb, const lm::mat4& mvp) {
 	return true;
 }
 
-//generates buffers in VRAM and returns VAO handle.
-GLuint GraphicsSystem::generateBuffers_(std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices) {
+//generates a single interleaved vertex buffer and an index buffer in VRAM, straight
+//from the given memory, and returns VAO handle
+GLuint GraphicsSystem::generateInterleavedBuffers_(const void* vertices, size_t vertices_bytes, const VertexLayout& layout,
+                                                   const void* indices, size_t indices_bytes) {
     //generate and bind vao
     GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    GPU->genVertexArrays(1, &vao);
+    GPU->state.bindVertexArray(vao);
+    //all attributes
     GLuint vbo;
-    //positions
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &(vertices[0]), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    //texture coords
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(float), &(uvs[0]), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    //normals
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), &(normals[0]), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    GPU->genBuffers(1, &vbo);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, vbo);
+    GPU->bufferData(GL_ARRAY_BUFFER, vertices_bytes, vertices, GL_STATIC_DRAW);
+    for (const VertexAttribute& attribute : layout.attributes) {
+        GPU->enableVertexAttribArray(attribute.location);
+        GPU->vertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+                              layout.stride, (void*)(size_t)attribute.offset);
+    }
     //indices
     GLuint ibo;
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &(indices[0]), GL_STATIC_DRAW);
+    GPU->genBuffers(1, &ibo);
+    GPU->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    GPU->bufferData(GL_ELEMENT_ARRAY_BUFFER, indices_bytes, indices, GL_STATIC_DRAW);
     //unbind
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GPU->bindBuffer(GL_ARRAY_BUFFER, 0);
+    GPU->state.bindVertexArray(0);
 
     return vao;
 }
 
+//fills layout of interleaved vertex from .mesh vertex type name, which lists its
+//attributes in order: Pos (3 floats), N (normal, 3 floats), Uv (2 floats),
+//T (tangent, 4 floats), and the quantised ones written by the cooker: UvH
+//(2 half floats), Nq (10-10-10-2 normal). Only first Uv is used. Fails if
+//name is unknown or does not match bytes_per_vtx
+bool GraphicsSystem::getMeshFileLayout_(const std::string& vertex_type_name, GLuint bytes_per_vtx, VertexLayout& layout) {
+    layout.attributes.clear();
+    GLuint offset = 0;
+    bool has_uv = false;
+    size_t pos = 0;
+    while (pos < vertex_type_name.size()) {
+        if (vertex_type_name.compare(pos, 3, "Pos") == 0) {
+            layout.attributes.push_back({ 0, 3, GL_FLOAT, GL_FALSE, offset });
+            offset += 3 * sizeof(float); pos += 3;
+        }
+        else if (vertex_type_name.compare(pos, 3, "UvH") == 0) {
+            if (!has_uv) layout.attributes.push_back({ 1, 2, GL_HALF_FLOAT, GL_FALSE, offset });
+            has_uv = true;
+            offset += 2 * sizeof(uint16_t); pos += 3;
+        }
+        else if (vertex_type_name.compare(pos, 2, "Uv") == 0) {
+            if (!has_uv) layout.attributes.push_back({ 1, 2, GL_FLOAT, GL_FALSE, offset });
+            has_uv = true;
+            offset += 2 * sizeof(float); pos += 2;
+        }
+        else if (vertex_type_name.compare(pos, 2, "Nq") == 0) {
+            layout.attributes.push_back({ 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset });
+            offset += sizeof(uint32_t); pos += 2;
+        }
+        else if (vertex_type_name[pos] == 'N') {
+            layout.attributes.push_back({ 2, 3, GL_FLOAT, GL_FALSE, offset });
+            offset += 3 * sizeof(float); pos += 1;
+        }
+        else if (vertex_type_name[pos] == 'T') {
+            offset += 4 * sizeof(float); pos += 1;
+        }
+        else {
+            return false;
+        }
+    }
+    //position must come first, as AABB is computed from start of each vertex
+    if (layout.attributes.empty() || layout.attributes[0].location != 0 || layout.attributes[0].offset != 0)
+        return false;
+    layout.stride = offset;
+    return offset == bytes_per_vtx;
+}
+
 int Geometry::Load(GraphicsSystem& graphics_system, rapidjson::Value & entity, int ent_id)
 {
-    auto jmesh = entity["render"]["mesh"].GetString();
+    return Load(graphics_system, entity["render"]["mesh"].GetString());
+}
 
+int Geometry::Load(GraphicsSystem& graphics_system, const std::string& jmesh)
+{
     int geo_id;
     if (geometries.find(jmesh) == geometries.end()) {
         geo_id = graphics_system.createGeometryFromFile(jmesh);
@@ -639,54 +957,80 @@ int Geometry::Load(GraphicsSystem& graphics_system, rapidjson::Value & entity, i
     else {
         geo_id = geometries[jmesh];
     }
-    graphics_system.geometries_[geo_id].name = jmesh;
+    if (geo_id != -1)
+        graphics_system.geometries_[geo_id].name = jmesh;
 
     return geo_id;
 }
 
 int Material::Load(GraphicsSystem & graphics_system, rapidjson::Value & entity, int ent_id)
 {
-
     auto jmat = entity["render"]["materials"].GetArray();
-    std::string mat_name = jmat[0].GetString();
+    return Load(graphics_system, jmat[0].GetString());
+}
 
-    std::ifstream json_file(jmat[0].GetString());
-    rapidjson::IStreamWrapper json_stream(json_file);
-    rapidjson::Document json_material;
-    json_material.ParseStream(json_stream);
+int Material::Load(GraphicsSystem & graphics_system, const std::string& mat_name)
+{
+    PROFILE_SCOPE("Material::Load");
+
+    //entities using same file share one material, so their meshes batch together
+    auto cached = materials.find(mat_name);
+    if (cached != materials.end()) {
+        graphics_system.getMaterial(cached->second).ref_count++;
+        return cached->second;
+    }
+
+    //file contents are usually already read by scene loader, read now if not
+    if (files.find(mat_name) == files.end())
+        MaterialFile::read(mat_name, files[mat_name]);
+    const MaterialFile& file = files[mat_name];
 
     int mat_id = graphics_system.createMaterial();
+    materials[mat_name] = mat_id;
+    graphics_system.getMaterial(mat_id).ref_count = 1;
     graphics_system.getMaterial(mat_id).shader_id = Parsers::shaders["phong"];
     graphics_system.getMaterial(mat_id).name = mat_name;
 
-    if (json_material.HasParseError()) std::cerr << "JSON format is not valid!" << std::endl;
-
-    if (json_material["textures"].HasMember("diffuse")) {
-        std::string tx_diff = json_material["textures"]["diffuse"].GetString();
+    if (file.diffuse_map != "") {
         int tex_id;
-        if (textures.find(tx_diff) == textures.end()) { tex_id = Parsers::parseTexture(tx_diff); textures[tx_diff] = tex_id; }
-        else { tex_id = textures[tx_diff]; }
+        if (textures.find(file.diffuse_map) == textures.end()) { tex_id = graphics_system.getTextureStreamer().request(file.diffuse_map); textures[file.diffuse_map] = tex_id; }
+        else { tex_id = textures[file.diffuse_map]; }
 
         graphics_system.getMaterial(mat_id).diffuse_map = tex_id; //assign texture id from material
     }
 
-    if (json_material["textures"].HasMember("specular")) {
-        std::string tx_spec = json_material["textures"]["specular"].GetString();
-        int tex_id = Parsers::parseTexture(tx_spec);
-        //graphics_system.getMaterial(mat_id).specular = lm::vec3(json_spec[0].GetFloat(), json_spec[1].GetFloat(), json_spec[2].GetFloat());
-    }
-    else {
+    //specular and ambient maps are not used by shaders yet, so are not loaded
+    if (!file.has_specular_map)
         graphics_system.getMaterial(mat_id).specular = lm::vec3(0, 0, 0); //no specular
-    }
 
-    if (json_material["textures"].HasMember("ambient")) {
-        std::string tx_amb = json_material["textures"]["ambient"].GetString();
-        int tex_id = Parsers::parseTexture(tx_amb);
-        //graphics_system.getMaterial(mat_id).ambient = lm::vec3(json_ambient[0].GetFloat(), json_ambient[1].GetFloat(), json_ambient[2].GetFloat());
-    }
-    else {
+    if (!file.has_ambient_map)
         graphics_system.getMaterial(mat_id).ambient = lm::vec3(0.1f, 0.1f, 0.1f); //small ambient
-    }
 
     return mat_id;
 }
+
+//reads a material json file. No GL calls, so is safe to call from a worker thread
+bool MaterialFile::read(const std::string& filename, MaterialFile& result)
+{
+    PROFILE_SCOPE("MaterialFile::read");
+    result = MaterialFile();
+
+    std::ifstream json_file(filename);
+    rapidjson::IStreamWrapper json_stream(json_file);
+    rapidjson::Document json_material;
+    json_material.ParseStream(json_stream);
+
+    if (json_material.HasParseError() || !json_material.IsObject()) {
+        std::cerr << "JSON format is not valid! " << filename << std::endl;
+        return false;
+    }
+    if (json_material.HasMember("textures") && json_material["textures"].IsObject()) {
+        rapidjson::Value& json_textures = json_material["textures"];
+        if (json_textures.HasMember("diffuse") && json_textures["diffuse"].IsString())
+            result.diffuse_map = json_textures["diffuse"].GetString();
+        result.has_specular_map = json_textures.HasMember("specular");
+        result.has_ambient_map = json_textures.HasMember("ambient");
+    }
+    result.valid = true;
+    return true;
+}
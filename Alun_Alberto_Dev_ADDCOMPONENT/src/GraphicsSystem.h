@@ -7,31 +7,57 @@
 #include "Components.h"
 #include <unordered_map>
 #include "GraphicsSystem.h"
-
-struct AABB {
-	lm::vec3 center;
-	lm::vec3 half_width;
-};
+#include "BVH.h"
+#include "MappedFile.h"
+#include "render/RenderQueue.h"
+#include "render/VertexFormat.h"
+#include "render/TextureStreamer.h"
 
 class GraphicsSystem;
 
+//geometry packed in its VRAM format, without touching GL so that it can be
+//done on any thread, then passed to GraphicsSystem::uploadGeometry on main thread
+struct GeometryData {
+    bool valid = false;
+    AABB aabb;
+    VertexLayout layout;
+    std::vector<unsigned char> vertices; //interleaved, in layout
+    std::vector<unsigned char> indices;
+    GLenum index_type = GL_UNSIGNED_INT;
+    GLuint num_indices = 0;
+};
+
 struct Geometry {
 
     std::string name;
     GLuint vao;
     GLuint num_tris;
+    GLenum index_type = GL_UNSIGNED_INT;
 	AABB aabb;
+    //offset in instance buffer the vao's instance attributes point at, -1 if none
+    size_t instance_offset = (size_t)-1;
 
     Geometry() { vao = 0; num_tris = 0;}
     Geometry(int a_vao, int a_tris) : vao(a_vao), num_tris(a_tris) {}
     static std::unordered_map<std::string, int> geometries;
 
     static int Load(GraphicsSystem& graphics_system, rapidjson::Value & entity, int ent_id);
+    //same, from path of geometry file
+    static int Load(GraphicsSystem& graphics_system, const std::string& path);
+};
+
+//contents of a .mtl file needed to create a Material, read without touching GL
+struct MaterialFile {
+    bool valid = false;
+    std::string diffuse_map; //texture path, empty if none
+    bool has_specular_map = false;
+    bool has_ambient_map = false;
+
+    static bool read(const std::string& filename, MaterialFile& result);
 };
 
 struct Material {
     std::string name;
-    int index = -1;
 	int shader_id;
 	lm::vec3 ambient;
     lm::vec3 diffuse;
@@ -39,9 +65,11 @@ struct Material {
     float specular_gloss;
     
     int diffuse_map;
+    int ref_count = 0; //number of mesh components using material
 
-    static std::unordered_map<std::string, int> materials;
+    static std::unordered_map<std::string, int> materials; //.mtl path, id of shared material
     static std::unordered_map<std::string, int> textures;
+    static std::unordered_map<std::string, MaterialFile> files; //.mtl path, contents
 
     Material() {
         name = "";
@@ -53,6 +81,53 @@ struct Material {
     }
 
     static int Load(GraphicsSystem& graphics_system, rapidjson::Value & entity, int ent_id);
+    //same, from path of .mtl file
+    static int Load(GraphicsSystem& graphics_system, const std::string& mat_name);
+};
+
+//uniform blocks, laid out following std140 rules: vec3s are padded to
+//16 bytes, and must match the blocks declared in shaders
+const int MAX_LIGHTS = 8;
+
+struct LightBlock {
+    float position[4];
+    float color[4];
+};
+
+//per frame (camera and lights), bound to UB_FRAME
+struct FrameBlock {
+    float view_projection[16];
+    float cam_pos[4];
+    LightBlock lights[MAX_LIGHTS];
+    GLint num_lights;
+    GLint padding[3];
+};
+
+//per material, all stored in one buffer and bound to UB_MATERIAL by range
+struct MaterialBlock {
+    float ambient[4];
+    float diffuse[4];
+    float specular[3];
+    float specular_gloss;
+};
+static_assert(sizeof(FrameBlock) == 352, "FrameBlock does not match std140 layout");
+static_assert(sizeof(MaterialBlock) == 48, "MaterialBlock does not match std140 layout");
+
+//per instance data streamed to the instance buffer, read by instanced shaders
+//as vertex attributes 3-6 (model) and 7-10 (normal matrix)
+struct InstanceData {
+    lm::mat4 model;
+    lm::mat4 normal_matrix;
+};
+
+//consecutive meshes in the sorted draw list which share shader, material and
+//geometry, and are drawn with a single instanced call
+struct InstanceGroup {
+    int shader_id;
+    int material;
+    int geometry;
+    int first; //first entry in draw list (and instance buffer)
+    int count;
 };
 
 class GraphicsSystem {
@@ -66,22 +141,39 @@ public:
     std::vector<Material> materials_;
 
     void init(int window_width, int window_height);
-    void lateInit();
     void update(float dt);
     
 	//viewport
 	void updateMainViewport(int window_width, int window_height);
 
+    //culling stats of last update
+    int getVisibleMeshCount() { return meshes_visible_; }
+    int getCulledMeshCount() { return meshes_culled_; }
+
     //shader loader
 	Shader* loadShader(std::string vs_path, std::string fs_path, bool compile_direct = false);
 
+    //registers instanced version of a shader. Meshes whose material uses base
+    //are drawn instanced with it; shaders without one use a draw per mesh
+    void setInstancedShader(Shader* base, Shader* instanced);
+
 	//materials
     int createMaterial();
 	Material& getMaterial(int mat_id) { return materials_.at(mat_id); }
+    //drops a reference to a material loaded from file. When none are left it is
+    //removed from cache and its slot reused by next createMaterial
+    void releaseMaterial(int mat_id);
     
     //geometry
     int createPlaneGeometry();
     int createGeometryFromFile(std::string filename);
+    //same as above in two steps: reading file (any thread) and GL upload (main thread)
+    static bool readGeometryFile(const std::string& filename, GeometryData& data,
+                                 const VertexFormat& format = VertexFormat());
+    int uploadGeometry(GeometryData& data);
+
+    //textures are requested here, and their data uploaded over next frames
+    TextureStreamer& getTextureStreamer() { return texture_streamer_; }
     
 private:
 
@@ -92,24 +184,65 @@ private:
 
 	//materials stuff
     GLint current_material_ = -1;
+    TextureStreamer texture_streamer_;
     void setMaterialUniforms();
-
-	//sorting and checking
-	void sortMeshes_();
+    GLuint material_ubo_ = 0;
+    GLint material_block_stride_ = 0; //MaterialBlock size rounded up to GL offset alignment
+    bool materials_dirty_ = true; //material buffer must be uploaded again
+    void uploadMaterialBlocks_();
+    std::vector<int> free_materials_; //released slots of materials_
+    unsigned int material_refs_version_ = 0; //ECS structure version ref counts were computed for
+    void updateMaterialRefs_(std::vector<Mesh>& meshes);
+
+	//camera and lights
+    GLuint frame_ubo_ = 0;
+    void uploadFrameBlock_();
+
+	//checking
 	void checkShaderAndMaterial(Mesh& mesh);
     
     //rendering
     void renderMeshComponent_(Mesh& comp);
+
+    //culling
+    BVH mesh_bvh_;
+    std::vector<AABB> mesh_world_aabbs_; //world space aabb of each mesh component
+    std::vector<int> mesh_aabb_geometry_; //geometry each world aabb was computed for
+    unsigned int mesh_bvh_version_ = 0; //ECS structure version the tree was built for
+    bool mesh_bvh_valid_ = false;
+    std::vector<int> visible_meshes_;
+    int meshes_visible_ = 0;
+    int meshes_culled_ = 0;
+    void cullMeshes_(std::vector<Mesh>& meshes);
+
+    //instancing
+    std::unordered_map<GLint, Shader*> instanced_shaders_; //base program id, instanced shader
+    //draw order
+    RenderQueue render_queue_;
+    std::vector<float> mesh_distances_; //camera distance of each visible mesh
+    std::unordered_map<int, int> shader_sort_ids_; //program id, id in sort keys
+    int getShaderSortId_(int shader_id);
+    std::vector<int> draw_list_; //visible mesh indices in render queue order
+    std::vector<InstanceGroup> instance_groups_;
+    std::vector<InstanceData> instance_data_;
+    GLuint instance_vbo_ = 0;
+    size_t instance_vbo_capacity_ = 0; //in instances
+    void buildInstanceGroups_(std::vector<Mesh>& meshes);
+    void uploadInstanceData_(std::vector<Mesh>& meshes);
+    void renderInstanceGroup_(const InstanceGroup& group, Shader* instanced_shader);
+    void setInstanceAttributes_(size_t offset);
     
 	//AABB
-	void setGeometryAABB_(Geometry& geom, std::vector<GLfloat>& vertices);
-	AABB transformAABB_(const AABB& aabb, const lm::mat4& transform);
+	static AABB computeAABB_(const unsigned char* positions, size_t num_vertices, size_t stride);
 	bool BBInFrustum_(const AABB& aabb, const lm::mat4& model_view_projection);
 	bool AABBInFrustum_(const AABB& aabb, const lm::mat4& view_projection);
 
     //create geometry buffers
-    GLuint generateBuffers_(std::vector<float>& vertices,
-                            std::vector<float>& uvs,
-                            std::vector<float>& normals,
-                            std::vector<unsigned int>& indices);
+    static VertexSource getVertexSource_(const std::vector<GLfloat>& vertices, const std::vector<GLfloat>& uvs,
+                                         const std::vector<GLfloat>& normals);
+    static void packGeometry_(const VertexSource& source, const void* indices, size_t num_indices,
+                              GLuint bytes_per_index, const VertexFormat& format, GeometryData& data);
+    GLuint generateInterleavedBuffers_(const void* vertices, size_t vertices_bytes, const VertexLayout& layout,
+                                       const void* indices, size_t indices_bytes);
+    static bool getMeshFileLayout_(const std::string& vertex_type_name, GLuint bytes_per_vtx, VertexLayout& layout);
 };
@@ -0,0 +1,193 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+
+//index of the queue owned by the current thread, 0 for non-worker threads
+static thread_local int tls_queue_index = 0;
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+JobSystem& JobSystem::get() {
+    static JobSystem instance;
+    return instance;
+}
+
+void JobSystem::init(int num_workers) {
+    shutdown();
+
+    if (num_workers < 0) {
+        int hw_threads = (int)std::thread::hardware_concurrency();
+        num_workers = std::max(hw_threads - 1, 0);
+    }
+
+    quit_ = false;
+    queues_.clear();
+    for (int i = 0; i < num_workers + 1; i++)
+        queues_.emplace_back(new JobQueue());
+    for (int i = 0; i < num_workers; i++)
+        threads_.emplace_back(&JobSystem::workerLoop_, this, i + 1);
+}
+
+void JobSystem::shutdown() {
+    if (threads_.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        quit_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+    threads_.clear();
+
+    //run anything that was left behind so counters are never left hanging
+    while (runOneJob_(0) || runBackgroundJob_());
+}
+
+void JobSystem::run(Job job, JobCounter* counter) {
+    if (counter) counter->pending++;
+
+    //no workers, run straight away
+    if (threads_.empty()) {
+        job();
+        if (counter) counter->pending--;
+        return;
+    }
+
+    JobQueue& queue = *queues_[currentQueue_()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.emplace_back(std::move(job), counter);
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        queued_jobs_++;
+    }
+    wake_cv_.notify_one();
+}
+
+void JobSystem::runBackground(Job job, JobCounter* counter) {
+    if (counter) counter->pending++;
+
+    if (threads_.empty()) {
+        job();
+        if (counter) counter->pending--;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(background_.mutex);
+        background_.jobs.emplace_back(std::move(job), counter);
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        background_jobs_++;
+    }
+    wake_cv_.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    int queue_index = currentQueue_();
+    while (counter.pending > 0) {
+        if (!runOneJob_(queue_index))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(int count, int min_batch, const std::function<void(int, int)>& func) {
+    if (count <= 0) return;
+    min_batch = std::max(min_batch, 1);
+
+    //few items or no workers: not worth scheduling
+    int num_threads = getNumWorkers() + 1;
+    if (num_threads == 1 || count <= min_batch) {
+        func(0, count);
+        return;
+    }
+
+    //a few batches per thread so that stealing can even out uneven work
+    int batch_size = std::max(min_batch, (count + num_threads * 4 - 1) / (num_threads * 4));
+
+    JobCounter counter;
+    for (int begin = batch_size; begin < count; begin += batch_size) {
+        int end = std::min(begin + batch_size, count);
+        run([&func, begin, end]() { func(begin, end); }, &counter);
+    }
+    //calling thread takes the first batch itself
+    func(0, std::min(batch_size, count));
+    wait(counter);
+}
+
+void JobSystem::workerLoop_(int queue_index) {
+    tls_queue_index = queue_index;
+    Profiler::get().setThreadName("Worker " + std::to_string(queue_index));
+    while (!quit_) {
+        if (runOneJob_(queue_index)) continue;
+        //nothing else to do
+        if (runBackgroundJob_()) continue;
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this]() { return quit_ || queued_jobs_ > 0 || background_jobs_ > 0; });
+    }
+}
+
+//runs a single job from own queue or stolen from another. false if none found
+bool JobSystem::runOneJob_(int queue_index) {
+    std::pair<Job, JobCounter*> job;
+    if (!popJob_(queue_index, job)) return false;
+
+    job.first();
+    if (job.second) job.second->pending--;
+    return true;
+}
+
+bool JobSystem::runBackgroundJob_() {
+    std::pair<Job, JobCounter*> job;
+    {
+        std::lock_guard<std::mutex> lock(background_.mutex);
+        if (background_.jobs.empty()) return false;
+        job = std::move(background_.jobs.front());
+        background_.jobs.pop_front();
+        background_jobs_--;
+    }
+
+    Profiler::get().setThreadPaused(true);
+    job.first();
+    Profiler::get().setThreadPaused(false);
+    if (job.second) job.second->pending--;
+    return true;
+}
+
+bool JobSystem::popJob_(int queue_index, std::pair<Job, JobCounter*>& job) {
+    if (queues_.empty() || queued_jobs_ == 0) return false;
+
+    //own queue first, newest job (most likely still in cache)
+    {
+        JobQueue& own = *queues_[queue_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            queued_jobs_--;
+            return true;
+        }
+    }
+
+    //steal oldest job from other queues
+    int num_queues = (int)queues_.size();
+    for (int i = 1; i < num_queues; i++) {
+        JobQueue& other = *queues_[(queue_index + i) % num_queues];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.jobs.empty()) {
+            job = std::move(other.jobs.front());
+            other.jobs.pop_front();
+            queued_jobs_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+int JobSystem::currentQueue_() {
+    return tls_queue_index < (int)queues_.size() ? tls_queue_index : 0;
+}
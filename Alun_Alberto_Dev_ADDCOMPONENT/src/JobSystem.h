@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts jobs which have not finished yet. Pass one to JobSystem::run and
+// then JobSystem::wait on it to block until all those jobs are done
+struct JobCounter {
+    std::atomic<int> pending{ 0 };
+};
+
+// Work-stealing thread pool
+// - every thread (workers and main thread) owns a queue of jobs
+// - a thread pushes and pops jobs from the back of its own queue, and when it
+//   runs out it steals from the front of another thread's queue
+// - waiting threads help executing jobs instead of blocking, so jobs may
+//   safely spawn and wait for other jobs
+// With zero workers every job simply runs inline on the calling thread
+class JobSystem {
+public:
+    typedef std::function<void()> Job;
+
+    ~JobSystem();
+
+    static JobSystem& get();
+
+    //start worker threads. -1 uses one less than the number of hardware threads
+    void init(int num_workers = -1);
+    void shutdown();
+
+    //queue a job. counter (optional) is incremented now and decremented when job is done
+    void run(Job job, JobCounter* counter = nullptr);
+    //queue a job which only idle workers run, never a thread inside wait. For
+    //long work (e.g. streaming assets) that must not hold up the jobs a frame
+    //waits for. With zero workers it runs straight away. Its profile zones are
+    //not recorded, as it may still be running when the profiler reads buffers
+    void runBackground(Job job, JobCounter* counter = nullptr);
+    //execute other jobs until counter reaches zero
+    void wait(JobCounter& counter);
+
+    //split [0, count) in batches of at least min_batch items and run
+    //func(begin, end) for each batch in parallel. Returns when all are done
+    void parallelFor(int count, int min_batch, const std::function<void(int, int)>& func);
+
+    int getNumWorkers() { return (int)threads_.size(); }
+
+private:
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<std::pair<Job, JobCounter*>> jobs;
+    };
+
+    //queue 0 is used by main thread and any other non-worker thread
+    std::vector<std::unique_ptr<JobQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    //sleeping workers wait on this when no jobs are queued anywhere
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<int> queued_jobs_{ 0 };
+    //background jobs, oldest first
+    JobQueue background_;
+    std::atomic<int> background_jobs_{ 0 };
+    std::atomic<bool> quit_{ false };
+
+    void workerLoop_(int queue_index);
+    bool runOneJob_(int queue_index);
+    bool runBackgroundJob_();
+    bool popJob_(int queue_index, std::pair<Job, JobCounter*>& job);
+    int currentQueue_();
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapped file. The contents stay mapped, and data() valid,
+// until close() or the object is destroyed
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile();
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+
+    //mapping can't be shared
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
@@ -1,271 +1,36 @@
 #include "Parsers.h"
 #include <fstream>
+#include <cstring>
+#include <sys/stat.h>
 #include "extern.h"
+#include "JobSystem.h"
+#include "render/RenderDevice.h"
+#include <unordered_set>
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
 
 #include <unordered_map>
+#include "Profiler.h"
 std::unordered_map<std::string, int> Parsers::geometries;
 std::unordered_map<std::string, int> Parsers::textures;
 std::unordered_map<std::string, int> Parsers::materials;
 std::unordered_map<std::string, int> Parsers::shaders;
-
-void split(std::string to_split, std::string delim, std::vector<std::string>& result) {
-
-	size_t last_offset = 0;
-	while (true) {
-		//find first delim
-		size_t offset = to_split.find_first_of(delim, last_offset); 
-		result.push_back(to_split.substr(last_offset, offset - last_offset));
-		if (offset == std::string::npos) // if at end of string
-			break;
-		else //otherwise continue
-			last_offset = offset + 1;
-	}
-}
-
-//parses a wavefront object into passed arrays
-bool Parsers::parseOBJ(std::string filename, std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices) {
-    
-	std::string line;
-	std::ifstream file(filename);
-	if (file.is_open())
-	{
-		//declare containers for temporary and final attributes
-		std::vector<lm::vec3> temp_vertices;
-		std::vector<lm::vec2> temp_uvs;
-		std::vector<lm::vec3> temp_normals;
-
-		//container to store map for indices
-		std::unordered_map<std::string, int> indices_map;
-		int next_index = 0; //stores next available index
-
-		//parse file line by line
-		while (std::getline(file, line))
-		{
-			//split line string
-			std::vector<std::string> words; 
-			split(line, " ", words);
-            for (auto it = words.begin(); it != words.end();)
-            {
-                if ((*it) == "") it = words.erase(it);
-                else it++;
-            }
-
-			if (words.empty()) continue; //empty line, skip
-			if (words[0][0] == '#')	continue; //first word starts with #, line is a comment
-
-			if (words[0] == "v") { //line contains vertex data
-				//read words to floats
-				lm::vec3 pos( (float)atof( words[1].c_str() ), 
-							  (float)atof( words[2].c_str() ),
-							  (float)atof( words[3].c_str() ) );
-				//add to temporary vector of positions
-				temp_vertices.push_back(pos);
-			}
-			if (words[0] == "vt") { //line contains texture data
-				//read words to floats
-				lm::vec2 tex( (float)atof(words[1].c_str() ),
-							  (float)atof(words[2].c_str() ) );
-				//add to temporary vector of texture coords
-				temp_uvs.push_back(tex);
-			}
-			if (words[0] == "vn") { //line contains vertex data
-				//read words to floats
-				lm::vec3 norm( (float)atof(words[1].c_str() ),
-							   (float)atof(words[2].c_str() ),
-							   (float)atof(words[3].c_str() ) );
-				//add to temporary vector of normals
-				temp_normals.push_back(norm);
-			}
-
-			//line contains face-vertex data
-			if (words[0] == "f") {
-				if (words.size() < 4) continue; // faces with fewer than 3 vertices??!
-
-				bool quad_face = false; //boolean to help us deal with quad faces
-
-				std::vector<std::string> nums; // container used for split indices
-				//for each face vertex
-				for (int i = 1; i < words.size(); i++) {
-
-					//check if face vertex has already been indexed
-					if (indices_map.count(words[i]) == 0) {
-					    
-                        if (words[i] == "") continue;
-						//if not, start by getting all indices
-						nums.clear();
-						split(words[i], "/", nums);
-						int v_ind = atoi(nums[0].c_str()) - 1; //subtract 1 to convert to 0-based array!
-						int t_ind = atoi(nums[1].c_str()) - 1;
-						int n_ind = atoi(nums[2].c_str()) - 1;
-
-						//add vertices to final arrays of floats
-						for (int j = 0; j < 3; j++)
-							vertices.push_back(temp_vertices[v_ind].value_[j]);
-						for (int j = 0; j < 2; j++)
-							uvs.push_back(temp_uvs[t_ind].value_[j]);
-						for (int j = 0; j < 3; j++)
-							normals.push_back(temp_normals[n_ind].value_[j]);
-						
-						//add an index to final array
-						indices.push_back(next_index);
-
-						//record that this index is used for this face vertex
-						indices_map[words[i]] = next_index;
-
-						//increment index
-						next_index++;
-					}
-					else {
-						//face vertex was already added to final arrays
-						//so search for its stored index
-						int the_index = indices_map.at(words[i]); //safe to use as we know it exists
-						//add it to final index array
-						indices.push_back(the_index);
-					}
-
-					//***CHECK FOR QUAD FACES****
-					//If the face is a quads (i.e. words.size() == 5), we need to create two triangles
-					//out of the quad. We have already created one triangle with words[1], [2] and [3]
-					//now we make another with [4], [1] and [3]. 
-					if (i == 4 ) { 
-						//face-vertex 4 is already added, so we search for indices of 1 and 3 and add them
-						int index_1 = indices_map.at(words[1]);
-						indices.push_back(index_1);
-						int index_3 = indices_map.at(words[3]);
-						indices.push_back(index_3);
-					}
-
-				}
-
-			}
-
-		}
-		file.close();
-		return true;
-	}
-	return false;
-}
-
-bool Parsers::parseBin(std::string filename, std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices)
-{
-    FILE* f = nullptr;
-    f = fopen(filename.c_str(), "rb");
-
-    //declare containers for temporary and final attributes
-    THeader header;
-    std::vector<float> temp_vtxs;
-
-    //parse file line by line
-    bool eof_found = false;
-
-    while (!eof_found) {
-
-        //split line string
-        TChunk chunk;
-        auto bytes_read = fread(&chunk, 1, sizeof(chunk), f);
-        assert(bytes_read == sizeof(chunk));
-
-        switch (chunk.magic_id) {
-
-        case magicHeader:
-
-            bytes_read = fread(&header, 1, chunk.num_bytes, f);
-            assert(bytes_read == chunk.num_bytes);
-            break;
-
-        case magicVtxs:
-
-            temp_vtxs.resize(chunk.num_bytes);
-            bytes_read = fread(temp_vtxs.data(), 1, chunk.num_bytes, f);
-            assert(bytes_read == chunk.num_bytes);
-            break;
-
-        case magicIdxs:
-
-            indices.resize(chunk.num_bytes);
-            bytes_read = fread(indices.data(), 1, chunk.num_bytes, f);
-            assert(bytes_read == chunk.num_bytes);
-            break;
-
-        case magicSubGroups:
-
-            // add subgroups here
-
-            break;
-
-        case magicEoF:
-
-            eof_found = true;
-            break;
-
-        default:
-            //printf("Unknown chunk data type %08x of %d bytes while reading file %s\n", chunk.magic_id, chunk.num_bytes, filename.c_str());
-            break;
-        }
-    }
-
-    // Replace this with an efficient system without hardcoded sizes!
-    int vertex_size = header.bytes_per_vtx / sizeof(float);
-
-    for (unsigned int i = 0; i < temp_vtxs.size() - vertex_size; i = i + vertex_size) {
-
-        vertices.insert(vertices.end(), { temp_vtxs[i], temp_vtxs[i + 1], temp_vtxs[i + 2] });
-        normals.insert(normals.end(), { temp_vtxs[i + 3], temp_vtxs[i + 4], temp_vtxs[i + 5] });
-        //uvs.insert(uvs.end(), { temp_vtxs[i + 6], temp_vtxs[i + 7] });
-        uvs.push_back(temp_vtxs[i + 6]);
-        uvs.push_back(temp_vtxs[i + 7]);
-    }
-
-    fclose(f);
-    return true;
-}
+std::unordered_map<std::string, Prefab> Parsers::prefabs;
 
 // load uncompressed RGB targa file into an OpenGL texture
 GLint Parsers::parseTexture(std::string filename) {
+	PROFILE_SCOPE("Parsers::parseTexture");
 	std::string str = filename;
 	std::string ext = str.substr(str.size() - 4, 4);
 
-
-	GLuint texture_id;
-
-	if (ext == ".tga" || ext == ".TGA")
+	if (ext == ".tga" || ext == ".TGA" || ext == ".tex")
 	{
-		TGAInfo* tgainfo = loadTGA(filename);
+		TGAInfo* tgainfo = loadTexture(filename);
 		if (tgainfo == NULL) {
 			std::cerr << "ERROR: Could not load TGA file" << std::endl;
 			return false;
 		}
-
-		//generate new openGL texture and bind it (tell openGL we want to do stuff with it)
-		glGenTextures(1, &texture_id);
-		glBindTexture(GL_TEXTURE_2D, texture_id); //we are making a regular 2D texture
-
-												  //screen pixels will almost certainly not be same as texture pixels, so we need to
-												  //set some parameters regarding the filter we use to deal with these cases
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	//set the mag filter
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); //set the min filter
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 4); //use anisotropic filtering
-
-																		  //this is function that actually loads texture data into OpenGL
-		glTexImage2D(GL_TEXTURE_2D, //the target type, a 2D texture
-			0, //the base level-of-detail in the mipmap
-			(tgainfo->bpp == 24 ? GL_RGB : GL_RGBA), //specified the color channels for opengl
-			tgainfo->width, //the width of the texture
-			tgainfo->height, //the height of the texture
-			0, //border - must always be 0
-			(tgainfo->bpp == 24 ? GL_BGR : GL_BGRA), //the format of the incoming data
-			GL_UNSIGNED_BYTE, //the type of the incoming data
-			tgainfo->data); // a pointer to the incoming data
-
-							//we want to use mipmaps
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		//clean up memory
-		delete tgainfo->data;
-		delete tgainfo;
-		return texture_id;
+		return uploadTexture(tgainfo);
 	}
 	else {
 		std::cerr << "ERROR: No extension or extension not supported" << std::endl;
@@ -273,98 +38,80 @@ GLint Parsers::parseTexture(std::string filename) {
 	}
 }
 
-// this reader supports only uncompressed RGB targa files with no colour table
-TGAInfo* Parsers::loadTGA(std::string filename)
-{
-	//the TGA header is 18 bytes long. The first 12 bytes are for specifying the compression
-	//and various fields that are very infrequently used, and hence are usually 0.
-	//for this limited file parser, we start by reading the first 12 bytes and compare
-	//them against the pattern that identifies the file a simple, uncompressed RGB file.
-	//more info about the TGA format cane be found at http://www.paulbourke.net/dataformats/tga/
-
-	char TGA_uncompressed[12] = { 0x0, 0x0, 0x2, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 };
-	char TGA_compare[12];
-	char info_header[6];
-	GLuint bytes_per_pixel;
-	GLuint image_size;
-
-	//open file
-	std::ifstream file(filename, std::ios::binary);
-
-	//read first 12 bytes
-	file.read(&TGA_compare[0], 12);
-	std::streamsize read_header_12 = file.gcount();
-	//compare to check that file in uncompressed (or not corrupted)
-	int header_compare = memcmp(TGA_uncompressed, TGA_compare, sizeof(TGA_uncompressed));
-	if (read_header_12 != sizeof(TGA_compare) || header_compare != 0) {
-		std::cerr << "ERROR: TGA file is not in correct format or corrupted: " << filename << std::endl;
-		file.close();
-		return nullptr;
-	}
-
-	//read in next 6 bytes, which contain 'important' bit of header
-	file.read(&info_header[0], 6);
-
-	TGAInfo* tgainfo = new TGAInfo;
-
-	tgainfo->width = info_header[1] * 256 + info_header[0]; //width is stored in first two bytes of info_header
-	tgainfo->height = info_header[3] * 256 + info_header[2]; //height is stored in next two bytes of info_header
+// create an OpenGL texture from a loaded TGA, and free it
+GLint Parsers::uploadTexture(TGAInfo* tgainfo) {
+	PROFILE_SCOPE("Parsers::uploadTexture");
+	GLuint texture_id;
 
-	if (tgainfo->width <= 0 || tgainfo->height <= 0 || (info_header[4] != 24 && info_header[4] != 32)) {
-		file.close();
-		delete tgainfo;
-		std::cerr << "ERROR: TGA file is not 24 or 32 bits, or has no width or height: " << filename << std::endl;
-		return NULL;
-	}
+	//generate new openGL texture and bind it (tell openGL we want to do stuff with it)
+	GPU->genTextures(1, &texture_id);
+	GPU->state.bindTexture(0, GL_TEXTURE_2D, texture_id); //we are making a regular 2D texture
+
+											  //screen pixels will almost certainly not be same as texture pixels, so we need to
+											  //set some parameters regarding the filter we use to deal with these cases
+	GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	//set the mag filter
+	GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); //set the min filter
+	GPU->texParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 4); //use anisotropic filtering
+
+	//rows of smaller mip levels are not 4 byte aligned
+	GPU->pixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	GLuint width = tgainfo->width, height = tgainfo->height;
+	GLubyte* level_data = tgainfo->data;
+	for (GLuint level = 0; level < tgainfo->num_levels; level++) {
+		//this is function that actually loads texture data into OpenGL
+		GPU->texImage2D(GL_TEXTURE_2D, //the target type, a 2D texture
+			level, //the level-of-detail in the mipmap
+			(tgainfo->bpp == 24 ? GL_RGB : GL_RGBA), //specified the color channels for opengl
+			width, //the width of the texture
+			height, //the height of the texture
+			0, //border - must always be 0
+			(tgainfo->bpp == 24 ? GL_BGR : GL_BGRA), //the format of the incoming data
+			GL_UNSIGNED_BYTE, //the type of the incoming data
+			level_data); // a pointer to the incoming data
 
-	//calculate bytes per pixel and then total image size in bytes
-	tgainfo->bpp = info_header[4];
-	bytes_per_pixel = tgainfo->bpp / 8;
-	image_size = tgainfo->width * tgainfo->height * bytes_per_pixel;
-
-	//reserve memory for the image data
-	tgainfo->data = (GLubyte*)malloc(image_size);
-
-	//read data into memory
-	file.read((char*)tgainfo->data, image_size);
-	std::streamsize image_read_size = file.gcount();
-
-	//check it has been read correctly
-	if (image_read_size != image_size) {
-		if (tgainfo->data != NULL)
-			free(tgainfo->data);
-		file.close();
-		std::cerr << "ERROR: Could not read tga data: " << filename << std::endl;
-		delete tgainfo;
-		return NULL;
+		level_data += (size_t)width * height * (tgainfo->bpp / 8);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
 	}
 
-	file.close();
+	//we want to use mipmaps, cooked textures come with them
+	if (tgainfo->num_levels == 1)
+		GPU->generateMipmap(GL_TEXTURE_2D);
 
-	return tgainfo;
+	//clean up memory (data is malloc'd by loadTGA or loadCookedTexture)
+	free(tgainfo->data);
+	delete tgainfo;
+	return texture_id;
 }
 
 // Method to parse the scene with new json structure
-// No managers implemented, resources are loaded more than once!!
+// Geometries, textures and materials are cached by file path, so each is loaded once
 
 bool Parsers::parseScene(std::string filename, GraphicsSystem & graphics_system)
 {
+    PROFILE_SCOPE("Parsers::parseScene");
+    //compiled scene loads without parsing any json, fall back to the .scene if it fails
+    std::string cooked = getCookedFilename(filename);
+    if (cooked != filename && parseBinaryScene(cooked, graphics_system))
+        return true;
+
     // Set the json stream to be read
     std::ifstream json_file(filename);
     rapidjson::IStreamWrapper json_stream(json_file);
     rapidjson::Document json;
     json.ParseStream(json_stream);
 
-    printf("Parsing Scene Name = %s\n", filename);
+    printf("Parsing Scene Name = %s\n", filename.c_str());
 
     //check if its valid JSON
     if (json.HasParseError()) std::cerr << "JSON format is not valid!" << std::endl;
     if (!json.HasMember("entities")) { std::cerr << "JSON file is incomplete! Needs entry: entities" << std::endl; return false; }
 
-    // Create a default shader by now
-    Shader* new_shader = graphics_system.loadShader("data/shaders/phong.vert", "data/shaders/phong.frag");
-    new_shader->name = "phong";
-    shaders["phong"] = new_shader->program;
+    loadSceneShaders_(graphics_system);
+
+    //load all assets in parallel first, so entities below only hit the caches
+    prefetchSceneAssets_(json["entities"], graphics_system);
 
     std::unordered_map<std::string, std::string> child_parent;
 
@@ -373,7 +120,7 @@ bool Parsers::parseScene(std::string filename, GraphicsSystem & graphics_system)
         //get values from json
         rapidjson::Value & entity = json["entities"][i];      
         int entity_id = parseEntity(entity, graphics_system);
-        Entity ent = ECS.entities[entity_id];
+        const Entity& ent = ECS.entities[entity_id];
 
         // Stablish a parent/children relationship if needed
         if (entity.HasMember("parent")) {
@@ -400,26 +147,405 @@ bool Parsers::parseScene(std::string filename, GraphicsSystem & graphics_system)
     return false;
 }
 
+void Parsers::loadSceneShaders_(GraphicsSystem & graphics_system)
+{
+    // Create a default shader by now
+    Shader* new_shader = graphics_system.loadShader("data/shaders/phong.vert", "data/shaders/phong.frag");
+    new_shader->name = "phong";
+    shaders["phong"] = new_shader->program;
+
+    //instanced variant, used to draw meshes sharing geometry and material in one call
+    Shader* instanced_shader = graphics_system.loadShader("data/shaders/phong_instanced.vert", "data/shaders/phong.frag");
+    instanced_shader->name = "phong_instanced";
+    shaders["phong_instanced"] = instanced_shader->program;
+    graphics_system.setInstancedShader(new_shader, instanced_shader);
+}
+
+//table of a compiled scene, or null if it does not fit in the file or its
+//records are not of the size this build expects
+static const unsigned char* getSceneTable(const MappedFile& file, const TSceneHeader& header,
+                                          SceneTable table, size_t record_bytes)
+{
+    const TSceneTableInfo& info = header.tables[table];
+    if (info.record_bytes != record_bytes || info.offset % 4 != 0 || info.offset > file.size() ||
+        (size_t)info.count * record_bytes > file.size() - info.offset)
+        return nullptr;
+    return file.data() + info.offset;
+}
+
+// Tables are read in place from the mapped file: the only fixups are turning
+// string offsets into pointers and file entity indices into ECS ids. Whole
+// file is checked first, so a bad one leaves ECS untouched
+bool Parsers::parseBinaryScene(const std::string& filename, GraphicsSystem & graphics_system)
+{
+    PROFILE_SCOPE("Parsers::parseBinaryScene");
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    TSceneHeader header;
+    if (file.size() < sizeof(TSceneHeader)) {
+        std::cerr << "ERROR: Truncated scene file " << filename << std::endl;
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(TSceneHeader));
+    if (header.magic != magicScene || header.version != SCENE_VERSION) {
+        std::cerr << "ERROR: Scene file " << filename << " is not a compiled scene of version " << SCENE_VERSION << std::endl;
+        return false;
+    }
+
+    const TSceneEntity* entities = (const TSceneEntity*)getSceneTable(file, header, SceneTableEntities, sizeof(TSceneEntity));
+    const TSceneTransform* transforms = (const TSceneTransform*)getSceneTable(file, header, SceneTableTransforms, sizeof(TSceneTransform));
+    const TSceneMesh* meshes = (const TSceneMesh*)getSceneTable(file, header, SceneTableMeshes, sizeof(TSceneMesh));
+    const TSceneLight* lights = (const TSceneLight*)getSceneTable(file, header, SceneTableLights, sizeof(TSceneLight));
+    const TSceneCollider* colliders = (const TSceneCollider*)getSceneTable(file, header, SceneTableColliders, sizeof(TSceneCollider));
+    const TSceneElevator* elevators = (const TSceneElevator*)getSceneTable(file, header, SceneTableElevators, sizeof(TSceneElevator));
+    const TScenePrefab* prefabs = (const TScenePrefab*)getSceneTable(file, header, SceneTablePrefabs, sizeof(TScenePrefab));
+    const char* strings = (const char*)getSceneTable(file, header, SceneTableStrings, 1);
+    const uint32_t num_entities = header.tables[SceneTableEntities].count;
+    const uint32_t num_transforms = header.tables[SceneTableTransforms].count;
+    const uint32_t num_meshes = header.tables[SceneTableMeshes].count;
+    const uint32_t num_lights = header.tables[SceneTableLights].count;
+    const uint32_t num_colliders = header.tables[SceneTableColliders].count;
+    const uint32_t num_elevators = header.tables[SceneTableElevators].count;
+    const uint32_t num_prefabs = header.tables[SceneTablePrefabs].count;
+    const uint32_t strings_bytes = header.tables[SceneTableStrings].count;
+
+    //every string must be inside the table, which ends with a terminator
+    bool valid = entities && transforms && meshes && lights && colliders && elevators && prefabs && strings &&
+                 strings_bytes > 0 && strings[strings_bytes - 1] == '\0';
+    for (uint32_t i = 0; valid && i < num_entities; i++)
+        valid = entities[i].name < strings_bytes && entities[i].parent >= -1 && entities[i].parent < (int32_t)num_entities;
+    for (uint32_t i = 0; valid && i < num_transforms; i++) valid = transforms[i].entity < num_entities;
+    for (uint32_t i = 0; valid && i < num_meshes; i++)
+        valid = meshes[i].entity < num_entities && meshes[i].mesh < strings_bytes && meshes[i].material < strings_bytes;
+    for (uint32_t i = 0; valid && i < num_lights; i++) valid = lights[i].entity < num_entities;
+    for (uint32_t i = 0; valid && i < num_colliders; i++)
+        valid = colliders[i].entity < num_entities &&
+                (colliders[i].type == SCENE_COLLIDER_DEFAULT || colliders[i].type <= ColliderTypeRay);
+    for (uint32_t i = 0; valid && i < num_elevators; i++) valid = elevators[i].entity < num_entities;
+    for (uint32_t i = 0; valid && i < num_prefabs; i++) valid = prefabs[i].path < strings_bytes;
+    if (!valid) {
+        std::cerr << "ERROR: Scene file is corrupt " << filename << std::endl;
+        return false;
+    }
+
+    //prefabs are copied into the file, so it is stale if any changed since it was cooked
+    struct stat scene_stat, prefab_stat;
+    if (stat(filename.c_str(), &scene_stat) == 0) {
+        for (uint32_t i = 0; i < num_prefabs; i++) {
+            const char* prefab = strings + prefabs[i].path;
+            if (stat(prefab, &prefab_stat) == 0 && prefab_stat.st_mtime > scene_stat.st_mtime) {
+                std::cerr << "WARNING: " << filename << " is older than its prefab " << prefab << ", loading source instead" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    printf("Parsing Scene Name = %s\n", filename.c_str());
+    loadSceneShaders_(graphics_system);
+
+    std::unordered_set<std::string> mesh_set, material_set;
+    for (uint32_t i = 0; i < num_meshes; i++) {
+        mesh_set.insert(strings + meshes[i].mesh);
+        material_set.insert(strings + meshes[i].material);
+    }
+    prefetchAssets_(mesh_set, material_set, graphics_system);
+
+    //counts are known, so arrays grow once
+    ECS.entities.reserve(ECS.entities.size() + num_entities);
+    ECS.getAllComponents<Transform>().reserve(ECS.getAllComponents<Transform>().size() + num_entities);
+    ECS.getAllComponents<TransformWorld>().reserve(ECS.getAllComponents<TransformWorld>().size() + num_entities);
+    ECS.getAllComponents<Mesh>().reserve(ECS.getAllComponents<Mesh>().size() + num_meshes);
+    ECS.getAllComponents<Light>().reserve(ECS.getAllComponents<Light>().size() + num_lights);
+    ECS.getAllComponents<Collider>().reserve(ECS.getAllComponents<Collider>().size() + num_colliders);
+    ECS.getAllComponents<ColliderState>().reserve(ECS.getAllComponents<ColliderState>().size() + num_colliders);
+    ECS.getAllComponents<comp_elevator>().reserve(ECS.getAllComponents<comp_elevator>().size() + num_elevators);
+
+    std::vector<int> entity_ids(num_entities);
+    for (uint32_t i = 0; i < num_entities; i++)
+        entity_ids[i] = ECS.createEntity(strings + entities[i].name);
+
+    for (uint32_t i = 0; i < num_transforms; i++) {
+        Transform& transform = ECS.getComponentFromEntity<Transform>(entity_ids[transforms[i].entity]);
+        memcpy(transform.m, transforms[i].matrix, sizeof(transform.m));
+    }
+    for (uint32_t i = 0; i < num_meshes; i++) {
+        int geo_id = Geometry::Load(graphics_system, strings + meshes[i].mesh);
+        int mat_id = Material::Load(graphics_system, strings + meshes[i].material);
+        Mesh& mesh = ECS.createComponentForEntity<Mesh>(entity_ids[meshes[i].entity]);
+        mesh.geometry = geo_id;
+        mesh.material = mat_id;
+    }
+    for (uint32_t i = 0; i < num_lights; i++) {
+        Light& light = ECS.createComponentForEntity<Light>(entity_ids[lights[i].entity]);
+        light.color = lm::vec3(lights[i].color[0], lights[i].color[1], lights[i].color[2]);
+    }
+    for (uint32_t i = 0; i < num_colliders; i++) {
+        const TSceneCollider& record = colliders[i];
+        Collider& collider = ECS.createComponentForEntity<Collider>(entity_ids[record.entity]);
+        if (record.type != SCENE_COLLIDER_DEFAULT) {
+            collider.collider_type = (ColliderType)record.type;
+            collider.local_center = lm::vec3(record.center[0], record.center[1], record.center[2]);
+            collider.local_halfwidth = lm::vec3(record.halfwidth[0], record.halfwidth[1], record.halfwidth[2]);
+        }
+    }
+    for (uint32_t i = 0; i < num_elevators; i++) {
+        const TSceneElevator& record = elevators[i];
+        int ent_id = entity_ids[record.entity];
+        comp_elevator& elevator = ECS.createComponentForEntity<comp_elevator>(ent_id);
+        elevator.my_ent_id = ent_id;
+        elevator.speed = (int)record.speed;
+        elevator.direction = lm::vec3(record.direction[0], record.direction[1], record.direction[2]);
+        elevator.no_Automatic = record.automatic != 0;
+    }
+
+    //parents are entity indices, link to their transforms
+    for (uint32_t i = 0; i < num_entities; i++) {
+        if (entities[i].parent < 0) continue;
+        Transform& transform = ECS.getComponentFromEntity<Transform>(entity_ids[i]);
+        transform.parent = ECS.getComponentID<Transform>(entity_ids[entities[i].parent]);
+    }
+    return true;
+}
+
+//collects paths of meshes and materials used by an entity (or its prefab)
+static void collectEntityAssets(rapidjson::Value & entity,
+                                std::unordered_set<std::string>& meshes,
+                                std::unordered_set<std::string>& materials) {
+    if (entity.HasMember("prefab") && entity["prefab"].IsString()) {
+        const Prefab* prefab = Parsers::getPrefab(entity["prefab"].GetString());
+        if (prefab) {
+            for (const PrefabEntity& prefab_entity : prefab->entities) {
+                if (!prefab_entity.has_mesh) continue;
+                meshes.insert(prefab_entity.mesh_path);
+                materials.insert(prefab_entity.material_path);
+            }
+        }
+    }
+    if (entity.HasMember("render") && entity["render"].IsObject()) {
+        rapidjson::Value & render = entity["render"];
+        if (render.HasMember("mesh") && render["mesh"].IsString())
+            meshes.insert(render["mesh"].GetString());
+        if (render.HasMember("materials") && render["materials"].IsArray() &&
+            render["materials"].Size() > 0 && render["materials"][0].IsString())
+            materials.insert(render["materials"][0].GetString());
+    }
+}
+
+void Parsers::prefetchSceneAssets_(rapidjson::Value & entities, GraphicsSystem & graphics_system)
+{
+    PROFILE_SCOPE("Parsers::prefetchSceneAssets_");
+    std::unordered_set<std::string> mesh_set, material_set;
+    for (rapidjson::SizeType i = 0; i < entities.Size(); i++)
+        collectEntityAssets(entities[i], mesh_set, material_set);
+    prefetchAssets_(mesh_set, material_set, graphics_system);
+}
+
+// Loading is done in stages:
+// 1. collect unique mesh and material paths not loaded yet
+// 2. worker threads read/decode meshes and parse material files
+// 3. once materials are parsed, their (unique) textures are requested from
+//    the texture streamer, which decodes them on workers
+// 4. main thread uploads geometries, and fills the caches used by
+//    Geometry/Material::Load. Texture data arrives over the next frames
+void Parsers::prefetchAssets_(const std::unordered_set<std::string>& mesh_set,
+                              const std::unordered_set<std::string>& material_set,
+                              GraphicsSystem & graphics_system)
+{
+    PROFILE_SCOPE("Parsers::prefetchAssets_");
+    std::vector<std::string> mesh_paths, material_paths;
+    for (auto& path : mesh_set)
+        if (Geometry::geometries.find(path) == Geometry::geometries.end()) mesh_paths.push_back(path);
+    for (auto& path : material_set)
+        if (Material::files.find(path) == Material::files.end()) material_paths.push_back(path);
+
+    JobSystem& jobs = JobSystem::get();
+
+    //read meshes and materials
+    std::vector<GeometryData> geometry_data(mesh_paths.size());
+    std::vector<MaterialFile> material_files(material_paths.size());
+    JobCounter geometry_counter, material_counter;
+    for (size_t i = 0; i < mesh_paths.size(); i++) {
+        jobs.run([&, i]() { GraphicsSystem::readGeometryFile(mesh_paths[i], geometry_data[i]); }, &geometry_counter);
+    }
+    for (size_t i = 0; i < material_paths.size(); i++) {
+        jobs.run([&, i]() { MaterialFile::read(material_paths[i], material_files[i]); }, &material_counter);
+    }
+
+    //textures referenced by materials are decoded and uploaded by streamer
+    //over the next frames, showing a placeholder until then
+    jobs.wait(material_counter);
+    for (auto& file : material_files) {
+        const std::string& path = file.diffuse_map;
+        if (path.size() < 4 || Material::textures.find(path) != Material::textures.end())
+            continue;
+        std::string ext = path.substr(path.size() - 4, 4);
+        if (ext == ".tga" || ext == ".TGA" || ext == ".tex")
+            Material::textures[path] = graphics_system.getTextureStreamer().request(path);
+    }
+
+    //upload on main thread
+    jobs.wait(geometry_counter);
+    for (size_t i = 0; i < mesh_paths.size(); i++) {
+        Geometry::geometries[mesh_paths[i]] = graphics_system.uploadGeometry(geometry_data[i]);
+    }
+    for (size_t i = 0; i < material_paths.size(); i++) {
+        Material::files[material_paths[i]] = std::move(material_files[i]);
+    }
+}
+
+//component of entity, created if it has none, so that fields of an instance
+//replace those of its prefab rather than adding a second component
+template<typename T>
+static T& getOrCreateComponent(int ent_id) {
+    if (ECS.getComponentID<T>(ent_id) != -1)
+        return ECS.getComponentFromEntity<T>(ent_id);
+    return ECS.createComponentForEntity<T>(ent_id);
+}
+
+//adds a copy of a prefab component to entity
+template<typename T>
+static T& cloneComponent(const T& source, int ent_id) {
+    T& clone = ECS.createComponentForEntity<T>(ent_id);
+    clone = source;
+    clone.owner = ent_id;
+    return clone;
+}
+
+const Prefab* Parsers::getPrefab(const std::string& filename)
+{
+    auto cached = prefabs.find(filename);
+    if (cached != prefabs.end())
+        return cached->second.entities.empty() ? nullptr : &cached->second;
+
+    PROFILE_SCOPE("Parsers::getPrefab");
+    //stays empty while parsing, so a prefab which includes itself fails
+    prefabs[filename];
+
+    std::ifstream json_file(filename);
+    rapidjson::IStreamWrapper json_stream(json_file);
+    rapidjson::Document json;
+    json.ParseStream(json_stream);
+    if (json.HasParseError() || !json.IsObject() || !json.HasMember("entities") ||
+        !json["entities"].IsArray() || json["entities"].Size() == 0) {
+        std::cerr << "ERROR: Could not read prefab " << filename << std::endl;
+        return nullptr;
+    }
+
+    Prefab prefab;
+    rapidjson::Value & entities = json["entities"];
+    std::vector<int> indices(entities.Size());
+    for (rapidjson::SizeType i = 0; i < entities.Size(); i++)
+        indices[i] = addPrefabEntity_(entities[i], prefab);
+
+    //link parents inside prefab by name. Entities without one hang from the
+    //root, so that the whole prefab follows the transform of an instance
+    for (rapidjson::SizeType i = 1; i < entities.Size(); i++) {
+        int parent = 0;
+        if (entities[i].HasMember("parent")) {
+            std::string parent_name = entities[i]["parent"].GetString();
+            rapidjson::SizeType j = 0;
+            while (j < entities.Size() && (j == i || prefab.entities[indices[j]].name != parent_name)) j++;
+            if (j < entities.Size()) parent = indices[j];
+            else std::cerr << "ERROR: Parent " << parent_name << " is not in prefab " << filename << std::endl;
+        }
+        prefab.entities[indices[i]].parent = parent;
+    }
+
+    Prefab& result = prefabs[filename];
+    result = std::move(prefab);
+    return &result;
+}
+
+// Reads the same fields as parseEntity, into prefab rather than ECS
+int Parsers::addPrefabEntity_(rapidjson::Value & entity, Prefab & prefab)
+{
+    const int index = (int)prefab.entities.size();
+    const Prefab* nested = entity.HasMember("prefab") ? getPrefab(entity["prefab"].GetString()) : nullptr;
+    if (nested) {
+        for (const PrefabEntity& nested_entity : nested->entities) {
+            prefab.entities.push_back(nested_entity);
+            if (nested_entity.parent != -1) prefab.entities.back().parent += index;
+        }
+    }
+    else
+        prefab.entities.emplace_back();
+
+    PrefabEntity& root = prefab.entities[index];
+    root.name = entity.HasMember("name") ? entity["name"].GetString() : "";
+    if (entity.HasMember("transform"))
+        root.transform.Load(entity, -1);
+    if (entity.HasMember("render")) {
+        root.has_mesh = true;
+        root.mesh_path = entity["render"]["mesh"].GetString();
+        root.material_path = entity["render"]["materials"][0].GetString();
+    }
+    if (entity.HasMember("collider")) {
+        root.has_collider = true;
+        root.collider.Load(entity, -1);
+    }
+    if (entity.HasMember("light")) {
+        root.has_light = true;
+        root.light.Load(entity, -1);
+    }
+    if (entity.HasMember("elevator")) {
+        root.has_elevator = true;
+        root.elevator.Load(entity, -1);
+    }
+    return index;
+}
+
+// Components are copied from prefab, nothing is parsed
+int Parsers::instantiatePrefab_(const Prefab & prefab, GraphicsSystem & graphics_system)
+{
+    PROFILE_SCOPE("Parsers::instantiatePrefab_");
+    std::vector<int> ent_ids(prefab.entities.size());
+    for (size_t i = 0; i < prefab.entities.size(); i++) {
+        const PrefabEntity& source = prefab.entities[i];
+        const int ent_id = ECS.createEntity(source.name);
+        ent_ids[i] = ent_id;
+
+        Transform& transform = ECS.getComponentFromEntity<Transform>(ent_id);
+        transform = source.transform;
+        transform.owner = ent_id;
+
+        if (source.has_mesh) {
+            Mesh& mesh = ECS.createComponentForEntity<Mesh>(ent_id);
+            mesh.geometry = Geometry::Load(graphics_system, source.mesh_path);
+            mesh.material = Material::Load(graphics_system, source.material_path);
+        }
+        if (source.has_collider) cloneComponent(source.collider, ent_id);
+        if (source.has_light) cloneComponent(source.light, ent_id);
+        if (source.has_elevator) cloneComponent(source.elevator, ent_id).my_ent_id = ent_id;
+    }
+
+    //parents may come later in prefab, so link once all exist
+    for (size_t i = 0; i < prefab.entities.size(); i++) {
+        if (prefab.entities[i].parent == -1) continue;
+        ECS.getComponentFromEntity<Transform>(ent_ids[i]).parent =
+            ECS.getComponentID<Transform>(ent_ids[prefab.entities[i].parent]);
+    }
+    return ent_ids[0];
+}
+
 // I read my json object per entity
 int Parsers::parseEntity(rapidjson::Value & entity, GraphicsSystem & graphics_system)
 {
+    PROFILE_SCOPE("Parsers::parseEntity");
     std::string name = "";
     if (entity.HasMember("name"))
         name = entity["name"].GetString();
 
     int ent_id = -1;
     if (entity.HasMember("prefab")) {
-        /// In case of prefab entity, load the entity and then ignore it's default transform and name
-        std::ifstream json_file(entity["prefab"].GetString());
-        rapidjson::IStreamWrapper json_stream(json_file);
-        rapidjson::Document json;
-        json.ParseStream(json_stream);
-
-        // Add support for multiple entities in prefab
-        ent_id = parseEntity(json["entities"][0], graphics_system);
-        ECS.entities[ent_id].name = name;
+        /// In case of prefab entity, copy the cached prefab and then apply the fields
+        /// of the instance over its root: transform is applied on top of prefab's one
+        const Prefab* prefab = getPrefab(entity["prefab"].GetString());
+        if (prefab) {
+            ent_id = instantiatePrefab_(*prefab, graphics_system);
+            ECS.renameEntity(ent_id, name);
+        }
     }
-    else {
+    if (ent_id == -1) {
         // Create the entity with the given name
         ent_id = ECS.createEntity(name);
     }
@@ -437,7 +563,7 @@ int Parsers::parseEntity(rapidjson::Value & entity, GraphicsSystem & graphics_sy
         int geo_id = Geometry::Load(graphics_system, entity, ent_id);
         int mat_id = Material::Load(graphics_system, entity, ent_id);
 
-        Mesh& ent_mesh = ECS.createComponentForEntity<Mesh>(ent_id);
+        Mesh& ent_mesh = getOrCreateComponent<Mesh>(ent_id);
         ent_mesh.geometry = geo_id;
         ent_mesh.material = mat_id;
     }
@@ -445,14 +571,14 @@ int Parsers::parseEntity(rapidjson::Value & entity, GraphicsSystem & graphics_sy
     // Load collider parameters
     if (entity.HasMember("collider")) {
 
-        Collider& collider = ECS.createComponentForEntity<Collider>(ent_id);
+        Collider& collider = getOrCreateComponent<Collider>(ent_id);
         collider.Load(entity, ent_id);
     }
 
     // Add the light component
     if (entity.HasMember("light")) {
 
-        Light& light = ECS.createComponentForEntity<Light>(ent_id);
+        Light& light = getOrCreateComponent<Light>(ent_id);
         light.Load(entity, ent_id);
     }
 
@@ -470,7 +596,7 @@ int Parsers::parseEntity(rapidjson::Value & entity, GraphicsSystem & graphics_sy
 
 		// Call rotator load method
 		// Parse his information and create the component.
-		comp_elevator& elevator = ECS.createComponentForEntity<comp_elevator>(ent_id);
+		comp_elevator& elevator = getOrCreateComponent<comp_elevator>(ent_id);
 		elevator.Load(entity, ent_id);
 	}
 
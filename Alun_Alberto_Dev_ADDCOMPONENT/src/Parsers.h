@@ -2,57 +2,64 @@
 #include "includes.h"
 #include <vector>
 #include "GraphicsSystem.h"
+#include "components/comp_elevator.h"
+#include "MappedFile.h"
+#include "AssetFormats.h"
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
+#include <unordered_set>
 
-struct TGAInfo //stores info about TGA file
-{
-	GLuint width;
-	GLuint height;
-	GLuint bpp; //bits per pixel
-	GLubyte* data; //bytes with the pixel information
+//entity of a prefab file: what parseEntity would create for it
+// - parent - index in prefab of parent entity, -1 for the root
+// - mesh_path, material_path - assets of mesh, if has_mesh. They are looked
+//   up per instance, as ids of materials no instance uses may be recycled
+struct PrefabEntity {
+    std::string name;
+    int parent = -1;
+    Transform transform;
+    bool has_mesh = false, has_light = false, has_collider = false, has_elevator = false;
+    std::string mesh_path, material_path;
+    Light light;
+    Collider collider;
+    comp_elevator elevator;
 };
 
-// Declare necessary structs to identify byte chunks
-struct TChunk {
-
-    uint32_t magic_id;
-    uint32_t num_bytes;
-};
-
-struct THeader {
-
-    uint32_t num_vertexs = 0;
-    uint32_t num_indices = 0;
-    uint32_t primitive_type = 0;
-    uint32_t bytes_per_vtx = 0;
-    uint32_t bytes_per_idx = 0;
-    uint32_t num_subgroups = 0;
-    uint32_t dummy2 = 0;
-    uint32_t dummy3 = 0;
-    char     vertex_type_name[32];
+//entities of a prefab, with the root (first entity of the file) first.
+//Nested prefabs are expanded into it
+struct Prefab {
+    std::vector<PrefabEntity> entities;
 };
 
-// Magics to identify each block
-static const uint32_t magicHeader = 0x44444444;
-static const uint32_t magicVtxs = 0x55554433;
-static const uint32_t magicIdxs = 0x55556677;
-static const uint32_t magicSubGroups = 0x55556688;
-static const uint32_t magicEoF = 0x55558888;
-
 class Parsers {
 private:
-	static TGAInfo* loadTGA(std::string filename);
-
     static int parseEntity(rapidjson::Value & entity,
                                 GraphicsSystem & graphics_system);
 
+    //reads and decodes all meshes, materials and textures used by entities
+    //on worker threads, then uploads them on main thread
+    static void prefetchSceneAssets_(rapidjson::Value & entities,
+                                     GraphicsSystem & graphics_system);
+    static void prefetchAssets_(const std::unordered_set<std::string>& meshes,
+                                const std::unordered_set<std::string>& materials,
+                                GraphicsSystem & graphics_system);
+
+    //shaders used by materials of every scene
+    static void loadSceneShaders_(GraphicsSystem & graphics_system);
+
+    //appends entity of a prefab file, and entities of its own prefab, to prefab.
+    //Returns index of entity in prefab
+    static int addPrefabEntity_(rapidjson::Value & entity, Prefab & prefab);
+    //creates entities of prefab in ECS, returns id of its root
+    static int instantiatePrefab_(const Prefab & prefab, GraphicsSystem & graphics_system);
+
 public:
 
     static std::unordered_map<std::string, int> geometries;
     static std::unordered_map<std::string, int> textures;
     static std::unordered_map<std::string, int> materials;
     static std::unordered_map<std::string, int> shaders;
+    //parsed once per file, and copied for every instance
+    static std::unordered_map<std::string, Prefab> prefabs;
 
 	static bool parseOBJ(std::string filename, 
 						 std::vector<float>& vertices, 
@@ -60,13 +67,31 @@ public:
 						 std::vector<float>& normals,
 						 std::vector<unsigned int>& indices);
 
-    static bool parseBin(std::string filename,
-        std::vector<float>& vertices,
-        std::vector<float>& uvs,
-        std::vector<float>& normals,
-        std::vector<unsigned int>& indices);
+    static bool parseBin(const MappedFile& file,
+        const std::string& filename,
+        MeshView& mesh);
 
 	static GLint parseTexture(std::string filename);
+	//loadTexture reads a .tga, or its cooked .tex, without GL calls (safe on
+	//any thread), uploadTexture creates GL texture from result on main thread and frees it
+	static TGAInfo* loadTexture(const std::string& filename);
+	static TGAInfo* loadTGA(std::string filename);
+	static TGAInfo* loadCookedTexture(const std::string& filename);
+	static GLint uploadTexture(TGAInfo* tgainfo);
+	//replaces the single level of a loaded texture with its full mip chain
+	static void generateMips(TGAInfo* tgainfo);
+
+	//file to read for an asset: its cooked version (.obj -> .mesh, .tga -> .tex,
+	//.scene -> .bscene) if there is one next to it, else filename itself
+	static std::string getCookedFilename(const std::string& filename);
+
+    //parsed prefab file, or null if it could not be read (only reported once)
+    static const Prefab* getPrefab(const std::string& filename);
 
+    //reads compiled version of a .scene instead if there is one
     static bool parseScene(std::string filename, GraphicsSystem& graphics_system);
+    //creates entities of a compiled scene (.bscene). Returns false, without
+    //creating anything, if the file is missing, of another version, corrupt
+    //or older than a prefab it was made from
+    static bool parseBinaryScene(const std::string& filename, GraphicsSystem& graphics_system);
 };
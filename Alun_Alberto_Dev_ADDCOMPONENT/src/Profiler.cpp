@@ -0,0 +1,156 @@
+#include "Profiler.h"
+#include "rapidjson/writer.h"
+#include "rapidjson/stringbuffer.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+std::atomic<bool> Profiler::enabled_{ true };
+thread_local bool Profiler::thread_paused_ = false;
+
+//buffer of calling thread, created on its first zone
+static thread_local void* thread_buffer = nullptr;
+
+Profiler& Profiler::get() {
+    static Profiler instance;
+    return instance;
+}
+
+Profiler::Profiler() {
+    epoch_ = std::chrono::steady_clock::now();
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer_() {
+    if (!thread_buffer) {
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        threads_.emplace_back(new ThreadBuffer());
+        ThreadBuffer& buffer = *threads_.back();
+        buffer.events.resize(EVENTS_PER_THREAD);
+        buffer.index = (int)threads_.size() - 1;
+        buffer.name = "Thread " + std::to_string(buffer.index);
+        thread_buffer = &buffer;
+    }
+    return *(ThreadBuffer*)thread_buffer;
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer_();
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    buffer.name = name;
+}
+
+void Profiler::beginZone() {
+    threadBuffer_().depth++;
+}
+
+void Profiler::endZone(const char* name, int64_t start) {
+    ThreadBuffer& buffer = threadBuffer_();
+    buffer.depth--;
+    uint64_t written = buffer.written.load(std::memory_order_relaxed);
+    ProfileEvent& event = buffer.events[written % EVENTS_PER_THREAD];
+    event.name = name;
+    event.start = start;
+    event.end = now();
+    event.depth = buffer.depth;
+    event.thread = buffer.index;
+    buffer.written.store(written + 1, std::memory_order_release);
+}
+
+//appends events of buffer which started at or after from, oldest first
+void Profiler::copyEvents_(ThreadBuffer& buffer, int64_t from, std::vector<ProfileEvent>& result) {
+    uint64_t written = buffer.written.load(std::memory_order_acquire);
+    uint64_t first = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+
+    //events are stored in order they end, so walk back from newest until
+    //they end before from. Parents end after children, so none are missed
+    uint64_t begin = written;
+    while (begin > first && buffer.events[(begin - 1) % EVENTS_PER_THREAD].end >= from)
+        begin--;
+    for (uint64_t i = begin; i < written; i++) {
+        const ProfileEvent& event = buffer.events[i % EVENTS_PER_THREAD];
+        if (event.start >= from) result.push_back(event);
+    }
+}
+
+void Profiler::beginFrame() {
+    int64_t frame_end = now();
+    last_frame_.clear();
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        for (auto& buffer : threads_)
+            copyEvents_(*buffer, frame_start_, last_frame_);
+    }
+    std::sort(last_frame_.begin(), last_frame_.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+        if (a.thread != b.thread) return a.thread < b.thread;
+        if (a.start != b.start) return a.start < b.start;
+        return a.depth < b.depth;
+    });
+    last_frame_ms_ = (frame_end - frame_start_) / 1000000.0;
+    frame_start_ = frame_end;
+}
+
+int Profiler::getNumThreads() {
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    return (int)threads_.size();
+}
+
+std::string Profiler::getThreadName(int thread) {
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    if (thread < 0 || thread >= (int)threads_.size()) return "";
+    return threads_[thread]->name;
+}
+
+//writes all recorded zones as complete ('X') events, with times in microseconds
+bool Profiler::exportChromeTrace(const std::string& filename) {
+    std::vector<ProfileEvent> events;
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex_);
+        for (auto& buffer : threads_) {
+            copyEvents_(*buffer, 0, events);
+            names.push_back(buffer->name);
+        }
+    }
+
+    rapidjson::StringBuffer string_buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+    writer.StartObject();
+    writer.Key("traceEvents");
+    writer.StartArray();
+    for (size_t i = 0; i < names.size(); i++) {
+        writer.StartObject();
+        writer.Key("name"); writer.String("thread_name");
+        writer.Key("ph"); writer.String("M");
+        writer.Key("pid"); writer.Int(1);
+        writer.Key("tid"); writer.Int((int)i);
+        writer.Key("args");
+        writer.StartObject();
+        writer.Key("name"); writer.String(names[i].c_str());
+        writer.EndObject();
+        writer.EndObject();
+    }
+    for (auto& event : events) {
+        writer.StartObject();
+        writer.Key("name"); writer.String(event.name);
+        writer.Key("ph"); writer.String("X");
+        writer.Key("ts"); writer.Double(event.start / 1000.0);
+        writer.Key("dur"); writer.Double((event.end - event.start) / 1000.0);
+        writer.Key("pid"); writer.Int(1);
+        writer.Key("tid"); writer.Int(event.thread);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "ERROR: Could not write profile trace " << filename << std::endl;
+        return false;
+    }
+    file.write(string_buffer.GetString(), string_buffer.GetSize());
+    return true;
+}
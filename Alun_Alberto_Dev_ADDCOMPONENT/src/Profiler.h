@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//set to 0 to compile all profile zones out
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+//one finished zone. Times are in nanoseconds since profiler was created
+struct ProfileEvent {
+    const char* name; //not copied, so must outlive profiler (e.g. a literal)
+    int64_t start;
+    int64_t end;
+    int depth; //number of zones it is nested in, on its thread
+    int thread; //index of thread which recorded it
+};
+
+// CPU profiler
+// - PROFILE_SCOPE(name) times the rest of the enclosing block. Zones nest
+// - each thread records its finished zones into its own ring buffer, so
+//   recording takes no lock, and only the latest EVENTS_PER_THREAD are kept
+// - beginFrame, called by main loop, gathers the zones of the frame which
+//   just ended for the editor panel
+// - a thread can pause recording for work which spans frames (background jobs),
+//   so beginFrame and exportChromeTrace never read a buffer being written
+// - exportChromeTrace writes everything still in the buffers in the Chrome
+//   trace format (open in chrome://tracing or ui.perfetto.dev)
+// When disabled at runtime a zone costs one relaxed atomic load
+class Profiler {
+public:
+    static const int EVENTS_PER_THREAD = 1 << 16;
+
+    static Profiler& get();
+
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed) && !thread_paused_; }
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    //zones of calling thread are not recorded while paused
+    void setThreadPaused(bool paused) { thread_paused_ = paused; }
+
+    //name of calling thread in panel and trace
+    void setThreadName(const std::string& name);
+
+    //ends current frame and starts a new one. Must be called while no other
+    //thread is recording (e.g. between frames, when all jobs but background
+    //ones, which are paused, have finished). Same for exportChromeTrace
+    void beginFrame();
+
+    //zones of last complete frame, sorted by thread and start time
+    const std::vector<ProfileEvent>& getLastFrame() { return last_frame_; }
+    double getLastFrameMs() { return last_frame_ms_; }
+    int getNumThreads();
+    std::string getThreadName(int thread);
+
+    bool exportChromeTrace(const std::string& filename);
+
+    //used by ProfileZone
+    int64_t now();
+    void endZone(const char* name, int64_t start);
+    void beginZone();
+
+private:
+    struct ThreadBuffer {
+        std::vector<ProfileEvent> events; //ring
+        std::atomic<uint64_t> written{ 0 }; //total events ever recorded
+        int depth = 0;
+        int index = 0;
+        std::string name;
+    };
+
+    Profiler();
+    ThreadBuffer& threadBuffer_();
+    void copyEvents_(ThreadBuffer& buffer, int64_t from, std::vector<ProfileEvent>& result);
+
+    static std::atomic<bool> enabled_;
+    static thread_local bool thread_paused_;
+    std::chrono::steady_clock::time_point epoch_;
+
+    //buffers are never freed, so they outlive their threads
+    std::mutex threads_mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads_;
+
+    int64_t frame_start_ = 0;
+    double last_frame_ms_ = 0.0;
+    std::vector<ProfileEvent> last_frame_;
+};
+
+//times its lifetime, see PROFILE_SCOPE
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name_(name), active_(Profiler::isEnabled()) {
+        if (active_) {
+            Profiler::get().beginZone();
+            start_ = Profiler::get().now();
+        }
+    }
+    ~ProfileZone() {
+        if (active_) Profiler::get().endZone(name_, start_);
+    }
+
+private:
+    const char* name_;
+    bool active_;
+    int64_t start_ = 0;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "render/RenderDevice.h"
 #include <vector>
 #include <fstream>
 #include <sstream>
@@ -26,7 +27,7 @@ Shader::Shader() {}
 bool Shader::setUniform(UniformID id, const int data) {
     GLuint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniform1i(loc, data);
+        GPU->state.uniform1i(loc, data);
         return true;
     }
     return false;
@@ -35,7 +36,7 @@ bool Shader::setUniform(UniformID id, const int data) {
 bool Shader::setUniform(UniformID id, const float data) {
     GLuint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniform1f(loc, data);
+        GPU->state.uniform1f(loc, data);
         return true;
     }
     return false;
@@ -45,7 +46,7 @@ bool Shader::setUniform(UniformID id, const float data) {
 bool Shader::setUniform(UniformID id, const lm::vec3& data) {
     GLuint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniform3fv(loc, 1, data.value_);
+        GPU->state.uniform3fv(loc, 1, data.value_);
         return true;
     }
     return false;
@@ -55,7 +56,7 @@ bool Shader::setUniform(UniformID id, const lm::vec3& data) {
 bool Shader::setUniform(UniformID id, const lm::mat4& data) {
     GLuint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniformMatrix4fv(loc, 1, GL_FALSE, data.m);
+        GPU->state.uniformMatrix4fv(loc, 1, GL_FALSE, data.m);
         return true;
     }
     return false;
@@ -63,12 +64,11 @@ bool Shader::setUniform(UniformID id, const lm::mat4& data) {
 //texture
 bool Shader::setTexture(UniformID id, GLuint tex_id, GLuint unit) {
     //get texture id and bind it
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
+    GPU->state.bindTexture(unit, GL_TEXTURE_2D, tex_id);
     // tell sampler which slot its in
     GLint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniform1i(loc, unit);
+        GPU->state.uniform1i(loc, unit);
         return true;
     }
     return false;
@@ -76,12 +76,11 @@ bool Shader::setTexture(UniformID id, GLuint tex_id, GLuint unit) {
 //texture cube
 bool Shader::setTextureCube(UniformID id, GLuint tex_id, GLuint unit) {
     //get texture id and bind it
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, tex_id);
+    GPU->state.bindTexture(unit, GL_TEXTURE_CUBE_MAP, tex_id);
     // tell sampler which slot its in
     GLint loc = getUniformLocation(id);
     if (loc != -1) {
-        glUniform1i(loc, unit);
+        GPU->state.uniform1i(loc, unit);
         return true;
     }
     return false;
@@ -111,12 +110,12 @@ GLuint Shader::compileFromStrings(std::string vsh, std::string fsh) {
 
 GLuint Shader::makeVertexShader(const char* shaderSource)
 {
-    GLuint vertexShaderID=glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShaderID,1,(const GLchar**)&shaderSource, NULL);
-    glCompileShader(vertexShaderID);
+    GLuint vertexShaderID=GPU->createShader(GL_VERTEX_SHADER);
+    GPU->shaderSource(vertexShaderID,1,(const GLchar**)&shaderSource, NULL);
+    GPU->compileShader(vertexShaderID);
     
     GLint compile=0;
-    glGetShaderiv(vertexShaderID,GL_COMPILE_STATUS,&compile);
+    GPU->getShaderiv(vertexShaderID,GL_COMPILE_STATUS,&compile);
     
     //we want to see the compile log if we are in debug (to check warnings)
     if (!compile)
@@ -135,12 +134,12 @@ GLuint Shader::makeVertexShader(const char* shaderSource)
 }
 GLuint Shader::makeFragmentShader(const char* shaderSource)
 {
-    GLuint fragmentShaderID=glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShaderID,1,(const GLchar**)&shaderSource, NULL);
-    glCompileShader(fragmentShaderID);
+    GLuint fragmentShaderID=GPU->createShader(GL_FRAGMENT_SHADER);
+    GPU->shaderSource(fragmentShaderID,1,(const GLchar**)&shaderSource, NULL);
+    GPU->compileShader(fragmentShaderID);
     
     GLint compile=0;
-    glGetShaderiv(fragmentShaderID,GL_COMPILE_STATUS,&compile);
+    GPU->getShaderiv(fragmentShaderID,GL_COMPILE_STATUS,&compile);
     
     //we want to see the compile log if we are in debug (to check warnings)
     if (!compile)
@@ -160,13 +159,13 @@ GLuint Shader::makeFragmentShader(const char* shaderSource)
 void Shader::saveShaderInfoLog(GLuint obj)
 {
     int len = 0;
-    glGetShaderiv(obj, GL_INFO_LOG_LENGTH, &len);
+    GPU->getShaderiv(obj, GL_INFO_LOG_LENGTH, &len);
     
     if (len > 0)
     {
         char* ptr = new char[len+1];
         GLsizei written=0;
-        glGetShaderInfoLog(obj, len, &written, ptr);
+        GPU->getShaderInfoLog(obj, len, &written, ptr);
         ptr[written-1]='\0';
         log.append(ptr);
         delete[] ptr;
@@ -178,13 +177,13 @@ void Shader::saveShaderInfoLog(GLuint obj)
 void Shader::saveProgramInfoLog(GLuint obj)
 {
     int len = 0;
-    glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &len);
+    GPU->getProgramiv(obj, GL_INFO_LOG_LENGTH, &len);
     
     if (len > 0)
     {
         char* ptr = new char[len+1];
         GLsizei written=0;
-        glGetProgramInfoLog(obj, len, &written, ptr);
+        GPU->getProgramInfoLog(obj, len, &written, ptr);
         ptr[written-1]='\0';
         log.append(ptr);
         delete[] ptr;
@@ -195,13 +194,13 @@ void Shader::saveProgramInfoLog(GLuint obj)
 
 void Shader::makeShaderProgram(GLuint vertexShaderID,GLuint fragmentShaderID)
 {
-    program=glCreateProgram();
-    glAttachShader(program, vertexShaderID);
-    glAttachShader(program,fragmentShaderID);
+    program=GPU->createProgram();
+    GPU->attachShader(program, vertexShaderID);
+    GPU->attachShader(program,fragmentShaderID);
     
-    glLinkProgram(program);
+    GPU->linkProgram(program);
     GLint link_ok = GL_FALSE;
-    glGetProgramiv(program, GL_LINK_STATUS, &link_ok);
+    GPU->getProgramiv(program, GL_LINK_STATUS, &link_ok);
     if (!link_ok) {
         fprintf(stderr, "glLinkProgram:");
         saveProgramInfoLog(program);
@@ -212,7 +211,7 @@ void Shader::makeShaderProgram(GLuint vertexShaderID,GLuint fragmentShaderID)
 }
 
 GLint Shader::bindAttribute(const char* attribute_name) {
-    GLint attribute_ID = glGetAttribLocation(program, attribute_name);
+    GLint attribute_ID = GPU->getAttribLocation(program, attribute_name);
     if (attribute_ID == -1) {
         fprintf(stderr, "Could not bind attribute %s\n", attribute_name);
         return 0;
@@ -232,8 +231,18 @@ void Shader::initUniforms_() {
 	{
 		std::string uniform_name = element.first;
 		UniformID uniform_id = element.second;
-		uniform_locations_[uniform_id] = glGetUniformLocation(program, uniform_name.c_str());
-	}    
+		uniform_locations_[uniform_id] = GPU->getUniformLocation(program, uniform_name.c_str());
+	}
+
+	//connect uniform blocks to their binding point
+	uniform_blocks_ = std::vector<bool>(UNIFORM_BLOCKS_COUNT, false);
+	for (std::pair<std::string, UniformBlockID> element : uniform_block_string2id_)
+	{
+		GLuint block_index = GPU->getUniformBlockIndex(program, element.first.c_str());
+		if (block_index == GL_INVALID_INDEX) continue;
+		GPU->uniformBlockBinding(program, block_index, element.second);
+		uniform_blocks_[element.second] = true;
+	}
 }
 
 //Returns location of uniform with given enum
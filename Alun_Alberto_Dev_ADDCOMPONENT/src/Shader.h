@@ -45,11 +45,26 @@ const std::unordered_map<std::string, UniformID> uniform_string2id_ = {
 	{ "u_num_lights", U_NUM_LIGHTS }
 };
 
+//Uniform block IDs. Each is also the binding point its buffer is bound to,
+//so shaders declaring a block read whatever buffer Graphics System binds there
+enum UniformBlockID {
+	UB_FRAME, //camera and lights, see FrameBlock
+	UB_MATERIAL, //material parameters, see MaterialBlock
+	UNIFORM_BLOCKS_COUNT
+};
+
+const std::unordered_map<std::string, UniformBlockID> uniform_block_string2id_ = {
+	{ "FrameBlock", UB_FRAME },
+	{ "MaterialBlock", UB_MATERIAL }
+};
+
 
 class Shader {
 private:
 	//stores, for each uniform enum, it's location
 	std::vector<GLuint> uniform_locations_;
+	//stores, for each uniform block enum, whether shader declares it
+	std::vector<bool> uniform_blocks_;
 	void initUniforms_();
     
 public:
@@ -69,6 +84,7 @@ public:
     
 	//
     GLuint getUniformLocation(UniformID name);
+    bool hasUniformBlock(UniformBlockID id) { return uniform_blocks_.size() && uniform_blocks_[id]; }
     
     bool setUniform(UniformID id, const int data);
     bool setUniform(UniformID id, const float data);
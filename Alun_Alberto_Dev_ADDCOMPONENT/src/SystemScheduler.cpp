@@ -0,0 +1,63 @@
+#include "SystemScheduler.h"
+#include "Profiler.h"
+
+void SystemScheduler::addSystem(const std::string& name, unsigned int read_mask, unsigned int write_mask,
+                                bool main_thread, SystemFunc func) {
+    SystemEntry entry = { name, read_mask, write_mask, main_thread, func };
+
+    //join last phase if new system does not conflict with any of its systems
+    int phase = phase_of_system_.empty() ? 0 : phase_of_system_.back();
+    for (size_t i = 0; i < systems_.size(); i++) {
+        if (phase_of_system_[i] == phase && conflict_(systems_[i], entry)) {
+            phase++;
+            break;
+        }
+    }
+
+    systems_.push_back(entry);
+    phase_of_system_.push_back(phase);
+}
+
+void SystemScheduler::update(float dt) {
+    JobSystem& jobs = JobSystem::get();
+
+    size_t phase_start = 0;
+    while (phase_start < systems_.size()) {
+        size_t phase_end = phase_start;
+        while (phase_end < systems_.size() && phase_of_system_[phase_end] == phase_of_system_[phase_start])
+            phase_end++;
+
+        //nothing to overlap with, so a job would only add dispatch and wait
+        if (phase_end - phase_start == 1) {
+            PROFILE_SCOPE(systems_[phase_start].name.c_str());
+            systems_[phase_start].func(dt);
+            phase_start = phase_end;
+            continue;
+        }
+
+        //kick off worker systems first, then do main thread ones while they run
+        JobCounter counter;
+        for (size_t i = phase_start; i < phase_end; i++) {
+            if (systems_[i].main_thread) continue;
+            SystemEntry& system = systems_[i];
+            jobs.run([&system, dt]() {
+                PROFILE_SCOPE(system.name.c_str());
+                system.func(dt);
+            }, &counter);
+        }
+        for (size_t i = phase_start; i < phase_end; i++) {
+            if (!systems_[i].main_thread) continue;
+            PROFILE_SCOPE(systems_[i].name.c_str());
+            systems_[i].func(dt);
+        }
+        jobs.wait(counter);
+
+        phase_start = phase_end;
+    }
+}
+
+//two systems conflict if either one writes something the other one uses
+bool SystemScheduler::conflict_(const SystemEntry& a, const SystemEntry& b) {
+    return (a.write_mask & (b.read_mask | b.write_mask)) != 0 ||
+           (b.write_mask & a.read_mask) != 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Components.h"
+#include "JobSystem.h"
+#include <string>
+
+//bit for component type T in a SystemScheduler read/write mask
+template <typename T>
+unsigned int componentMask() { return 1u << type2int<T>::result; }
+
+//masks for shared data which is not a component
+const unsigned int RESOURCE_INPUT = 1u << 16;
+//TransformWorld shares the bit of Transform, as hot fields do. Systems which
+//only read world matrices use this instead, so they don't conflict with ones
+//moving local transforms
+const unsigned int RESOURCE_WORLD_MATRICES = 1u << 17;
+const unsigned int RESOURCE_ALL = 0xFFFFFFFF;
+
+// Runs the per-frame systems of the game
+// Each system declares the components it reads and writes. Systems are
+// grouped, in the order they were added, into phases of consecutive systems
+// which do not conflict with each other (no system writes something another
+// one reads or writes). Systems of a phase run at the same time: those
+// flagged main_thread (anything touching OpenGL or ImGui) on the calling
+// thread, in order, and the rest as jobs on the JobSystem. A phase of a
+// single system just runs it on the calling thread
+class SystemScheduler {
+public:
+    typedef std::function<void(float)> SystemFunc;
+
+    void addSystem(const std::string& name, unsigned int read_mask, unsigned int write_mask,
+                   bool main_thread, SystemFunc func);
+    //systems must all be added before first update, as profile zones keep
+    //pointers to their names
+    void update(float dt);
+
+    //phase index of each system, in order added
+    const std::vector<int>& getPhases() { return phase_of_system_; }
+
+private:
+    struct SystemEntry {
+        std::string name;
+        unsigned int read_mask;
+        unsigned int write_mask;
+        bool main_thread;
+        SystemFunc func;
+    };
+    std::vector<SystemEntry> systems_;
+    std::vector<int> phase_of_system_;
+
+    bool conflict_(const SystemEntry& a, const SystemEntry& b);
+};
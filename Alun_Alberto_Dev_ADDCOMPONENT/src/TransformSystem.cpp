@@ -0,0 +1,105 @@
+#include "TransformSystem.h"
+#include "extern.h"
+#include <algorithm>
+#include <cstring>
+
+//nothing to initialise so far, order is built lazily on first update
+void TransformSystem::init() {
+
+}
+
+void TransformSystem::update(float dt) {
+    auto& transforms = ECS.getAllComponents<Transform>();
+    auto& worlds = ECS.getAllComponents<TransformWorld>();
+
+    //rebuild order if components were added/removed or any parent was changed
+    bool rebuild = !order_valid_ || structure_version_ != ECS.structure_version;
+    for (size_t i = 0; i < transforms.size() && !rebuild; i++) {
+        if (transforms[i].parent != transforms[i].cached_parent) rebuild = true;
+    }
+    if (rebuild) buildOrder_(transforms);
+
+    int num_transforms = (int)transforms.size();
+    for (int i : order_) {
+        Transform& t = transforms[i];
+        TransformWorld& w = worlds[i];
+        bool has_parent = t.parent >= 0 && t.parent < num_transforms;
+
+        //dirty if local matrix or parent changed since last update, or parent moved
+        bool dirty = t.parent != t.cached_parent ||
+                     memcmp(t.m, t.cached_local.m, sizeof(t.m)) != 0 ||
+                     (has_parent && worlds[t.parent].world_changed);
+
+        w.world_changed = dirty;
+        if (!dirty) continue;
+
+        //first update has nothing to interpolate from
+        bool first = t.cached_parent == -2;
+        w.prev_world_matrix = w.world_matrix;
+        t.cached_local = t;
+        t.cached_parent = t.parent;
+        if (has_parent)
+            w.world_matrix = worlds[t.parent].world_matrix * t;
+        else
+            w.world_matrix = t;
+        if (first) w.prev_world_matrix = w.world_matrix;
+    }
+}
+
+//blends each element of the matrices. For the small rotations of one step this
+//is close enough to a proper rotation blend, and keeps translation exact.
+//Only touches hot TransformWorld fields
+void TransformSystem::interpolate(float alpha) {
+    auto& worlds = ECS.getAllComponents<TransformWorld>();
+    for (auto& w : worlds) {
+        lm::mat4 target = w.world_matrix;
+        //only transforms which moved in last step are between two states
+        if (w.world_changed) {
+            for (int k = 0; k < 16; k++)
+                target.m[k] = w.prev_world_matrix.m[k] + (w.world_matrix.m[k] - w.prev_world_matrix.m[k]) * alpha;
+        }
+        w.render_changed = memcmp(target.m, w.render_matrix.m, sizeof(target.m)) != 0;
+        if (w.render_changed) w.render_matrix = target;
+    }
+}
+
+//builds order_ with a breadth first walk from all root transforms
+void TransformSystem::buildOrder_(std::vector<Transform>& transforms) {
+    int num_transforms = (int)transforms.size();
+    first_child_.assign(num_transforms, -1);
+    next_sibling_.assign(num_transforms, -1);
+    order_.clear();
+    order_.reserve(num_transforms);
+
+    //build child lists, walking backwards so children keep their array order
+    for (int i = num_transforms - 1; i >= 0; i--) {
+        int parent = transforms[i].parent;
+        if (parent >= 0 && parent < num_transforms && parent != i) {
+            next_sibling_[i] = first_child_[parent];
+            first_child_[parent] = i;
+        }
+        else {
+            order_.push_back(i);
+        }
+    }
+    std::reverse(order_.begin(), order_.end());
+
+    //append children of every visited transform
+    for (size_t k = 0; k < order_.size(); k++) {
+        for (int c = first_child_[order_[k]]; c != -1; c = next_sibling_[c])
+            order_.push_back(c);
+    }
+
+    //transforms caught in a parent loop are never reached, so add them at the
+    //end to make sure they are at least updated
+    if ((int)order_.size() < num_transforms) {
+        std::vector<bool> visited(num_transforms, false);
+        for (int i : order_) visited[i] = true;
+        for (int i = 0; i < num_transforms; i++) {
+            if (!visited[i]) order_.push_back(i);
+        }
+    }
+
+    structure_version_ = ECS.structure_version;
+    order_valid_ = true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "includes.h"
+#include "Components.h"
+
+// Updates the cached world matrix (in TransformWorld) of every Transform in the ECS.
+// Transforms are visited in a flat list sorted so that parents always come
+// before their children, so each world matrix is a single multiply with the
+// (already updated) parent world matrix. Only transforms whose local matrix
+// or parent changed, or whose parent moved, are recomputed.
+// update runs once per simulation step; interpolate once per rendered frame
+class TransformSystem {
+public:
+    void init();
+    void update(float dt);
+    //sets render matrices between world matrices of previous and last step,
+    //alpha being the fraction of a step rendering is ahead of the last one
+    void interpolate(float alpha);
+private:
+    //transform indices, parents before children
+    std::vector<int> order_;
+    //scratch child lists used to build order_
+    std::vector<int> first_child_;
+    std::vector<int> next_sibling_;
+    //ECS structure version order_ was built for
+    unsigned int structure_version_ = 0;
+    bool order_valid_ = false;
+
+    void buildOrder_(std::vector<Transform>& transforms);
+};
@@ -0,0 +1,446 @@
+#include "Cooker.h"
+#include "../Parsers.h"
+#include "rapidjson/document.h"
+#include "rapidjson/istreamwrapper.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+bool Cooker::cookMesh(const std::string& source, const std::string& destination,
+                      const VertexFormat& format, const MeshOptimizerSettings& settings) {
+    std::vector<GLfloat> vertices, uvs, normals;
+    std::vector<GLuint> indices;
+    if (!Parsers::parseOBJ(source, vertices, uvs, normals, indices)) {
+        std::cerr << "ERROR: Could not parse mesh file " << source << std::endl;
+        return false;
+    }
+    size_t num_vertices = vertices.size() / 3;
+    if (num_vertices == 0 || indices.size() % 3 != 0) {
+        std::cerr << "ERROR: Mesh file has no triangles " << source << std::endl;
+        return false;
+    }
+
+    float acmr_before = MeshOptimizer::computeACMR(indices, num_vertices, settings.cache_size);
+    MeshOptimizer::optimizeTriangles(indices, vertices, settings);
+    MeshOptimizer::optimizeVertices(indices, vertices, uvs, normals);
+    num_vertices = vertices.size() / 3;
+    float acmr_after = MeshOptimizer::computeACMR(indices, num_vertices, settings.cache_size);
+
+    //pack exactly as the engine would, so it can copy the chunks as they are
+    VertexSource vertex_source;
+    vertex_source.num_vertices = num_vertices;
+    vertex_source.positions = (const unsigned char*)vertices.data();
+    vertex_source.position_stride = 3 * sizeof(GLfloat);
+    if (uvs.size() == num_vertices * 2) {
+        vertex_source.uvs = (const unsigned char*)uvs.data();
+        vertex_source.uv_stride = 2 * sizeof(GLfloat);
+    }
+    if (normals.size() == num_vertices * 3) {
+        vertex_source.normals = (const unsigned char*)normals.data();
+        vertex_source.normal_stride = 3 * sizeof(GLfloat);
+    }
+    VertexLayout layout;
+    std::vector<unsigned char> packed_vertices, packed_indices;
+    packVertices(vertex_source, format, layout, packed_vertices);
+    GLenum index_type = packIndices(indices.data(), indices.size(), sizeof(GLuint), num_vertices, packed_indices);
+
+    lm::vec3 min_corner(vertices[0], vertices[1], vertices[2]), max_corner = min_corner;
+    for (size_t i = 1; i < num_vertices; i++) {
+        const GLfloat* position = &vertices[i * 3];
+        min_corner = lm::vec3(std::min(min_corner.x, position[0]), std::min(min_corner.y, position[1]), std::min(min_corner.z, position[2]));
+        max_corner = lm::vec3(std::max(max_corner.x, position[0]), std::max(max_corner.y, position[1]), std::max(max_corner.z, position[2]));
+    }
+    lm::vec3 center = (min_corner + max_corner) * 0.5f;
+    lm::vec3 half_width = (max_corner - min_corner) * 0.5f;
+    float bounds[6] = { center.x, center.y, center.z, half_width.x, half_width.y, half_width.z };
+
+    THeader header;
+    header.num_vertexs = (uint32_t)num_vertices;
+    header.num_indices = (uint32_t)indices.size();
+    header.primitive_type = GL_TRIANGLES;
+    header.bytes_per_vtx = layout.stride;
+    header.bytes_per_idx = index_type == GL_UNSIGNED_SHORT ? 2 : 4;
+    header.flags = MESH_FLAG_AABB | MESH_FLAG_OPTIMIZED;
+    memset(header.vertex_type_name, 0, sizeof(header.vertex_type_name));
+    std::string type_name = getSourceFormat(vertex_source, format).getTypeName(vertex_source.uvs != nullptr, vertex_source.normals != nullptr);
+    strncpy(header.vertex_type_name, type_name.c_str(), sizeof(header.vertex_type_name) - 1);
+
+    std::ofstream file(destination, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "ERROR: Could not create mesh file " << destination << std::endl;
+        return false;
+    }
+    if (!writeChunk_(file, magicHeader, &header, sizeof(header)) ||
+        !writeChunk_(file, magicAABB, bounds, sizeof(bounds)) ||
+        !writeChunk_(file, magicVtxs, packed_vertices.data(), packed_vertices.size()) ||
+        !writeChunk_(file, magicIdxs, packed_indices.data(), packed_indices.size()) ||
+        !writeChunk_(file, magicEoF, nullptr, 0)) {
+        std::cerr << "ERROR: Could not write mesh file " << destination << std::endl;
+        return false;
+    }
+
+    std::cout << source << " -> " << destination << ": " << num_vertices << " vertices ("
+              << type_name << "), " << indices.size() / 3 << " triangles, ACMR "
+              << acmr_before << " -> " << acmr_after << std::endl;
+    return true;
+}
+
+bool Cooker::cookTexture(const std::string& source, const std::string& destination) {
+    TGAInfo* tgainfo = Parsers::loadTGA(source);
+    if (tgainfo == nullptr) {
+        std::cerr << "ERROR: Could not load TGA file " << source << std::endl;
+        return false;
+    }
+
+    Parsers::generateMips(tgainfo);
+    TTextureHeader header;
+    header.width = tgainfo->width;
+    header.height = tgainfo->height;
+    header.bpp = tgainfo->bpp;
+    header.num_levels = tgainfo->num_levels;
+    std::vector<unsigned char> levels(tgainfo->data, tgainfo->data +
+        mipChainBytes(header.width, header.height, header.bpp / 8, header.num_levels));
+    free(tgainfo->data);
+    delete tgainfo;
+
+    std::ofstream file(destination, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "ERROR: Could not create texture file " << destination << std::endl;
+        return false;
+    }
+    if (!writeChunk_(file, magicTextureHeader, &header, sizeof(header)) ||
+        !writeChunk_(file, magicTextureLevels, levels.data(), levels.size()) ||
+        !writeChunk_(file, magicEoF, nullptr, 0)) {
+        std::cerr << "ERROR: Could not write texture file " << destination << std::endl;
+        return false;
+    }
+
+    std::cout << source << " -> " << destination << ": " << header.width << "x" << header.height
+              << ", " << header.num_levels << " levels" << std::endl;
+    return true;
+}
+
+//one entity of a .scene with its prefab expanded: what parseEntity would create
+struct SceneEntity {
+    std::string name;
+    std::string parent; //name, for entities of the scene file
+    int prefab_parent = -1; //index, for entities added by a prefab
+    std::string prefab; //file entity was made from, if any
+    lm::mat4 matrix;
+    bool has_mesh = false, has_light = false, has_collider = false, has_elevator = false;
+    std::string mesh, material;
+    TSceneLight light;
+    TSceneCollider collider;
+    TSceneElevator elevator;
+};
+
+static bool readSceneVec3(rapidjson::Value& object, const char* name, float* result) {
+    if (!object.IsObject() || !object.HasMember(name) || !object[name].IsArray() || object[name].Size() < 3)
+        return false;
+    for (rapidjson::SizeType i = 0; i < 3; i++) {
+        if (!object[name][i].IsNumber()) return false;
+        result[i] = object[name][i].GetFloat();
+    }
+    return true;
+}
+
+static int readSceneEntity(rapidjson::Value& json, std::vector<SceneEntity>& scene, int depth = 0);
+
+//appends entities of a prefab to scene, root first, and links them like
+//Parsers::getPrefab does. Returns index of root, or -1
+static int readScenePrefab(const std::string& filename, std::vector<SceneEntity>& scene, int depth) {
+    std::ifstream json_file(filename);
+    rapidjson::IStreamWrapper json_stream(json_file);
+    rapidjson::Document prefab;
+    prefab.ParseStream(json_stream);
+    if (prefab.HasParseError() || !prefab.IsObject() || !prefab.HasMember("entities") ||
+        !prefab["entities"].IsArray() || prefab["entities"].Size() == 0) {
+        std::cerr << "ERROR: Could not read prefab " << filename << std::endl;
+        return -1;
+    }
+
+    rapidjson::Value& entities = prefab["entities"];
+    std::vector<int> indices(entities.Size());
+    for (rapidjson::SizeType i = 0; i < entities.Size(); i++) {
+        indices[i] = readSceneEntity(entities[i], scene, depth + 1);
+        if (indices[i] == -1) return -1;
+    }
+    for (rapidjson::SizeType i = 1; i < entities.Size(); i++) {
+        int parent = indices[0];
+        if (entities[i].HasMember("parent")) {
+            if (!entities[i]["parent"].IsString()) return -1;
+            std::string parent_name = entities[i]["parent"].GetString();
+            rapidjson::SizeType j = 0;
+            while (j < entities.Size() && (j == i || scene[indices[j]].name != parent_name)) j++;
+            if (j < entities.Size()) parent = indices[j];
+            else std::cerr << "ERROR: Parent " << parent_name << " is not in prefab " << filename << std::endl;
+        }
+        scene[indices[i]].prefab_parent = parent;
+    }
+    return indices[0];
+}
+
+//appends entity from json to scene, with the entities of its prefab. Its own
+//fields go over whatever its prefab set. Returns its index, or -1 on fields
+//the json loader would crash on
+static int readSceneEntity(rapidjson::Value& json, std::vector<SceneEntity>& scene, int depth) {
+    if (!json.IsObject()) return -1;
+    const int index = (int)scene.size();
+    if (json.HasMember("prefab")) {
+        if (!json["prefab"].IsString() || depth >= 8) return -1;
+        if (readScenePrefab(json["prefab"].GetString(), scene, depth) == -1) return -1;
+        scene[index].prefab = json["prefab"].GetString();
+    }
+    else
+        scene.emplace_back();
+    SceneEntity& entity = scene[index];
+    entity.name = json.HasMember("name") && json["name"].IsString() ? json["name"].GetString() : "";
+
+    if (json.HasMember("transform")) {
+        lm::vec3 translation, rotation, scale;
+        if (!readSceneVec3(json["transform"], "translation", &translation.x) ||
+            !readSceneVec3(json["transform"], "rotation", &rotation.x) ||
+            !readSceneVec3(json["transform"], "scale", &scale.x))
+            return -1;
+        Transform::applySceneTransform(entity.matrix, translation, rotation, scale);
+    }
+    if (json.HasMember("render")) {
+        rapidjson::Value& render = json["render"];
+        if (!render.IsObject() || !render.HasMember("mesh") || !render["mesh"].IsString() ||
+            !render.HasMember("materials") || !render["materials"].IsArray() ||
+            render["materials"].Size() == 0 || !render["materials"][0].IsString())
+            return -1;
+        entity.has_mesh = true;
+        entity.mesh = render["mesh"].GetString();
+        entity.material = render["materials"][0].GetString();
+    }
+    if (json.HasMember("light")) {
+        if (!readSceneVec3(json["light"], "color", entity.light.color)) return -1;
+        entity.has_light = true;
+    }
+    if (json.HasMember("collider")) {
+        rapidjson::Value& collider = json["collider"];
+        if (!collider.IsObject() || !collider.HasMember("type") || !collider["type"].IsString()) return -1;
+        //like Collider::Load, a type other than box keeps the shape set by prefab
+        if (!entity.has_collider) entity.collider.type = SCENE_COLLIDER_DEFAULT;
+        entity.has_collider = true;
+        if (std::string(collider["type"].GetString()) == "box") {
+            entity.collider.type = ColliderTypeBox;
+            if (!readSceneVec3(collider, "center", entity.collider.center) ||
+                !readSceneVec3(collider, "halfwidth", entity.collider.halfwidth))
+                return -1;
+        }
+    }
+    if (json.HasMember("elevator")) {
+        rapidjson::Value& elevator = json["elevator"];
+        if (!readSceneVec3(elevator, "direction", entity.elevator.direction) ||
+            !elevator.HasMember("Velocitat") || !elevator["Velocitat"].IsNumber() ||
+            !elevator.HasMember("Automatic") || !elevator["Automatic"].IsBool())
+            return -1;
+        entity.has_elevator = true;
+        entity.elevator.speed = elevator["Velocitat"].GetFloat();
+        entity.elevator.automatic = elevator["Automatic"].GetBool() ? 1 : 0;
+    }
+    return index;
+}
+
+//offset of string in table, adding it the first time
+static uint32_t addSceneString(const std::string& value, std::vector<char>& strings,
+                               std::unordered_map<std::string, uint32_t>& offsets) {
+    auto found = offsets.find(value);
+    if (found != offsets.end()) return found->second;
+    uint32_t offset = (uint32_t)strings.size();
+    strings.insert(strings.end(), value.begin(), value.end());
+    strings.push_back('\0');
+    offsets[value] = offset;
+    return offset;
+}
+
+//appends records of a table to file data, 4 byte aligned, and fills its info
+template<typename T>
+static void addSceneTable(std::vector<unsigned char>& data, TSceneTableInfo& info, const std::vector<T>& records) {
+    data.resize((data.size() + 3) & ~(size_t)3, 0);
+    info.offset = (uint32_t)data.size();
+    info.count = (uint32_t)records.size();
+    info.record_bytes = sizeof(T);
+    const unsigned char* bytes = (const unsigned char*)records.data();
+    data.insert(data.end(), bytes, bytes + records.size() * sizeof(T));
+}
+
+bool Cooker::cookScene(const std::string& source, const std::string& destination) {
+    std::ifstream json_file(source);
+    rapidjson::IStreamWrapper json_stream(json_file);
+    rapidjson::Document json;
+    json.ParseStream(json_stream);
+    if (json.HasParseError() || !json.IsObject() || !json.HasMember("entities") || !json["entities"].IsArray()) {
+        std::cerr << "ERROR: Could not parse scene file " << source << std::endl;
+        return false;
+    }
+
+    rapidjson::Value& json_entities = json["entities"];
+    std::vector<SceneEntity> scene;
+    for (rapidjson::SizeType i = 0; i < json_entities.Size(); i++) {
+        int index = readSceneEntity(json_entities[i], scene);
+        if (index == -1) {
+            std::cerr << "ERROR: Entity " << i << " of scene " << source << " is missing fields or has wrong types" << std::endl;
+            return false;
+        }
+        if (json_entities[i].HasMember("parent") && json_entities[i]["parent"].IsString())
+            scene[index].parent = json_entities[i]["parent"].GetString();
+    }
+    //like ECS.getEntity, a name refers to the first entity which has it
+    std::unordered_map<std::string, int> entity_names;
+    for (size_t i = 0; i < scene.size(); i++)
+        entity_names.insert({ scene[i].name, (int)i });
+
+    std::vector<TSceneEntity> entities;
+    std::vector<TSceneTransform> transforms;
+    std::vector<TSceneMesh> meshes;
+    std::vector<TSceneLight> lights;
+    std::vector<TSceneCollider> colliders;
+    std::vector<TSceneElevator> elevators;
+    std::vector<TScenePrefab> prefabs;
+    std::vector<char> strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+    std::unordered_set<std::string> prefab_paths;
+    for (uint32_t i = 0; i < (uint32_t)scene.size(); i++) {
+        const SceneEntity& entity = scene[i];
+        TSceneEntity record;
+        record.name = addSceneString(entity.name, strings, string_offsets);
+        record.parent = entity.prefab_parent;
+        if (record.parent == -1 && entity.parent != "") {
+            auto parent = entity_names.find(entity.parent);
+            if (parent == entity_names.end()) {
+                std::cerr << "ERROR: Parent " << entity.parent << " of " << entity.name << " is not in scene " << source << std::endl;
+                return false;
+            }
+            record.parent = parent->second;
+        }
+        entities.push_back(record);
+
+        TSceneTransform transform;
+        transform.entity = i;
+        memcpy(transform.matrix, entity.matrix.m, sizeof(transform.matrix));
+        transforms.push_back(transform);
+        if (entity.has_mesh) {
+            TSceneMesh mesh;
+            mesh.entity = i;
+            mesh.mesh = addSceneString(entity.mesh, strings, string_offsets);
+            mesh.material = addSceneString(entity.material, strings, string_offsets);
+            meshes.push_back(mesh);
+        }
+        if (entity.has_light) {
+            lights.push_back(entity.light);
+            lights.back().entity = i;
+        }
+        if (entity.has_collider) {
+            colliders.push_back(entity.collider);
+            colliders.back().entity = i;
+        }
+        if (entity.has_elevator) {
+            elevators.push_back(entity.elevator);
+            elevators.back().entity = i;
+        }
+        if (entity.prefab != "" && prefab_paths.insert(entity.prefab).second) {
+            TScenePrefab prefab;
+            prefab.path = addSceneString(entity.prefab, strings, string_offsets);
+            prefabs.push_back(prefab);
+        }
+    }
+    if (strings.empty()) strings.push_back('\0');
+
+    TSceneHeader header;
+    std::vector<unsigned char> data(sizeof(TSceneHeader));
+    addSceneTable(data, header.tables[SceneTableEntities], entities);
+    addSceneTable(data, header.tables[SceneTableTransforms], transforms);
+    addSceneTable(data, header.tables[SceneTableMeshes], meshes);
+    addSceneTable(data, header.tables[SceneTableLights], lights);
+    addSceneTable(data, header.tables[SceneTableColliders], colliders);
+    addSceneTable(data, header.tables[SceneTableElevators], elevators);
+    addSceneTable(data, header.tables[SceneTablePrefabs], prefabs);
+    addSceneTable(data, header.tables[SceneTableStrings], strings);
+    memcpy(data.data(), &header, sizeof(TSceneHeader));
+
+    std::ofstream file(destination, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+    if (!file.good()) {
+        std::cerr << "ERROR: Could not write scene file " << destination << std::endl;
+        return false;
+    }
+
+    std::cout << source << " -> " << destination << ": " << entities.size() << " entities, "
+              << meshes.size() << " meshes, " << lights.size() << " lights, " << colliders.size()
+              << " colliders, " << elevators.size() << " elevators, " << prefabs.size() << " prefabs" << std::endl;
+    return true;
+}
+
+//false if compiled scene destination, cooked at mtime, lists a prefab changed
+//since, or can't be read by this version of the engine
+static bool isCookedSceneCurrent(const std::string& destination, time_t mtime) {
+    MappedFile file;
+    TSceneHeader header;
+    if (!file.open(destination) || file.size() < sizeof(TSceneHeader)) return false;
+    memcpy(&header, file.data(), sizeof(TSceneHeader));
+    if (header.magic != magicScene || header.version != SCENE_VERSION) return false;
+
+    const TSceneTableInfo& prefabs = header.tables[SceneTablePrefabs];
+    const TSceneTableInfo& strings = header.tables[SceneTableStrings];
+    if (prefabs.record_bytes != sizeof(TScenePrefab) || prefabs.offset > file.size() ||
+        (size_t)prefabs.count * sizeof(TScenePrefab) > file.size() - prefabs.offset ||
+        strings.offset > file.size() || strings.count == 0 || strings.count > file.size() - strings.offset ||
+        file.data()[strings.offset + strings.count - 1] != '\0')
+        return false;
+    for (uint32_t i = 0; i < prefabs.count; i++) {
+        TScenePrefab prefab;
+        memcpy(&prefab, file.data() + prefabs.offset + i * sizeof(TScenePrefab), sizeof(prefab));
+        struct stat prefab_stat;
+        if (prefab.path < strings.count &&
+            stat((const char*)file.data() + strings.offset + prefab.path, &prefab_stat) == 0 &&
+            prefab_stat.st_mtime > mtime)
+            return false;
+    }
+    return true;
+}
+
+std::string Cooker::getDestination(const std::string& source) {
+    if (source.size() > 6 && source.compare(source.size() - 6, 6, ".scene") == 0)
+        return source.substr(0, source.size() - 6) + ".bscene";
+    if (source.size() < 4) return "";
+    std::string ext = source.substr(source.size() - 4, 4);
+    std::string base = source.substr(0, source.size() - 4);
+    if (ext == ".obj" || ext == ".OBJ") return base + ".mesh";
+    if (ext == ".tga" || ext == ".TGA") return base + ".tex";
+    return "";
+}
+
+bool Cooker::cookFile(const std::string& source, bool force) {
+    std::string destination = getDestination(source);
+    if (destination.empty()) return true;
+
+    struct stat source_stat, destination_stat;
+    if (stat(source.c_str(), &source_stat) != 0) {
+        std::cerr << "ERROR: Could not open " << source << std::endl;
+        return false;
+    }
+    std::string ext = destination.substr(destination.size() - 4, 4);
+    if (!force && stat(destination.c_str(), &destination_stat) == 0 &&
+        destination_stat.st_mtime >= source_stat.st_mtime &&
+        (ext != "cene" || isCookedSceneCurrent(destination, destination_stat.st_mtime)))
+        return true;
+
+    if (ext == "mesh") return cookMesh(source, destination);
+    if (ext == "cene") return cookScene(source, destination);
+    return cookTexture(source, destination);
+}
+
+bool Cooker::writeChunk_(std::ofstream& file, uint32_t magic_id, const void* data, size_t num_bytes) {
+    TChunk chunk;
+    chunk.magic_id = magic_id;
+    chunk.num_bytes = (uint32_t)num_bytes;
+    file.write((const char*)&chunk, sizeof(chunk));
+    if (num_bytes) file.write((const char*)data, num_bytes);
+    return file.good();
+}
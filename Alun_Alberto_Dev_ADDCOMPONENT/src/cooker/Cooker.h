@@ -0,0 +1,32 @@
+#pragma once
+#include "../render/VertexFormat.h"
+#include "MeshOptimizer.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Converts source assets into the runtime formats of AssetFormats.h, so the
+// engine only has to map them and copy them to the GPU:
+// - .obj -> .mesh: triangles optimised for vertex cache and overdraw, vertices
+//   packed in the engine's VertexFormat, 16 bit indices when possible, AABB
+// - .tga -> .tex: same pixels, with the full mip chain precomputed
+// - .scene -> .bscene: entities as flat tables, prefabs expanded. Paths in
+//   scenes are relative to the engine's working directory, so run from there
+class Cooker {
+public:
+    static bool cookMesh(const std::string& source, const std::string& destination,
+                         const VertexFormat& format = VertexFormat(),
+                         const MeshOptimizerSettings& settings = MeshOptimizerSettings());
+    static bool cookTexture(const std::string& source, const std::string& destination);
+    static bool cookScene(const std::string& source, const std::string& destination);
+
+    //name of cooked file for source (.mesh, .tex or .bscene next to it), or
+    //empty if source is not a type we cook
+    static std::string getDestination(const std::string& source);
+    //cooks source if destination is missing or older than it (or always, if
+    //force). Scenes are also recooked if a prefab they list is newer
+    static bool cookFile(const std::string& source, bool force);
+
+private:
+    static bool writeChunk_(std::ofstream& file, uint32_t magic_id, const void* data, size_t num_bytes);
+};
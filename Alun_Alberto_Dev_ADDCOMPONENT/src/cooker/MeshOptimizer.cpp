@@ -0,0 +1,222 @@
+#include "MeshOptimizer.h"
+#include "../linmath.h"
+#include <algorithm>
+
+void MeshOptimizer::optimizeTriangles(std::vector<unsigned int>& indices, const std::vector<float>& positions,
+                                      const MeshOptimizerSettings& settings) {
+    size_t num_vertices = positions.size() / 3;
+    size_t num_triangles = indices.size() / 3;
+    if (num_triangles == 0) return;
+
+    std::vector<unsigned int> triangles;
+    std::vector<bool> hard_boundaries;
+    tipsify_(indices, num_vertices, settings.cache_size, triangles, hard_boundaries);
+    std::vector<size_t> cluster_starts;
+    makeClusters_(indices, num_vertices, triangles, hard_boundaries, settings, cluster_starts);
+
+    //normal and centroid of each cluster, weighted by triangle area
+    struct Cluster {
+        size_t start, end;
+        float sort_key;
+    };
+    auto getPosition = [&](unsigned int vertex) {
+        return lm::vec3(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2]);
+    };
+    std::vector<Cluster> clusters(cluster_starts.size());
+    std::vector<lm::vec3> cluster_normals(clusters.size()), cluster_centroids(clusters.size());
+    lm::vec3 mesh_centroid;
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        clusters[c].start = cluster_starts[c];
+        clusters[c].end = c + 1 < clusters.size() ? cluster_starts[c + 1] : num_triangles;
+        lm::vec3 normal, centroid;
+        float area = 0.0f;
+        for (size_t i = clusters[c].start; i < clusters[c].end; i++) {
+            const unsigned int* triangle = &indices[triangles[i] * 3];
+            lm::vec3 p0 = getPosition(triangle[0]), p1 = getPosition(triangle[1]), p2 = getPosition(triangle[2]);
+            //length of cross product is twice the area
+            lm::vec3 cross = (p1 - p0).cross(p2 - p0);
+            float triangle_area = cross.length();
+            normal = normal + cross;
+            centroid = centroid + (p0 + p1 + p2) * (triangle_area / 3.0f);
+            area += triangle_area;
+        }
+        mesh_centroid = mesh_centroid + centroid;
+        mesh_area += area;
+        cluster_normals[c] = normal;
+        cluster_centroids[c] = area > 0.0f ? centroid * (1.0f / area) : getPosition(indices[triangles[clusters[c].start] * 3]);
+    }
+    if (mesh_area > 0.0f) mesh_centroid = mesh_centroid * (1.0f / mesh_area);
+
+    //clusters pointing away from centre are likely in front of the others
+    //seen from any direction, so draw them first
+    for (size_t c = 0; c < clusters.size(); c++) {
+        lm::vec3 normal = cluster_normals[c];
+        if (normal.length() > 0.0f) normal.normalize();
+        clusters[c].sort_key = (cluster_centroids[c] - mesh_centroid).dot(normal);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters) {
+        for (size_t i = cluster.start; i < cluster.end; i++) {
+            const unsigned int* triangle = &indices[triangles[i] * 3];
+            result.insert(result.end(), triangle, triangle + 3);
+        }
+    }
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertices(std::vector<unsigned int>& indices, std::vector<float>& positions,
+                                     std::vector<float>& uvs, std::vector<float>& normals) {
+    size_t num_vertices = positions.size() / 3;
+    const unsigned int unused = 0xFFFFFFFF;
+    std::vector<unsigned int> remap(num_vertices, unused);
+    unsigned int next = 0;
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) remap[index] = next++;
+        index = remap[index];
+    }
+
+    //vertices not used by any triangle are dropped
+    auto reorder = [&](std::vector<float>& attribute, size_t components) {
+        if (attribute.size() != num_vertices * components) return;
+        std::vector<float> result(next * components);
+        for (size_t i = 0; i < num_vertices; i++) {
+            if (remap[i] == unused) continue;
+            std::copy(&attribute[i * components], &attribute[i * components] + components,
+                      &result[remap[i] * components]);
+        }
+        attribute.swap(result);
+    };
+    reorder(positions, 3);
+    reorder(uvs, 2);
+    reorder(normals, 3);
+}
+
+float MeshOptimizer::computeACMR(const std::vector<unsigned int>& indices, size_t num_vertices, unsigned int cache_size) {
+    if (indices.size() < 3) return 0.0f;
+    //a vertex is in cache if fewer than cache_size misses happened since it was loaded
+    std::vector<size_t> cache_time(num_vertices, 0);
+    size_t timestamp = cache_size + 1;
+    size_t misses = 0;
+    for (unsigned int index : indices) {
+        if (timestamp - cache_time[index] > cache_size) {
+            cache_time[index] = timestamp++;
+            misses++;
+        }
+    }
+    return (float)misses / (indices.size() / 3);
+}
+
+//fans triangles around a vertex at a time, choosing next one among vertices
+//of the fan so it is still in cache once its own fan is emitted
+void MeshOptimizer::tipsify_(const std::vector<unsigned int>& indices, size_t num_vertices, unsigned int cache_size,
+                             std::vector<unsigned int>& triangles, std::vector<bool>& hard_boundaries) {
+    size_t num_triangles = indices.size() / 3;
+
+    //triangles using each vertex
+    std::vector<unsigned int> adjacency_offsets(num_vertices + 1, 0);
+    for (unsigned int index : indices) adjacency_offsets[index + 1]++;
+    for (size_t i = 0; i < num_vertices; i++) adjacency_offsets[i + 1] += adjacency_offsets[i];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    //triangles not yet emitted using each vertex
+    std::vector<unsigned int> live(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++) live[i] = adjacency_offsets[i + 1] - adjacency_offsets[i];
+
+    std::vector<size_t> cache_time(num_vertices, 0);
+    std::vector<bool> emitted(num_triangles, false);
+    std::vector<unsigned int> dead_end_stack;
+    std::vector<unsigned int> candidates;
+    size_t timestamp = cache_size + 1;
+    size_t cursor = 0;
+
+    triangles.clear();
+    triangles.reserve(num_triangles);
+    hard_boundaries.assign(num_triangles, false);
+
+    int fan_vertex = 0;
+    while (fan_vertex >= 0) {
+        candidates.clear();
+        for (unsigned int a = adjacency_offsets[fan_vertex]; a < adjacency_offsets[fan_vertex + 1]; a++) {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+            for (int k = 0; k < 3; k++) {
+                unsigned int vertex = indices[triangle * 3 + k];
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if (timestamp - cache_time[vertex] > cache_size)
+                    cache_time[vertex] = timestamp++;
+            }
+            emitted[triangle] = true;
+            triangles.push_back(triangle);
+        }
+
+        //candidate which will still be in cache after emitting its fan, the oldest
+        //one first. Priority 0 if it would be evicted meanwhile
+        int next = -1;
+        int best_priority = -1;
+        for (unsigned int vertex : candidates) {
+            if (live[vertex] == 0) continue;
+            int priority = 0;
+            size_t age = timestamp - cache_time[vertex];
+            if (age + 2 * live[vertex] <= cache_size) priority = (int)age;
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = (int)vertex;
+            }
+        }
+
+        if (next < 0) {
+            //dead end: most recent vertex with triangles left, else the next one in input order
+            while (!dead_end_stack.empty() && next < 0) {
+                unsigned int vertex = dead_end_stack.back();
+                dead_end_stack.pop_back();
+                if (live[vertex] > 0) next = (int)vertex;
+            }
+            while (next < 0 && cursor < num_vertices) {
+                if (live[cursor] > 0) next = (int)cursor;
+                cursor++;
+            }
+            if (triangles.size() < num_triangles) hard_boundaries[triangles.size()] = true;
+        }
+        fan_vertex = next;
+    }
+}
+
+//simulates cache along ordered triangles, ending a cluster at a dead end, or
+//as soon as it reuses cache well enough that flushing it on a jump costs little
+void MeshOptimizer::makeClusters_(const std::vector<unsigned int>& indices, size_t num_vertices,
+                                  const std::vector<unsigned int>& triangles, const std::vector<bool>& hard_boundaries,
+                                  const MeshOptimizerSettings& settings, std::vector<size_t>& cluster_starts) {
+    std::vector<size_t> cache_time(num_vertices, 0);
+    size_t timestamp = settings.cache_size + 1;
+    size_t cluster_start = 0;
+    size_t misses = 0;
+
+    cluster_starts.clear();
+    cluster_starts.push_back(0);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (i > cluster_start && (hard_boundaries[i] ||
+            (float)misses / (i - cluster_start) < settings.cluster_acmr)) {
+            cluster_starts.push_back(i);
+            cluster_start = i;
+            misses = 0;
+            //clusters may end up anywhere, so each starts with a cold cache
+            timestamp += settings.cache_size + 1;
+        }
+        for (int k = 0; k < 3; k++) {
+            unsigned int vertex = indices[triangles[i] * 3 + k];
+            if (timestamp - cache_time[vertex] > settings.cache_size) {
+                cache_time[vertex] = timestamp++;
+                misses++;
+            }
+        }
+    }
+}
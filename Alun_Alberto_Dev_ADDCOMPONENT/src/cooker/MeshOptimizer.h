@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Offline reordering of indexed triangle lists, after Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+// Triangles are ordered with Tipsify for a FIFO post transform cache, cut into
+// clusters, and clusters sorted so those facing out of the mesh are drawn first
+
+struct MeshOptimizerSettings {
+    unsigned int cache_size = 16; //entries of post transform cache
+    //a cluster may end once its ACMR is below this, or where Tipsify hit a
+    //dead end. Lower gives longer clusters: better cache use, worse overdraw
+    float cluster_acmr = 0.75f;
+};
+
+class MeshOptimizer {
+public:
+    //reorders triangles of indices. positions are 3 floats per vertex
+    static void optimizeTriangles(std::vector<unsigned int>& indices, const std::vector<float>& positions,
+                                  const MeshOptimizerSettings& settings = MeshOptimizerSettings());
+
+    //reorders vertices in order of first use by indices, remapping indices.
+    //uvs and normals may be empty
+    static void optimizeVertices(std::vector<unsigned int>& indices, std::vector<float>& positions,
+                                 std::vector<float>& uvs, std::vector<float>& normals);
+
+    //average vertex transforms per triangle with a FIFO cache of cache_size
+    static float computeACMR(const std::vector<unsigned int>& indices, size_t num_vertices, unsigned int cache_size);
+
+private:
+    //Tipsify order of triangles, and index of first triangle after each dead end
+    static void tipsify_(const std::vector<unsigned int>& indices, size_t num_vertices, unsigned int cache_size,
+                         std::vector<unsigned int>& triangles, std::vector<bool>& hard_boundaries);
+    //splits ordered triangles into clusters, as start triangle of each
+    static void makeClusters_(const std::vector<unsigned int>& indices, size_t num_vertices,
+                              const std::vector<unsigned int>& triangles, const std::vector<bool>& hard_boundaries,
+                              const MeshOptimizerSettings& settings, std::vector<size_t>& cluster_starts);
+};
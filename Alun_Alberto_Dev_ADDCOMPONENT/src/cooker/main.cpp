@@ -0,0 +1,59 @@
+// Offline asset cooker. Converts .obj, .tga and .scene files into the .mesh,
+// .tex and .bscene files the engine prefers, writing each next to its source. Directories are
+// searched recursively. Files already cooked after their source last changed
+// are skipped unless --force is given
+//
+// usage: Cooker [--force] <file or directory>...
+
+#include "Cooker.h"
+#include "../JobSystem.h"
+#ifdef _WIN32
+#include "../tools/dirent.h"
+#else
+#include <dirent.h>
+#endif
+#include <iostream>
+#include <string>
+#include <vector>
+
+//adds files under path to files, or path itself if it is not a directory
+static void collectFiles(const std::string& path, std::vector<std::string>& files) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) {
+        files.push_back(path);
+        return;
+    }
+    struct dirent* entity;
+    while ((entity = readdir(dir)) != NULL) {
+        std::string name = entity->d_name;
+        if (name == "." || name == "..") continue;
+        collectFiles(path + "/" + name, files);
+    }
+    closedir(dir);
+}
+
+int main(int argc, char** argv) {
+    bool force = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--force") force = true;
+        else collectFiles(arg, files);
+    }
+    if (files.empty()) {
+        std::cerr << "usage: Cooker [--force] <file or directory>..." << std::endl;
+        return 1;
+    }
+
+    //parser splits big OBJ files across workers
+    JobSystem::get().init();
+
+    int failed = 0;
+    for (const std::string& file : files) {
+        if (!Cooker::cookFile(file, force)) failed++;
+    }
+
+    JobSystem::get().shutdown();
+    if (failed) std::cerr << failed << " files failed to cook" << std::endl;
+    return failed ? 1 : 0;
+}
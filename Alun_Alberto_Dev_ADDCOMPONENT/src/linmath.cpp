@@ -8,8 +8,53 @@
 #include <math.h> //atan2
 #include <utility> //for std::swap
 
+//SIMD kernels are chosen at compile time: SSE on any x86 target which has it,
+//AVX as well when compiling for it (/arch:AVX, -mavx). Define LM_NO_SIMD to
+//use the scalar code everywhere. Matrices need not be aligned
+#if !defined(LM_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define LM_SSE
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#define LM_AVX
+#include <immintrin.h>
+#endif
+#endif
+
 namespace lm {
 
+#ifdef LM_SSE
+	//**************************************
+	// SSE helpers
+	//**************************************
+	#define LM_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+	#define LM_SWIZZLE(a, x, y, z, w) LM_SHUFFLE(a, a, x, y, z, w)
+
+	//sum of columns of m, weighted by x, y, z, w
+	static inline __m128 combineColumns(const float* m, __m128 x, __m128 y, __m128 z, __m128 w) {
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(m), x);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), y));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), z));
+		return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+	}
+
+	//a, b, c, d are 2x2 blocks stored (m00, m01, m10, m11)
+	//a * b
+	static inline __m128 mat2Mul(__m128 a, __m128 b) {
+		return _mm_add_ps(_mm_mul_ps(a, LM_SWIZZLE(b, 0, 3, 0, 3)),
+		                  _mm_mul_ps(LM_SWIZZLE(a, 1, 0, 3, 2), LM_SWIZZLE(b, 2, 1, 2, 1)));
+	}
+	//adjugate(a) * b
+	static inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(LM_SWIZZLE(a, 3, 3, 0, 0), b),
+		                  _mm_mul_ps(LM_SWIZZLE(a, 1, 1, 2, 2), LM_SWIZZLE(b, 2, 3, 0, 1)));
+	}
+	//a * adjugate(b)
+	static inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(a, LM_SWIZZLE(b, 3, 0, 3, 0)),
+		                  _mm_mul_ps(LM_SWIZZLE(a, 1, 0, 3, 2), LM_SWIZZLE(b, 2, 1, 2, 1)));
+	}
+#endif
+
 	//**************************************
 	// vec2
 	//**************************************
@@ -158,11 +203,74 @@ namespace lm {
 
 	mat4& mat4::transpose()
 	{
+#ifdef LM_SSE
+		__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(m, c0); _mm_storeu_ps(m + 4, c1); _mm_storeu_ps(m + 8, c2); _mm_storeu_ps(m + 12, c3);
+#else
 		std::swap(m[1], m[4]); std::swap(m[2], m[8]); std::swap(m[3], m[12]);
 		std::swap(m[6], m[9]); std::swap(m[7], m[13]); std::swap(m[11], m[14]);
+#endif
 		return *this;
 	}
 
+#ifdef LM_SSE
+	// inverse by 2x2 blocks: for M = |A B|, with |M| its determinant and # the
+	//                                |C D|
+	// adjugate, inverse(M) = 1/|M| * |  |D|A - B(D#C)     |C|B - A(D#C)#  |#
+	//                                |  |B|C - D(A#B)#    |A|D - C(A#B)   |
+	// Same for rows or columns, as inverse(transpose(M)) = transpose(inverse(M))
+	// see https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+	bool mat4::inverse()
+	{
+		__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+
+		__m128 A = _mm_movelh_ps(c0, c1);
+		__m128 B = _mm_movehl_ps(c1, c0);
+		__m128 C = _mm_movelh_ps(c2, c3);
+		__m128 D = _mm_movehl_ps(c3, c2);
+
+		//(|A|, |B|, |C|, |D|)
+		__m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(LM_SHUFFLE(c0, c2, 0, 2, 0, 2), LM_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+			_mm_mul_ps(LM_SHUFFLE(c0, c2, 1, 3, 1, 3), LM_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+		__m128 det_a = LM_SWIZZLE(det_sub, 0, 0, 0, 0);
+		__m128 det_b = LM_SWIZZLE(det_sub, 1, 1, 1, 1);
+		__m128 det_c = LM_SWIZZLE(det_sub, 2, 2, 2, 2);
+		__m128 det_d = LM_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+		__m128 d_c = mat2AdjMul(D, C);
+		__m128 a_b = mat2AdjMul(A, B);
+		__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, A), mat2Mul(B, d_c));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, D), mat2Mul(C, a_b));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, C), mat2MulAdj(D, a_b));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, B), mat2MulAdj(A, d_c));
+
+		//|M| = |A||D| + |B||C| - trace((A#B)(D#C))
+		__m128 trace = _mm_mul_ps(a_b, LM_SWIZZLE(d_c, 0, 2, 1, 3));
+		trace = _mm_add_ps(trace, LM_SWIZZLE(trace, 2, 3, 0, 1));
+		trace = _mm_add_ps(trace, LM_SWIZZLE(trace, 1, 0, 3, 2));
+		__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), trace);
+
+		//singular: leave matrix as it is
+		float det_value = _mm_cvtss_f32(det);
+		if (fabsf(det_value) <= 1e-20f || det_value != det_value) return false;
+
+		//signs of adjugate, and 1 / |M|
+		__m128 r_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+		x = _mm_mul_ps(x, r_det);
+		y = _mm_mul_ps(y, r_det);
+		z = _mm_mul_ps(z, r_det);
+		w = _mm_mul_ps(w, r_det);
+
+		//adjugate of each block, and back to columns
+		_mm_storeu_ps(m, LM_SHUFFLE(x, y, 3, 1, 3, 1));
+		_mm_storeu_ps(m + 4, LM_SHUFFLE(x, y, 2, 0, 2, 0));
+		_mm_storeu_ps(m + 8, LM_SHUFFLE(z, w, 3, 1, 3, 1));
+		_mm_storeu_ps(m + 12, LM_SHUFFLE(z, w, 2, 0, 2, 0));
+		return true;
+	}
+#else
 	bool mat4::inverse()
 	{
 		unsigned int i, j, k, swap;
@@ -226,6 +334,27 @@ namespace lm {
 
 		return true;
 	}
+#endif
+
+	// inverse of the 3x3 part is its adjugate over its determinant, whose rows
+	// are cross products of the columns. Then translation is -inverse * t
+	bool mat4::inverseAffine()
+	{
+		vec3 c0(m[0], m[1], m[2]), c1(m[4], m[5], m[6]), c2(m[8], m[9], m[10]);
+		vec3 r0 = c1.cross(c2), r1 = c2.cross(c0), r2 = c0.cross(c1);
+		float det = c0.dot(r0);
+		if (fabsf(det) <= 1e-20f) return false;
+
+		float inv_det = 1.0f / det;
+		r0 = r0 * inv_det; r1 = r1 * inv_det; r2 = r2 * inv_det;
+		vec3 t(m[12], m[13], m[14]);
+
+		m[0] = r0.x; m[4] = r0.y; m[8] = r0.z; m[12] = -r0.dot(t);
+		m[1] = r1.x; m[5] = r1.y; m[9] = r1.z; m[13] = -r1.dot(t);
+		m[2] = r2.x; m[6] = r2.y; m[10] = r2.z; m[14] = -r2.dot(t);
+		m[3] = 0; m[7] = 0; m[11] = 0; m[15] = 1;
+		return true;
+	}
 
 	// orthogonalizes right and top vector from the front vector
 	// assumes new, normalized front vector has just been set
@@ -451,21 +580,23 @@ namespace lm {
 	// 3 component vector of the result
 	vec3 mat4::operator*(const vec3& vec) const
 	{
-		vec4 v4(vec.x, vec.y, vec.z, 1.0);
-		vec4 v4m = *this * v4;
-		return vec3(v4m.x, v4m.y, v4m.z);
+		vec3 ret;
+		transformPoints(*this, &vec, &ret, 1);
+		return ret;
 	}
 
 	// multiplies a vec4 with a mat4
 	vec4 mat4::operator*(const vec4& v) const
 	{
 		vec4 ret;
-
+#ifdef LM_SSE
+		_mm_storeu_ps(&ret.x, combineColumns(m, _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z), _mm_set1_ps(v.w)));
+#else
 		ret.x = v.x*m[0] + v.y*m[4] + v.z*m[8] + v.w*m[12];
 		ret.y = v.x*m[1] + v.y*m[5] + v.z*m[9] + v.w*m[13];
 		ret.z = v.x*m[2] + v.y*m[6] + v.z*m[10] + v.w*m[14];
 		ret.w = v.x*m[3] + v.y*m[7] + v.z*m[11] + v.w*m[15];
-
+#endif
 		return ret;
 	}
 
@@ -473,23 +604,97 @@ namespace lm {
 	mat4 mat4::operator*(const mat4& N) const
 	{
 		mat4 result;
+		multiplyMatrices(*this, &N, &result, 1);
+		return result;
+	}
 
-		unsigned int i, j, k;
-		for (i = 0; i < 4; i++) //column
-		{
-			for (j = 0; j < 4; j++) //row
+	//**************************************
+	// batch transforms
+	//**************************************
+	void transformPoints(const mat4& matrix, const vec3* points, vec3* result, size_t count)
+	{
+		const float* m = matrix.m;
+		for (size_t p = 0; p < count; p++) {
+			vec3 v = points[p];
+#ifdef LM_SSE
+			//translation column is the w = 1 term
+			__m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v.x)), _mm_loadu_ps(m + 12));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v.y)));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v.z)));
+			float out[4];
+			_mm_storeu_ps(out, r);
+			result[p] = vec3(out[0], out[1], out[2]);
+#else
+			result[p] = vec3(v.x*m[0] + v.y*m[4] + v.z*m[8] + m[12],
+			                 v.x*m[1] + v.y*m[5] + v.z*m[9] + m[13],
+			                 v.x*m[2] + v.y*m[6] + v.z*m[10] + m[14]);
+#endif
+		}
+	}
+
+	void multiplyMatrices(const mat4& matrix, const mat4* matrices, mat4* result, size_t count)
+	{
+#ifdef LM_AVX
+		const float* a = matrix.m;
+		//columns of matrix, repeated in both halves
+		__m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+		__m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+		__m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+		__m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+		for (size_t p = 0; p < count; p++) {
+			//two columns of result at once: each half is a * (column of n)
+			const float* n = matrices[p].m;
+			__m256 n01 = _mm256_loadu_ps(n), n23 = _mm256_loadu_ps(n + 8);
+			__m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(n01, n01, _MM_SHUFFLE(0, 0, 0, 0)));
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_shuffle_ps(n01, n01, _MM_SHUFFLE(1, 1, 1, 1))));
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_shuffle_ps(n01, n01, _MM_SHUFFLE(2, 2, 2, 2))));
+			r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_shuffle_ps(n01, n01, _MM_SHUFFLE(3, 3, 3, 3))));
+			__m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(n23, n23, _MM_SHUFFLE(0, 0, 0, 0)));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_shuffle_ps(n23, n23, _MM_SHUFFLE(1, 1, 1, 1))));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_shuffle_ps(n23, n23, _MM_SHUFFLE(2, 2, 2, 2))));
+			r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_shuffle_ps(n23, n23, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm256_storeu_ps(result[p].m, r01);
+			_mm256_storeu_ps(result[p].m + 8, r23);
+		}
+#elif defined(LM_SSE)
+		const float* a = matrix.m;
+		__m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+		for (size_t p = 0; p < count; p++) {
+			//column i of result is a * (column i of n). All of n is read
+			//before writing, so result may be the same matrix
+			const float* n = matrices[p].m;
+			__m128 r[4];
+			for (int i = 0; i < 4; i++) {
+				const float* c = n + i * 4;
+				r[i] = _mm_mul_ps(a0, _mm_set1_ps(c[0]));
+				r[i] = _mm_add_ps(r[i], _mm_mul_ps(a1, _mm_set1_ps(c[1])));
+				r[i] = _mm_add_ps(r[i], _mm_mul_ps(a2, _mm_set1_ps(c[2])));
+				r[i] = _mm_add_ps(r[i], _mm_mul_ps(a3, _mm_set1_ps(c[3])));
+			}
+			for (int i = 0; i < 4; i++) _mm_storeu_ps(result[p].m + i * 4, r[i]);
+		}
+#else
+		//copies, so result may be the same matrix as either input
+		mat4 A = matrix;
+		for (size_t p = 0; p < count; p++) {
+			mat4 N = matrices[p];
+			mat4& R = result[p];
+			unsigned int i, j, k;
+			for (i = 0; i < 4; i++) //column
 			{
-				result.M[i][j] = 0.0; //reset
-				for (k = 0; k < 4; k++) {
-					//k-j iterates row
-					//i-k iterates column
-					//this.row * N.column
-					result.M[i][j] += N.M[i][k] * M[k][j];
+				for (j = 0; j < 4; j++) //row
+				{
+					R.M[i][j] = 0.0; //reset
+					for (k = 0; k < 4; k++) {
+						//k-j iterates row
+						//i-k iterates column
+						//this.row * N.column
+						R.M[i][j] += N.M[i][k] * A.M[k][j];
+					}
 				}
 			}
 		}
-
-		return result;
+#endif
 	}
 
 	// turns this matrix into a view matrix
@@ -5,6 +5,7 @@
 //
 #pragma once
 #include <cmath> //for sqrt (square root) function
+#include <cstddef> //size_t
 #define DEG2RAD 0.0174532925f
 
 namespace lm {
@@ -125,6 +126,9 @@ namespace lm {
 		mat4& setIdentity();
 		mat4& transpose();
 		bool inverse();
+		//inverse of a matrix whose last row is (0, 0, 0, 1), i.e. any mix of
+		//translation, rotation and scale. Much cheaper than inverse()
+		bool inverseAffine();
 
 		//get base vectors
 		vec3 right() const { return vec3(m[0], m[1], m[2]); }
@@ -189,4 +193,10 @@ namespace lm {
 	quat operator * (const quat& a, float v);
 	quat operator * (const quat& a, const quat& b);
 
+	//batch transforms. result may be the same array as the input
+	//result[i] = matrix * points[i], as points (w = 1)
+	void transformPoints(const mat4& matrix, const vec3* points, vec3* result, size_t count);
+	//result[i] = matrix * matrices[i]
+	void multiplyMatrices(const mat4& matrix, const mat4* matrices, mat4* result, size_t count);
+
 }
\ No newline at end of file
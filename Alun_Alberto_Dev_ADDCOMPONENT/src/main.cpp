@@ -6,6 +6,10 @@
 #include "includes.h"
 #include "extern.h"
 #include "Game.h"
+#include "render/RenderDevice.h"
+#include "Profiler.h"
+#include <chrono>
+#include <cstring>
 
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 768
@@ -47,8 +51,70 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 	GAME->mouse_button_callback(button, action, mods);
 }
 
-int main(void)
+//runs game for a number of frames without a window or GL context, on the
+//null render device, and prints timings and what would have been rendered.
+//Started with: --headless [frames] [chrome trace file]
+int runHeadless(int num_frames, const char* trace_filename)
 {
+    Profiler::get().setThreadName("Main");
+
+    static NullRenderDevice null_device;
+    GPU = &null_device;
+
+    //editor is disabled, but it still sets up its styles on init
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+
+    auto load_start = std::chrono::high_resolution_clock::now();
+    GAME = new Game();
+    GAME->setHeadless(true);
+    GAME->init(WINDOW_WIDTH, WINDOW_HEIGHT);
+    GAME->update_viewports(WINDOW_WIDTH, WINDOW_HEIGHT);
+    auto load_end = std::chrono::high_resolution_clock::now();
+
+    //keep loading out of per frame stats
+    RenderDeviceStats load_stats = GPU->frame_stats;
+    GPU->frame_stats = RenderDeviceStats();
+
+    //fixed time step, so runs are comparable
+    const float dt = 1.0f / 60.0f;
+    for (int i = 0; i < num_frames; i++) {
+        Profiler::get().beginFrame();
+        GAME->update(dt);
+        GPU->endFrame();
+    }
+    auto frames_end = std::chrono::high_resolution_clock::now();
+
+    double load_ms = std::chrono::duration<double, std::milli>(load_end - load_start).count();
+    double frames_ms = std::chrono::duration<double, std::milli>(frames_end - load_end).count();
+    unsigned int frames = GPU->frames > 0 ? GPU->frames : 1;
+    const RenderDeviceStats& total = GPU->total_stats;
+    std::cout << "Headless: loaded in " << load_ms << " ms (" << load_stats.bytes_uploaded << " bytes uploaded)" << std::endl;
+    std::cout << "Headless: " << num_frames << " frames in " << frames_ms << " ms, " << frames_ms / frames << " ms/frame" << std::endl;
+    std::cout << "Headless: per frame " << total.draw_calls / frames << " draw calls, "
+              << total.instances / frames << " instances, "
+              << total.state_changes / frames << " state changes, "
+              << total.uniform_updates / frames << " uniform updates, "
+              << total.buffer_uploads / frames << " buffer uploads ("
+              << total.bytes_uploaded / frames << " bytes)" << std::endl;
+    std::cout << "Headless: last frame state cache " << GPU->state.last_frame_stats.issued << " issued, "
+              << GPU->state.last_frame_stats.skipped << " skipped" << std::endl;
+
+    //profile of whole run, including loading
+    if (trace_filename)
+        Profiler::get().exportChromeTrace(trace_filename);
+
+    JobSystem::get().shutdown();
+    delete GAME;
+    ImGui::DestroyContext();
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+        return runHeadless(argc > 2 ? atoi(argv[2]) : 600, argc > 3 ? argv[3] : nullptr);
+
     // register the error call-back function before doing anything else
     glfwSetErrorCallback(glfw_error_callback);
     
@@ -112,6 +178,8 @@ int main(void)
 	//set initial position before loop
 	glfwGetCursorPos(window, &mouse_x, &mouse_y);
 
+	Profiler::get().setThreadName("Main");
+
 	//create game singleton and initialise it
 	GAME = new Game();
 	GAME->init(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -130,11 +198,14 @@ int main(void)
 		dt = (float)(curr_time - prev_time);
 		prev_time = curr_time;
         
+		Profiler::get().beginFrame();
+
 		frame_counter_frames++;
 		frame_counter_time += dt;
 		if (frame_counter_time >= 1.0) { // If last prinf() was more than 1 sec ago
 			// printf and reset timer
 			//printf("%f ms/frame\n", 1000.0 / float(frame_counter_frames));
+			GAME->fps = frame_counter_frames;
 			frame_counter_frames = 0;
 			frame_counter_time = 0.0;
 		}
@@ -147,9 +218,13 @@ int main(void)
 		//update game
 		GAME->update(dt);
 		glfwSwapBuffers(window);
+		GPU->endFrame();
 
     }
 
+	//stop worker threads before freeing the systems they may be using
+	JobSystem::get().shutdown();
+
 	//free game memory - not necessary but good practice!
 	delete GAME;
 
@@ -0,0 +1,56 @@
+#include "FramePipeline.h"
+#include "RenderToTexture.h"
+#include "RenderDevice.h"
+#include "../Profiler.h"
+
+void FramePipeline::addPass(const std::string& name, FrameTarget target, unsigned int read_mask,
+                            PassFunc func, EnabledFunc enabled) {
+    Pass pass = { name, target, read_mask, func, enabled };
+    passes_.push_back(pass);
+}
+
+//binds an offscreen framebuffer, or the screen if null
+void FramePipeline::bind_(RenderToTexture* framebuffer) {
+    GPU->bindFramebuffer(GL_FRAMEBUFFER, framebuffer ? framebuffer->GetFrameBufferName() : 0);
+}
+
+void FramePipeline::execute(float dt) {
+    PROFILE_SCOPE("FramePipeline::execute");
+
+    //find enabled passes, and which targets they read
+    unsigned int read_mask = 0;
+    pass_enabled_.resize(passes_.size());
+    for (size_t i = 0; i < passes_.size(); i++) {
+        pass_enabled_[i] = !passes_[i].enabled || passes_[i].enabled();
+        if (pass_enabled_[i]) read_mask |= passes_[i].read_mask;
+    }
+    //screen is always shown, an offscreen scene only if something reads it
+    bool scene_used = !scene_target_ || (read_mask & frameTargetMask(FRAME_TARGET_SCENE));
+
+    //previous frame always ends with the screen bound
+    RenderToTexture* bound = nullptr;
+    bool screen_cleared = false;
+    bool scene_cleared = false;
+    passes_executed_ = 0;
+    for (size_t i = 0; i < passes_.size(); i++) {
+        Pass& pass = passes_[i];
+        if (!pass_enabled_[i]) continue;
+        if (pass.target == FRAME_TARGET_SCENE && !scene_used) continue;
+
+        RenderToTexture* framebuffer = pass.target == FRAME_TARGET_SCENE ? scene_target_ : nullptr;
+        if (framebuffer != bound) {
+            bind_(framebuffer);
+            bound = framebuffer;
+        }
+        bool& cleared = framebuffer ? scene_cleared : screen_cleared;
+        if (!cleared) {
+            GPU->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cleared = true;
+        }
+
+        PROFILE_SCOPE(pass.name.c_str());
+        pass.func(dt);
+        passes_executed_++;
+    }
+    if (bound) bind_(nullptr);
+}
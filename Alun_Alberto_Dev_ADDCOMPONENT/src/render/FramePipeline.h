@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+class RenderToTexture;
+
+//what a pass draws into, or reads from
+enum FrameTarget {
+    FRAME_TARGET_SCENE, //scene view: offscreen texture if one is set, otherwise the screen
+    FRAME_TARGET_SCREEN, //default framebuffer
+};
+
+//bit for target in a pass read mask
+inline unsigned int frameTargetMask(FrameTarget target) { return 1u << target; }
+
+// Draws the passes of a frame, each exactly once, in the order they were added
+// - each pass declares the target it draws into and the targets it reads
+// - a framebuffer is bound only when the target changes, and cleared before
+//   the first pass which draws into it each frame
+// - setSceneTarget routes the scene target to a texture (e.g. the editor
+//   viewport). With none set, the scene goes straight to the screen
+// - passes drawing into a texture which no enabled pass reads are skipped
+class FramePipeline {
+public:
+    typedef std::function<void(float)> PassFunc;
+    typedef std::function<bool()> EnabledFunc;
+
+    //enabled is checked every frame, leave empty for passes which always run.
+    //Passes must all be added before first execute, as profile zones keep
+    //pointers to their names
+    void addPass(const std::string& name, FrameTarget target, unsigned int read_mask,
+                 PassFunc func, EnabledFunc enabled = EnabledFunc());
+    void setSceneTarget(RenderToTexture* target) { scene_target_ = target; }
+    void execute(float dt);
+
+    //number of passes drawn in last execute
+    int getPassesExecuted() { return passes_executed_; }
+
+private:
+    struct Pass {
+        std::string name;
+        FrameTarget target;
+        unsigned int read_mask;
+        PassFunc func;
+        EnabledFunc enabled;
+    };
+    std::vector<Pass> passes_;
+    std::vector<bool> pass_enabled_;
+    RenderToTexture* scene_target_ = nullptr;
+    int passes_executed_ = 0;
+
+    void bind_(RenderToTexture* framebuffer);
+};
@@ -0,0 +1,127 @@
+#include "RenderDevice.h"
+
+//NullRenderDevice: no GL calls. Objects are just names from a counter, and
+//every call is counted in frame_stats
+
+//bytes per pixel of texture data, for upload stats
+static size_t bytesPerPixel(GLenum format) {
+    switch (format) {
+    case GL_RED: return 1;
+    case GL_RG: return 2;
+    case GL_RGB:
+    case GL_BGR: return 3;
+    default: return 4;
+    }
+}
+
+//state
+void NullRenderDevice::viewport(GLint x, GLint y, GLsizei width, GLsizei height) { frame_stats.state_changes++; }
+void NullRenderDevice::clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { frame_stats.state_changes++; }
+void NullRenderDevice::clear(GLbitfield mask) {}
+void NullRenderDevice::enable(GLenum cap) { frame_stats.state_changes++; }
+void NullRenderDevice::cullFace(GLenum mode) { frame_stats.state_changes++; }
+void NullRenderDevice::getIntegerv(GLenum pname, GLint* data) {
+    //smallest alignment allowed for uniform buffers is implementation defined, 256 is common
+    *data = pname == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT ? 256 : 0;
+}
+
+//buffers and vertex arrays
+void NullRenderDevice::genBuffers(GLsizei n, GLuint* buffers) { for (GLsizei i = 0; i < n; i++) buffers[i] = next_name_++; }
+void NullRenderDevice::deleteBuffers(GLsizei n, const GLuint* buffers) {}
+void NullRenderDevice::bindBuffer(GLenum target, GLuint buffer) {
+    frame_stats.state_changes++;
+    if (target == GL_PIXEL_UNPACK_BUFFER) unpack_buffer_bound_ = buffer != 0;
+}
+void NullRenderDevice::bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    frame_stats.buffer_uploads++;
+    if (data) frame_stats.bytes_uploaded += (size_t)size;
+}
+void NullRenderDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    frame_stats.buffer_uploads++;
+    frame_stats.bytes_uploaded += (size_t)size;
+}
+void* NullRenderDevice::mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    if (mapped_.size() < (size_t)length) mapped_.resize((size_t)length);
+    return mapped_.data();
+}
+GLboolean NullRenderDevice::unmapBuffer(GLenum target) { return GL_TRUE; }
+void NullRenderDevice::bindBufferBase(GLenum target, GLuint index, GLuint buffer) { frame_stats.state_changes++; }
+void NullRenderDevice::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) { frame_stats.state_changes++; }
+void NullRenderDevice::genVertexArrays(GLsizei n, GLuint* arrays) { for (GLsizei i = 0; i < n; i++) arrays[i] = next_name_++; }
+void NullRenderDevice::bindVertexArray(GLuint array) { frame_stats.state_changes++; }
+void NullRenderDevice::enableVertexAttribArray(GLuint index) { frame_stats.state_changes++; }
+void NullRenderDevice::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) { frame_stats.state_changes++; }
+void NullRenderDevice::vertexAttribDivisor(GLuint index, GLuint divisor) { frame_stats.state_changes++; }
+
+//drawing
+void NullRenderDevice::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    frame_stats.draw_calls++;
+    frame_stats.instances++;
+    frame_stats.indices += count;
+}
+void NullRenderDevice::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) {
+    frame_stats.draw_calls++;
+    frame_stats.instances += instancecount;
+    frame_stats.indices += count * instancecount;
+}
+
+//textures
+void NullRenderDevice::genTextures(GLsizei n, GLuint* textures) { for (GLsizei i = 0; i < n; i++) textures[i] = next_name_++; }
+void NullRenderDevice::activeTexture(GLenum texture) { frame_stats.state_changes++; }
+void NullRenderDevice::bindTexture(GLenum target, GLuint texture) { frame_stats.state_changes++; }
+void NullRenderDevice::texParameteri(GLenum target, GLenum pname, GLint param) { frame_stats.state_changes++; }
+void NullRenderDevice::texParameterf(GLenum target, GLenum pname, GLfloat param) { frame_stats.state_changes++; }
+void NullRenderDevice::texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+    frame_stats.texture_uploads++;
+    if (pixels || unpack_buffer_bound_) frame_stats.bytes_uploaded += (size_t)width * height * bytesPerPixel(format);
+}
+void NullRenderDevice::generateMipmap(GLenum target) {}
+void NullRenderDevice::pixelStorei(GLenum pname, GLint param) { frame_stats.state_changes++; }
+
+//framebuffers
+void NullRenderDevice::genFramebuffers(GLsizei n, GLuint* framebuffers) { for (GLsizei i = 0; i < n; i++) framebuffers[i] = next_name_++; }
+void NullRenderDevice::bindFramebuffer(GLenum target, GLuint framebuffer) { frame_stats.state_changes++; }
+void NullRenderDevice::framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) {}
+void NullRenderDevice::genRenderbuffers(GLsizei n, GLuint* renderbuffers) { for (GLsizei i = 0; i < n; i++) renderbuffers[i] = next_name_++; }
+void NullRenderDevice::bindRenderbuffer(GLenum target, GLuint renderbuffer) { frame_stats.state_changes++; }
+void NullRenderDevice::renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) {}
+void NullRenderDevice::framebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {}
+void NullRenderDevice::drawBuffers(GLsizei n, const GLenum* bufs) { frame_stats.state_changes++; }
+GLenum NullRenderDevice::checkFramebufferStatus(GLenum target) { return GL_FRAMEBUFFER_COMPLETE; }
+
+//shaders: everything compiles and links, and every uniform and block exists,
+//so uniform updates are counted as they would be on a real device
+GLuint NullRenderDevice::createShader(GLenum type) { return next_name_++; }
+void NullRenderDevice::shaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {}
+void NullRenderDevice::compileShader(GLuint shader) {}
+void NullRenderDevice::getShaderiv(GLuint shader, GLenum pname, GLint* params) { *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0; }
+void NullRenderDevice::getShaderInfoLog(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* info_log) {
+    if (length) *length = 0;
+    if (info_log && max_length > 0) info_log[0] = '\0';
+}
+GLuint NullRenderDevice::createProgram() { return next_name_++; }
+void NullRenderDevice::attachShader(GLuint program, GLuint shader) {}
+void NullRenderDevice::linkProgram(GLuint program) {}
+void NullRenderDevice::getProgramiv(GLuint program, GLenum pname, GLint* params) { *params = pname == GL_LINK_STATUS ? GL_TRUE : 0; }
+void NullRenderDevice::getProgramInfoLog(GLuint program, GLsizei max_length, GLsizei* length, GLchar* info_log) {
+    if (length) *length = 0;
+    if (info_log && max_length > 0) info_log[0] = '\0';
+}
+void NullRenderDevice::useProgram(GLuint program) { frame_stats.state_changes++; }
+GLint NullRenderDevice::getLocation_(LocationMap& locations, GLuint program, const GLchar* name) {
+    auto& program_locations = locations[program];
+    auto it = program_locations.find(name);
+    if (it != program_locations.end()) return it->second;
+    GLint location = (GLint)program_locations.size();
+    program_locations[name] = location;
+    return location;
+}
+GLint NullRenderDevice::getAttribLocation(GLuint program, const GLchar* name) { return getLocation_(attrib_locations_, program, name); }
+GLint NullRenderDevice::getUniformLocation(GLuint program, const GLchar* name) { return getLocation_(uniform_locations_, program, name); }
+GLuint NullRenderDevice::getUniformBlockIndex(GLuint program, const GLchar* name) { return getLocation_(uniform_block_indices_, program, name); }
+void NullRenderDevice::uniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) {}
+void NullRenderDevice::uniform1i(GLint location, GLint v0) { frame_stats.uniform_updates++; }
+void NullRenderDevice::uniform1f(GLint location, GLfloat v0) { frame_stats.uniform_updates++; }
+void NullRenderDevice::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { frame_stats.uniform_updates++; }
+void NullRenderDevice::uniform3fv(GLint location, GLsizei count, const GLfloat* value) { frame_stats.uniform_updates++; }
+void NullRenderDevice::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { frame_stats.uniform_updates++; }
@@ -0,0 +1,90 @@
+#include "RenderDevice.h"
+
+static GLRenderDevice gl_device;
+RenderDevice* GPU = &gl_device;
+
+void RenderDeviceStats::add(const RenderDeviceStats& other) {
+    draw_calls += other.draw_calls;
+    instances += other.instances;
+    indices += other.indices;
+    state_changes += other.state_changes;
+    uniform_updates += other.uniform_updates;
+    buffer_uploads += other.buffer_uploads;
+    texture_uploads += other.texture_uploads;
+    bytes_uploaded += other.bytes_uploaded;
+}
+
+//adds stats of frame to totals, and starts a new frame
+void RenderDevice::endFrame() {
+    total_stats.add(frame_stats);
+    frame_stats = RenderDeviceStats();
+    frames++;
+    state.endFrame();
+}
+
+//GLRenderDevice: straight calls to OpenGL
+
+void GLRenderDevice::viewport(GLint x, GLint y, GLsizei width, GLsizei height) { glViewport(x, y, width, height); }
+void GLRenderDevice::clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { glClearColor(red, green, blue, alpha); }
+void GLRenderDevice::clear(GLbitfield mask) { glClear(mask); }
+void GLRenderDevice::enable(GLenum cap) { glEnable(cap); }
+void GLRenderDevice::cullFace(GLenum mode) { glCullFace(mode); }
+void GLRenderDevice::getIntegerv(GLenum pname, GLint* data) { glGetIntegerv(pname, data); }
+
+void GLRenderDevice::genBuffers(GLsizei n, GLuint* buffers) { glGenBuffers(n, buffers); }
+void GLRenderDevice::deleteBuffers(GLsizei n, const GLuint* buffers) { glDeleteBuffers(n, buffers); }
+void GLRenderDevice::bindBuffer(GLenum target, GLuint buffer) { glBindBuffer(target, buffer); }
+void GLRenderDevice::bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) { glBufferData(target, size, data, usage); }
+void GLRenderDevice::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) { glBufferSubData(target, offset, size, data); }
+void* GLRenderDevice::mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) { return glMapBufferRange(target, offset, length, access); }
+GLboolean GLRenderDevice::unmapBuffer(GLenum target) { return glUnmapBuffer(target); }
+void GLRenderDevice::bindBufferBase(GLenum target, GLuint index, GLuint buffer) { glBindBufferBase(target, index, buffer); }
+void GLRenderDevice::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) { glBindBufferRange(target, index, buffer, offset, size); }
+void GLRenderDevice::genVertexArrays(GLsizei n, GLuint* arrays) { glGenVertexArrays(n, arrays); }
+void GLRenderDevice::bindVertexArray(GLuint array) { glBindVertexArray(array); }
+void GLRenderDevice::enableVertexAttribArray(GLuint index) { glEnableVertexAttribArray(index); }
+void GLRenderDevice::vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) { glVertexAttribPointer(index, size, type, normalized, stride, pointer); }
+void GLRenderDevice::vertexAttribDivisor(GLuint index, GLuint divisor) { glVertexAttribDivisor(index, divisor); }
+
+void GLRenderDevice::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) { glDrawElements(mode, count, type, indices); }
+void GLRenderDevice::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) { glDrawElementsInstanced(mode, count, type, indices, instancecount); }
+
+void GLRenderDevice::genTextures(GLsizei n, GLuint* textures) { glGenTextures(n, textures); }
+void GLRenderDevice::activeTexture(GLenum texture) { glActiveTexture(texture); }
+void GLRenderDevice::bindTexture(GLenum target, GLuint texture) { glBindTexture(target, texture); }
+void GLRenderDevice::texParameteri(GLenum target, GLenum pname, GLint param) { glTexParameteri(target, pname, param); }
+void GLRenderDevice::texParameterf(GLenum target, GLenum pname, GLfloat param) { glTexParameterf(target, pname, param); }
+void GLRenderDevice::texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) { glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels); }
+void GLRenderDevice::generateMipmap(GLenum target) { glGenerateMipmap(target); }
+void GLRenderDevice::pixelStorei(GLenum pname, GLint param) { glPixelStorei(pname, param); }
+
+void GLRenderDevice::genFramebuffers(GLsizei n, GLuint* framebuffers) { glGenFramebuffers(n, framebuffers); }
+void GLRenderDevice::bindFramebuffer(GLenum target, GLuint framebuffer) { glBindFramebuffer(target, framebuffer); }
+void GLRenderDevice::framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) { glFramebufferTexture(target, attachment, texture, level); }
+void GLRenderDevice::genRenderbuffers(GLsizei n, GLuint* renderbuffers) { glGenRenderbuffers(n, renderbuffers); }
+void GLRenderDevice::bindRenderbuffer(GLenum target, GLuint renderbuffer) { glBindRenderbuffer(target, renderbuffer); }
+void GLRenderDevice::renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) { glRenderbufferStorage(target, internalformat, width, height); }
+void GLRenderDevice::framebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) { glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer); }
+void GLRenderDevice::drawBuffers(GLsizei n, const GLenum* bufs) { glDrawBuffers(n, bufs); }
+GLenum GLRenderDevice::checkFramebufferStatus(GLenum target) { return glCheckFramebufferStatus(target); }
+
+GLuint GLRenderDevice::createShader(GLenum type) { return glCreateShader(type); }
+void GLRenderDevice::shaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) { glShaderSource(shader, count, string, length); }
+void GLRenderDevice::compileShader(GLuint shader) { glCompileShader(shader); }
+void GLRenderDevice::getShaderiv(GLuint shader, GLenum pname, GLint* params) { glGetShaderiv(shader, pname, params); }
+void GLRenderDevice::getShaderInfoLog(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* info_log) { glGetShaderInfoLog(shader, max_length, length, info_log); }
+GLuint GLRenderDevice::createProgram() { return glCreateProgram(); }
+void GLRenderDevice::attachShader(GLuint program, GLuint shader) { glAttachShader(program, shader); }
+void GLRenderDevice::linkProgram(GLuint program) { glLinkProgram(program); }
+void GLRenderDevice::getProgramiv(GLuint program, GLenum pname, GLint* params) { glGetProgramiv(program, pname, params); }
+void GLRenderDevice::getProgramInfoLog(GLuint program, GLsizei max_length, GLsizei* length, GLchar* info_log) { glGetProgramInfoLog(program, max_length, length, info_log); }
+void GLRenderDevice::useProgram(GLuint program) { glUseProgram(program); }
+GLint GLRenderDevice::getAttribLocation(GLuint program, const GLchar* name) { return glGetAttribLocation(program, name); }
+GLint GLRenderDevice::getUniformLocation(GLuint program, const GLchar* name) { return glGetUniformLocation(program, name); }
+GLuint GLRenderDevice::getUniformBlockIndex(GLuint program, const GLchar* name) { return glGetUniformBlockIndex(program, name); }
+void GLRenderDevice::uniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) { glUniformBlockBinding(program, block_index, binding); }
+void GLRenderDevice::uniform1i(GLint location, GLint v0) { glUniform1i(location, v0); }
+void GLRenderDevice::uniform1f(GLint location, GLfloat v0) { glUniform1f(location, v0); }
+void GLRenderDevice::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { glUniform3f(location, v0, v1, v2); }
+void GLRenderDevice::uniform3fv(GLint location, GLsizei count, const GLfloat* value) { glUniform3fv(location, count, value); }
+void GLRenderDevice::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glUniformMatrix4fv(location, count, transpose, value); }
@@ -0,0 +1,279 @@
+#pragma once
+#include "../includes.h"
+#include "RenderStateCache.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//what a device was asked to do, filled by recording backends
+struct RenderDeviceStats {
+    unsigned int draw_calls = 0;
+    unsigned int instances = 0; //objects drawn, counting every instance
+    unsigned int indices = 0; //indices drawn, counting every instance
+    unsigned int state_changes = 0; //binds, program, texture and framebuffer changes, enables
+    unsigned int uniform_updates = 0;
+    unsigned int buffer_uploads = 0;
+    unsigned int texture_uploads = 0;
+    size_t bytes_uploaded = 0; //buffer and texture data
+
+    void add(const RenderDeviceStats& other);
+};
+
+// Every GL call made by the engine (apart from window and ImGui setup) goes
+// through the current device, GPU. Methods match the GL function of same name.
+// - GLRenderDevice forwards to OpenGL, and needs a current context
+// - NullRenderDevice needs no context: it only hands out object names and
+//   records draw calls, state changes and uploads, so the whole frame loop
+//   can run headless
+// Program, vertex array, texture, uniform buffer and uniform calls should go
+// through state, which drops the redundant ones
+class RenderDevice {
+public:
+    RenderDevice() : state(this) {}
+    virtual ~RenderDevice() {}
+
+    RenderStateCache state;
+
+    //stats of current frame, and of all finished frames
+    RenderDeviceStats frame_stats;
+    RenderDeviceStats total_stats;
+    unsigned int frames = 0;
+    void endFrame();
+
+    //state
+    virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+    virtual void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) = 0;
+    virtual void clear(GLbitfield mask) = 0;
+    virtual void enable(GLenum cap) = 0;
+    virtual void cullFace(GLenum mode) = 0;
+    virtual void getIntegerv(GLenum pname, GLint* data) = 0;
+
+    //buffers and vertex arrays
+    virtual void genBuffers(GLsizei n, GLuint* buffers) = 0;
+    virtual void deleteBuffers(GLsizei n, const GLuint* buffers) = 0;
+    virtual void bindBuffer(GLenum target, GLuint buffer) = 0;
+    virtual void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+    virtual void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) = 0;
+    virtual void* mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = 0;
+    virtual GLboolean unmapBuffer(GLenum target) = 0;
+    virtual void bindBufferBase(GLenum target, GLuint index, GLuint buffer) = 0;
+    virtual void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) = 0;
+    virtual void genVertexArrays(GLsizei n, GLuint* arrays) = 0;
+    virtual void bindVertexArray(GLuint array) = 0;
+    virtual void enableVertexAttribArray(GLuint index) = 0;
+    virtual void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) = 0;
+    virtual void vertexAttribDivisor(GLuint index, GLuint divisor) = 0;
+
+    //drawing
+    virtual void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) = 0;
+    virtual void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) = 0;
+
+    //textures
+    virtual void genTextures(GLsizei n, GLuint* textures) = 0;
+    virtual void activeTexture(GLenum texture) = 0;
+    virtual void bindTexture(GLenum target, GLuint texture) = 0;
+    virtual void texParameteri(GLenum target, GLenum pname, GLint param) = 0;
+    virtual void texParameterf(GLenum target, GLenum pname, GLfloat param) = 0;
+    virtual void texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) = 0;
+    virtual void generateMipmap(GLenum target) = 0;
+    virtual void pixelStorei(GLenum pname, GLint param) = 0;
+
+    //framebuffers
+    virtual void genFramebuffers(GLsizei n, GLuint* framebuffers) = 0;
+    virtual void bindFramebuffer(GLenum target, GLuint framebuffer) = 0;
+    virtual void framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) = 0;
+    virtual void genRenderbuffers(GLsizei n, GLuint* renderbuffers) = 0;
+    virtual void bindRenderbuffer(GLenum target, GLuint renderbuffer) = 0;
+    virtual void renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) = 0;
+    virtual void framebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) = 0;
+    virtual void drawBuffers(GLsizei n, const GLenum* bufs) = 0;
+    virtual GLenum checkFramebufferStatus(GLenum target) = 0;
+
+    //shaders
+    virtual GLuint createShader(GLenum type) = 0;
+    virtual void shaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) = 0;
+    virtual void compileShader(GLuint shader) = 0;
+    virtual void getShaderiv(GLuint shader, GLenum pname, GLint* params) = 0;
+    virtual void getShaderInfoLog(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* info_log) = 0;
+    virtual GLuint createProgram() = 0;
+    virtual void attachShader(GLuint program, GLuint shader) = 0;
+    virtual void linkProgram(GLuint program) = 0;
+    virtual void getProgramiv(GLuint program, GLenum pname, GLint* params) = 0;
+    virtual void getProgramInfoLog(GLuint program, GLsizei max_length, GLsizei* length, GLchar* info_log) = 0;
+    virtual void useProgram(GLuint program) = 0;
+    virtual GLint getAttribLocation(GLuint program, const GLchar* name) = 0;
+    virtual GLint getUniformLocation(GLuint program, const GLchar* name) = 0;
+    virtual GLuint getUniformBlockIndex(GLuint program, const GLchar* name) = 0;
+    virtual void uniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) = 0;
+    virtual void uniform1i(GLint location, GLint v0) = 0;
+    virtual void uniform1f(GLint location, GLfloat v0) = 0;
+    virtual void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) = 0;
+    virtual void uniform3fv(GLint location, GLsizei count, const GLfloat* value) = 0;
+    virtual void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) = 0;
+};
+
+class GLRenderDevice : public RenderDevice {
+public:
+    //state
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) override;
+    void clear(GLbitfield mask) override;
+    void enable(GLenum cap) override;
+    void cullFace(GLenum mode) override;
+    void getIntegerv(GLenum pname, GLint* data) override;
+
+    //buffers and vertex arrays
+    void genBuffers(GLsizei n, GLuint* buffers) override;
+    void deleteBuffers(GLsizei n, const GLuint* buffers) override;
+    void bindBuffer(GLenum target, GLuint buffer) override;
+    void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+    void* mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+    GLboolean unmapBuffer(GLenum target) override;
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer) override;
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+    void genVertexArrays(GLsizei n, GLuint* arrays) override;
+    void bindVertexArray(GLuint array) override;
+    void enableVertexAttribArray(GLuint index) override;
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+    void vertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    //drawing
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) override;
+
+    //textures
+    void genTextures(GLsizei n, GLuint* textures) override;
+    void activeTexture(GLenum texture) override;
+    void bindTexture(GLenum target, GLuint texture) override;
+    void texParameteri(GLenum target, GLenum pname, GLint param) override;
+    void texParameterf(GLenum target, GLenum pname, GLfloat param) override;
+    void texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) override;
+    void generateMipmap(GLenum target) override;
+    void pixelStorei(GLenum pname, GLint param) override;
+
+    //framebuffers
+    void genFramebuffers(GLsizei n, GLuint* framebuffers) override;
+    void bindFramebuffer(GLenum target, GLuint framebuffer) override;
+    void framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) override;
+    void genRenderbuffers(GLsizei n, GLuint* renderbuffers) override;
+    void bindRenderbuffer(GLenum target, GLuint renderbuffer) override;
+    void renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) override;
+    void framebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) override;
+    void drawBuffers(GLsizei n, const GLenum* bufs) override;
+    GLenum checkFramebufferStatus(GLenum target) override;
+
+    //shaders
+    GLuint createShader(GLenum type) override;
+    void shaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) override;
+    void compileShader(GLuint shader) override;
+    void getShaderiv(GLuint shader, GLenum pname, GLint* params) override;
+    void getShaderInfoLog(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* info_log) override;
+    GLuint createProgram() override;
+    void attachShader(GLuint program, GLuint shader) override;
+    void linkProgram(GLuint program) override;
+    void getProgramiv(GLuint program, GLenum pname, GLint* params) override;
+    void getProgramInfoLog(GLuint program, GLsizei max_length, GLsizei* length, GLchar* info_log) override;
+    void useProgram(GLuint program) override;
+    GLint getAttribLocation(GLuint program, const GLchar* name) override;
+    GLint getUniformLocation(GLuint program, const GLchar* name) override;
+    GLuint getUniformBlockIndex(GLuint program, const GLchar* name) override;
+    void uniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) override;
+    void uniform1i(GLint location, GLint v0) override;
+    void uniform1f(GLint location, GLfloat v0) override;
+    void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) override;
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+};
+
+class NullRenderDevice : public RenderDevice {
+public:
+    //state
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) override;
+    void clear(GLbitfield mask) override;
+    void enable(GLenum cap) override;
+    void cullFace(GLenum mode) override;
+    void getIntegerv(GLenum pname, GLint* data) override;
+
+    //buffers and vertex arrays
+    void genBuffers(GLsizei n, GLuint* buffers) override;
+    void deleteBuffers(GLsizei n, const GLuint* buffers) override;
+    void bindBuffer(GLenum target, GLuint buffer) override;
+    void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+    void* mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+    GLboolean unmapBuffer(GLenum target) override;
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer) override;
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+    void genVertexArrays(GLsizei n, GLuint* arrays) override;
+    void bindVertexArray(GLuint array) override;
+    void enableVertexAttribArray(GLuint index) override;
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+    void vertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    //drawing
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) override;
+
+    //textures
+    void genTextures(GLsizei n, GLuint* textures) override;
+    void activeTexture(GLenum texture) override;
+    void bindTexture(GLenum target, GLuint texture) override;
+    void texParameteri(GLenum target, GLenum pname, GLint param) override;
+    void texParameterf(GLenum target, GLenum pname, GLfloat param) override;
+    void texImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) override;
+    void generateMipmap(GLenum target) override;
+    void pixelStorei(GLenum pname, GLint param) override;
+
+    //framebuffers
+    void genFramebuffers(GLsizei n, GLuint* framebuffers) override;
+    void bindFramebuffer(GLenum target, GLuint framebuffer) override;
+    void framebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) override;
+    void genRenderbuffers(GLsizei n, GLuint* renderbuffers) override;
+    void bindRenderbuffer(GLenum target, GLuint renderbuffer) override;
+    void renderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) override;
+    void framebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) override;
+    void drawBuffers(GLsizei n, const GLenum* bufs) override;
+    GLenum checkFramebufferStatus(GLenum target) override;
+
+    //shaders
+    GLuint createShader(GLenum type) override;
+    void shaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) override;
+    void compileShader(GLuint shader) override;
+    void getShaderiv(GLuint shader, GLenum pname, GLint* params) override;
+    void getShaderInfoLog(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* info_log) override;
+    GLuint createProgram() override;
+    void attachShader(GLuint program, GLuint shader) override;
+    void linkProgram(GLuint program) override;
+    void getProgramiv(GLuint program, GLenum pname, GLint* params) override;
+    void getProgramInfoLog(GLuint program, GLsizei max_length, GLsizei* length, GLchar* info_log) override;
+    void useProgram(GLuint program) override;
+    GLint getAttribLocation(GLuint program, const GLchar* name) override;
+    GLint getUniformLocation(GLuint program, const GLchar* name) override;
+    GLuint getUniformBlockIndex(GLuint program, const GLchar* name) override;
+    void uniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) override;
+    void uniform1i(GLint location, GLint v0) override;
+    void uniform1f(GLint location, GLfloat v0) override;
+    void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) override;
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value) override;
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+
+private:
+    GLuint next_name_ = 1; //names of all objects share one counter
+    //mapped buffers all point to this
+    std::vector<unsigned char> mapped_;
+    //texture data comes from a pixel buffer when one is bound, even if pixels is null (offset 0)
+    bool unpack_buffer_bound_ = false;
+
+    //locations handed out per program, numbered from 0 in order first asked
+    //for, so every name of a program has its own and asking again gives the same
+    typedef std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> LocationMap;
+    LocationMap attrib_locations_;
+    LocationMap uniform_locations_;
+    LocationMap uniform_block_indices_;
+    static GLint getLocation_(LocationMap& locations, GLuint program, const GLchar* name);
+};
+
+//current device, a GLRenderDevice unless changed before any GL resource is created
+extern RenderDevice* GPU;
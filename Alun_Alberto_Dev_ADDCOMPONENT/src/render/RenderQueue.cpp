@@ -0,0 +1,58 @@
+#include "RenderQueue.h"
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+uint64_t RenderQueue::makeKey(DrawPass pass, int shader, int material, int geometry, float depth) {
+    assert(shader >= 0 && shader < (1 << SHADER_BITS));
+    assert(material >= 0 && material < (1 << MATERIAL_BITS));
+    assert(geometry >= 0 && geometry < (1 << GEOMETRY_BITS));
+
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+    uint64_t depth_bits = (uint64_t)(depth * ((1 << DEPTH_BITS) - 1));
+
+    uint64_t key = (uint64_t)pass;
+    key = (key << SHADER_BITS) | (uint64_t)shader;
+    key = (key << MATERIAL_BITS) | (uint64_t)material;
+    key = (key << GEOMETRY_BITS) | (uint64_t)geometry;
+    key = (key << DEPTH_BITS) | depth_bits;
+    return key;
+}
+
+void RenderQueue::sort() {
+    size_t count = items_.size();
+    if (count < 2) return;
+    scratch_.resize(count);
+
+    //count every byte of every key in one pass over the items
+    static const int NUM_BYTES = 8;
+    size_t histograms[NUM_BYTES][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (const DrawItem& draw : items_) {
+        for (int b = 0; b < NUM_BYTES; b++)
+            histograms[b][(draw.key >> (b * 8)) & 0xFF]++;
+    }
+
+    //scatter by each byte, least significant first
+    DrawItem* src = items_.data();
+    DrawItem* dst = scratch_.data();
+    for (int b = 0; b < NUM_BYTES; b++) {
+        size_t* histogram = histograms[b];
+        //all keys have same value for byte, order would not change
+        if (histogram[(src[0].key >> (b * 8)) & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (int i = 0; i < 256; i++) {
+            size_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++)
+            dst[histogram[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+        std::swap(src, dst);
+    }
+
+    //after an odd number of passes result is in scratch
+    if (src != items_.data()) items_.swap(scratch_);
+}
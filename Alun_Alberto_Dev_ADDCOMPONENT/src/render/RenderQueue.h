@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//pass a draw belongs to, highest bits of its key so passes are drawn in order
+enum DrawPass {
+    DRAW_PASS_OPAQUE = 0,
+};
+
+//a draw and its sort key. item is whatever the caller draws, e.g. a mesh index
+struct DrawItem {
+    uint64_t key;
+    int item;
+};
+
+// Draws of a frame, sorted by 64 bit key. From highest bits to lowest:
+// - pass (4 bits)
+// - shader (12 bits), material (16 bits), geometry (16 bits): draws sharing
+//   state are consecutive, so state changes are minimal and instancing can
+//   merge them
+// - depth (16 bits): front to back within a run, to save overdraw
+// Sorted with an LSD radix sort on bytes, skipping bytes which are the same
+// in every key, so cost is linear and low when few fields vary
+class RenderQueue {
+public:
+    static const int SHADER_BITS = 12;
+    static const int MATERIAL_BITS = 16;
+    static const int GEOMETRY_BITS = 16;
+    static const int DEPTH_BITS = 16;
+
+    //depth is in [0, 1], larger values are clamped
+    static uint64_t makeKey(DrawPass pass, int shader, int material, int geometry, float depth);
+
+    void clear() { items_.clear(); }
+    void push(uint64_t key, int item) { items_.push_back({ key, item }); }
+    //stable, so equal keys keep the order they were pushed in
+    void sort();
+
+    const std::vector<DrawItem>& getItems() { return items_; }
+    size_t size() { return items_.size(); }
+
+private:
+    std::vector<DrawItem> items_;
+    std::vector<DrawItem> scratch_;
+};
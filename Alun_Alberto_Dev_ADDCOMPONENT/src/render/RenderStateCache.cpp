@@ -0,0 +1,129 @@
+#include "RenderStateCache.h"
+#include "RenderDevice.h"
+#include <cstring>
+
+//all names are valid GL values, so use one no object has
+static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+//index of target in textures_, -1 if not tracked
+static int textureTargetIndex(GLenum target) {
+    if (target == GL_TEXTURE_2D) return 0;
+    if (target == GL_TEXTURE_CUBE_MAP) return 1;
+    return -1;
+}
+
+//counts call, and returns whether it must be issued
+bool RenderStateCache::check_(bool changed) {
+    if (changed) frame_stats.issued++;
+    else frame_stats.skipped++;
+    return changed;
+}
+
+void RenderStateCache::invalidate() {
+    program_ = UNKNOWN;
+    vertex_array_ = UNKNOWN;
+    active_unit_ = UNKNOWN;
+    for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        textures_[i][0] = textures_[i][1] = UNKNOWN;
+    for (int i = 0; i < MAX_UNIFORM_BUFFERS; i++)
+        uniform_buffers_[i] = { UNKNOWN, 0, 0 };
+    //uniform values are kept: they belong to programs, which only we change
+}
+
+void RenderStateCache::endFrame() {
+    last_frame_stats = frame_stats;
+    frame_stats = RenderStateStats();
+}
+
+void RenderStateCache::useProgram(GLuint program) {
+    if (!check_(program != program_)) return;
+    program_ = program;
+    device_->useProgram(program);
+}
+
+void RenderStateCache::bindVertexArray(GLuint array) {
+    if (!check_(array != vertex_array_)) return;
+    vertex_array_ = array;
+    device_->bindVertexArray(array);
+}
+
+void RenderStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    int target_index = textureTargetIndex(target);
+    bool tracked = unit < MAX_TEXTURE_UNITS && target_index >= 0;
+    if (!check_(!tracked || textures_[unit][target_index] != texture)) return;
+
+    if (active_unit_ != unit) {
+        active_unit_ = unit;
+        device_->activeTexture(GL_TEXTURE0 + unit);
+    }
+    device_->bindTexture(target, texture);
+    if (tracked) textures_[unit][target_index] = texture;
+}
+
+//true if range is not known to be bound to uniform buffer index, and stores it
+bool RenderStateCache::uniformBufferChanged_(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    if (target != GL_UNIFORM_BUFFER || index >= MAX_UNIFORM_BUFFERS) return check_(true);
+    BufferRange& bound = uniform_buffers_[index];
+    if (!check_(bound.buffer != buffer || bound.offset != offset || bound.size != size)) return false;
+    bound = { buffer, offset, size };
+    return true;
+}
+
+void RenderStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    if (uniformBufferChanged_(target, index, buffer, 0, -1)) device_->bindBufferBase(target, index, buffer);
+}
+
+void RenderStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    if (uniformBufferChanged_(target, index, buffer, offset, size))
+        device_->bindBufferRange(target, index, buffer, offset, size);
+}
+
+GLint RenderStateCache::getUniformLocation(GLuint program, const GLchar* name) {
+    auto& locations = uniform_locations_[program];
+    auto it = locations.find(name);
+    if (!check_(it == locations.end())) return it->second;
+    GLint location = device_->getUniformLocation(program, name);
+    locations[name] = location;
+    return location;
+}
+
+bool RenderStateCache::uniformChanged_(GLint location, const void* value, int words) {
+    //location -1 is ignored by GL
+    if (location < 0 || program_ == UNKNOWN) return check_(true);
+
+    uint64_t key = ((uint64_t)program_ << 32) | (uint32_t)location;
+    //not cacheable (too big, or words < 0): forget value, so next set is issued
+    if (words < 0 || words > 16) {
+        uniform_values_.erase(key);
+        return check_(true);
+    }
+    UniformValue& cached = uniform_values_[key];
+    size_t bytes = words * sizeof(GLuint);
+    if (!check_(cached.words != words || memcmp(cached.data, value, bytes) != 0)) return false;
+    cached.words = words;
+    memcpy(cached.data, value, bytes);
+    return true;
+}
+
+void RenderStateCache::uniform1i(GLint location, GLint v0) {
+    if (uniformChanged_(location, &v0, 1)) device_->uniform1i(location, v0);
+}
+
+void RenderStateCache::uniform1f(GLint location, GLfloat v0) {
+    if (uniformChanged_(location, &v0, 1)) device_->uniform1f(location, v0);
+}
+
+void RenderStateCache::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    GLfloat value[3] = { v0, v1, v2 };
+    if (uniformChanged_(location, value, 3)) device_->uniform3f(location, v0, v1, v2);
+}
+
+void RenderStateCache::uniform3fv(GLint location, GLsizei count, const GLfloat* value) {
+    if (uniformChanged_(location, value, 3 * count)) device_->uniform3fv(location, count, value);
+}
+
+void RenderStateCache::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    //transposed values are a different matrix, so just don't cache them
+    if (uniformChanged_(location, value, transpose ? -1 : 16 * count))
+        device_->uniformMatrix4fv(location, count, transpose, value);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "../includes.h"
+#include <string>
+#include <unordered_map>
+
+class RenderDevice;
+
+//calls made to a RenderStateCache, and how many of them reached the device
+struct RenderStateStats {
+    unsigned int issued = 0;
+    unsigned int skipped = 0;
+};
+
+// Remembers the program, vertex array, textures, uniform buffer ranges and
+// uniform values last set on its device, and drops calls which would set the
+// same again. Also caches uniform locations by name.
+// Tracked state must only be changed through here (GPU->state) or the cache
+// goes stale: code which sets it behind our back, like ImGui, must call
+// invalidate afterwards
+class RenderStateCache {
+public:
+    static const int MAX_TEXTURE_UNITS = 16;
+    static const int MAX_UNIFORM_BUFFERS = 8;
+
+    explicit RenderStateCache(RenderDevice* device) : device_(device) { invalidate(); }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint array);
+    //makes unit active only if texture is not already bound to it
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    //location in program of uniform, asked to device only first time
+    GLint getUniformLocation(GLuint program, const GLchar* name);
+    //set uniforms of current program
+    void uniform1i(GLint location, GLint v0);
+    void uniform1f(GLint location, GLfloat v0);
+    void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+    void uniform3fv(GLint location, GLsizei count, const GLfloat* value);
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+
+    //forget all state, so next call of each kind is issued
+    void invalidate();
+
+    //stats of current and last complete frame
+    RenderStateStats frame_stats;
+    RenderStateStats last_frame_stats;
+    void endFrame();
+
+private:
+    struct BufferRange {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size; //-1 for whole buffer
+    };
+    //uniform values are compared as raw 32 bit words
+    struct UniformValue {
+        int words = 0;
+        GLuint data[16];
+    };
+
+    RenderDevice* device_;
+    GLuint program_;
+    GLuint vertex_array_;
+    GLuint active_unit_;
+    GLuint textures_[MAX_TEXTURE_UNITS][2]; //2D and cube map bound to each unit
+    BufferRange uniform_buffers_[MAX_UNIFORM_BUFFERS];
+    std::unordered_map<uint64_t, UniformValue> uniform_values_; //program and location, value
+    std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> uniform_locations_;
+
+    //true if value differs from last set on location of current program, and stores it
+    bool uniformChanged_(GLint location, const void* value, int words);
+    bool uniformBufferChanged_(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    bool check_(bool changed);
+};
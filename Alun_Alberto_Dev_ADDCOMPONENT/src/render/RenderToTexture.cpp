@@ -1,4 +1,5 @@
 #include "RenderToTexture.h"
+#include "RenderDevice.h"
 
 // Temporal render to texture
 // This should be improved and move somewhere else
@@ -28,37 +29,37 @@ RenderToTexture::~RenderToTexture()
 
 bool RenderToTexture::Init() {
 
-    glGenFramebuffers(1, &frambuffer_name_);
-    glBindFramebuffer(GL_FRAMEBUFFER, frambuffer_name_);
+    GPU->genFramebuffers(1, &frambuffer_name_);
+    GPU->bindFramebuffer(GL_FRAMEBUFFER, frambuffer_name_);
 
     // The texture we're going to render to
-    glGenTextures(1, &colorbuffer_);
+    GPU->genTextures(1, &colorbuffer_);
 
     // "Bind" the newly created texture : all future texture functions will modify this texture
-    glBindTexture(GL_TEXTURE_2D, colorbuffer_);
+    GPU->state.bindTexture(0, GL_TEXTURE_2D, colorbuffer_);
 
     // Give an empty image to OpenGL ( the last "0" )
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, xres_, yres_, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    GPU->texImage2D(GL_TEXTURE_2D, 0, GL_RGB, xres_, yres_, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
 
     // Poor filtering. Needed !
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
     // The depth buffer
-    glGenRenderbuffers(1, &depthbuffer_);
-    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, xres_, yres_);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer_);
+    GPU->genRenderbuffers(1, &depthbuffer_);
+    GPU->bindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
+    GPU->renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, xres_, yres_);
+    GPU->framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer_);
 
     // Set "renderedTexture" as our colour attachement #0
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorbuffer_, 0);
+    GPU->framebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorbuffer_, 0);
 
     // Set the list of draw buffers.
     GLenum DrawBuffers[1] = { GL_COLOR_ATTACHMENT0 };
-    glDrawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
+    GPU->drawBuffers(1, DrawBuffers); // "1" is the size of DrawBuffers
 
     // Always check that our framebuffer is ok
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    if (GPU->checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         return false;
 
     return true;
@@ -66,13 +67,13 @@ bool RenderToTexture::Init() {
 
 void RenderToTexture::Activate()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glBindFramebuffer(GL_FRAMEBUFFER, frambuffer_name_);
+    GPU->bindFramebuffer(GL_FRAMEBUFFER, frambuffer_name_);
+    GPU->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void RenderToTexture::Deactivate()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GPU->bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void RenderToTexture::Destroy()
@@ -0,0 +1,160 @@
+#include "TextureStreamer.h"
+#include "RenderDevice.h"
+#include "../Parsers.h"
+#include "../Profiler.h"
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer::~TextureStreamer() {
+    //decode jobs write into requests, so they must be done before those are freed
+    JobSystem::get().wait(decode_counter_);
+    for (auto& request : requests_) {
+        if (request->data == nullptr) continue;
+        free(request->data->data);
+        delete request->data;
+    }
+    for (int i = 0; i < NUM_PIXEL_BUFFERS; i++)
+        if (pixel_buffers_[i]) GPU->deleteBuffers(1, &pixel_buffers_[i]);
+}
+
+GLint TextureStreamer::request(const std::string& filename) {
+    PROFILE_SCOPE("TextureStreamer::request");
+    std::string ext = filename.size() >= 4 ? filename.substr(filename.size() - 4, 4) : "";
+    if (ext != ".tga" && ext != ".TGA" && ext != ".tex") {
+        std::cerr << "ERROR: No extension or extension not supported: " << filename << std::endl;
+        return -1;
+    }
+
+    GLuint texture;
+    GPU->genTextures(1, &texture);
+    GPU->state.bindTexture(0, GL_TEXTURE_2D, texture);
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    GPU->texParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 4);
+
+    //placeholder is the only level until data arrives
+    static const GLubyte placeholder[4] = { 128, 128, 128, 255 };
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    GPU->texImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+    requests_.emplace_back(new Request());
+    Request* request = requests_.back().get();
+    request->filename = filename;
+    request->texture = texture;
+    JobSystem::get().runBackground([request]() {
+        TGAInfo* data = Parsers::loadTexture(request->filename);
+        if (data) {
+            Parsers::generateMips(data);
+            request->next_level = data->num_levels;
+        }
+        request->data = data;
+        request->decoded = true;
+    }, &decode_counter_);
+    return texture;
+}
+
+size_t TextureStreamer::getLevelBytes_(const TGAInfo& info, GLuint level) {
+    GLuint width = std::max(info.width >> level, 1u);
+    GLuint height = std::max(info.height >> level, 1u);
+    return (size_t)width * height * (info.bpp / 8);
+}
+
+void TextureStreamer::update() {
+    if (requests_.empty()) return;
+    PROFILE_SCOPE("TextureStreamer::update");
+
+    //pick the smallest level left of any texture until budget is spent, so low
+    //levels of every texture are resident before the full size of any
+    uploads_.clear();
+    size_t total_bytes = 0;
+    while (true) {
+        Request* smallest = nullptr;
+        size_t smallest_bytes = 0;
+        for (auto& request : requests_) {
+            if (!request->decoded || request->data == nullptr || request->next_level == 0) continue;
+            size_t bytes = getLevelBytes_(*request->data, request->next_level - 1);
+            if (smallest == nullptr || bytes < smallest_bytes) {
+                smallest = request.get();
+                smallest_bytes = bytes;
+            }
+        }
+        if (smallest == nullptr || (total_bytes > 0 && total_bytes + smallest_bytes > budget_bytes_)) break;
+        smallest->next_level--;
+        uploads_.push_back({ smallest, smallest->next_level, total_bytes });
+        total_bytes += smallest_bytes;
+    }
+    if (!uploads_.empty()) uploadLevels_();
+
+    //forget textures which are complete, or could not be read and keep their placeholder
+    for (size_t i = 0; i < requests_.size();) {
+        Request& request = *requests_[i];
+        if (!request.decoded || (request.data && request.next_level > 0)) {
+            i++;
+            continue;
+        }
+        if (request.data) {
+            free(request.data->data);
+            delete request.data;
+        }
+        else
+            std::cerr << "ERROR: Could not load texture " << request.filename << std::endl;
+        requests_[i] = std::move(requests_.back());
+        requests_.pop_back();
+    }
+}
+
+// Levels picked by update are copied into one pixel buffer, then each
+// texture level is specified from its offset in the buffer, so GL copies
+// them to the texture without the main thread waiting for it
+void TextureStreamer::uploadLevels_() {
+    const LevelUpload& last = uploads_.back();
+    size_t total_bytes = last.offset + getLevelBytes_(*last.request->data, last.level);
+
+    GLuint& buffer = pixel_buffers_[next_pixel_buffer_];
+    size_t& buffer_size = pixel_buffer_sizes_[next_pixel_buffer_];
+    next_pixel_buffer_ = (next_pixel_buffer_ + 1) % NUM_PIXEL_BUFFERS;
+    if (buffer == 0) GPU->genBuffers(1, &buffer);
+    GPU->bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (buffer_size < total_bytes) {
+        GPU->bufferData(GL_PIXEL_UNPACK_BUFFER, total_bytes, NULL, GL_STREAM_DRAW);
+        buffer_size = total_bytes;
+    }
+
+    //invalidating lets GL hand out fresh memory if the old contents are still being read
+    unsigned char* mapped = (unsigned char*)GPU->mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total_bytes,
+                                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped == nullptr) {
+        //try again next update
+        for (const LevelUpload& upload : uploads_) upload.request->next_level++;
+        GPU->bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    for (const LevelUpload& upload : uploads_) {
+        const TGAInfo& info = *upload.request->data;
+        size_t level_offset = mipChainBytes(info.width, info.height, info.bpp / 8, upload.level);
+        memcpy(mapped + upload.offset, info.data + level_offset, getLevelBytes_(info, upload.level));
+    }
+    GPU->unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    //rows of smaller mip levels are not 4 byte aligned
+    GPU->pixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const LevelUpload& upload : uploads_) {
+        const TGAInfo& info = *upload.request->data;
+        GPU->state.bindTexture(0, GL_TEXTURE_2D, upload.request->texture);
+        GPU->texImage2D(GL_TEXTURE_2D, upload.level,
+                        (info.bpp == 24 ? GL_RGB : GL_RGBA),
+                        std::max(info.width >> upload.level, 1u),
+                        std::max(info.height >> upload.level, 1u),
+                        0,
+                        (info.bpp == 24 ? GL_BGR : GL_BGRA),
+                        GL_UNSIGNED_BYTE,
+                        (const void*)upload.offset); //offset in bound pixel buffer
+
+        //texture samples only from levels which have arrived
+        if (upload.level == info.num_levels - 1)
+            GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, upload.level);
+        GPU->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+    }
+    GPU->bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "../includes.h"
+#include "../JobSystem.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TGAInfo;
+
+// Loads textures without stalling frames:
+// - request creates the texture at once, showing a 1x1 placeholder, and
+//   queues a background job which reads the file (and builds its mip chain
+//   if it is not cooked) on an idle worker
+// - update, once per frame on main thread, uploads levels of decoded textures
+//   through a pixel buffer, smallest levels of all textures first, until the
+//   frame budget is spent. Base level of each texture is lowered as its
+//   levels arrive, so it is always complete and sharpens over a few frames
+class TextureStreamer {
+public:
+    ~TextureStreamer();
+
+    //texture for a .tga or .tex file, or -1 if it is of another type
+    GLint request(const std::string& filename);
+
+    //uploads pending levels, up to budget. Main thread only
+    void update();
+
+    //bytes of level data uploaded per update. A level larger than the budget
+    //is still uploaded when it is the first of an update
+    void setBudget(size_t bytes) { budget_bytes_ = bytes; }
+
+    //textures with levels not uploaded yet
+    int getPendingCount() { return (int)requests_.size(); }
+
+private:
+    struct Request {
+        std::string filename;
+        GLuint texture;
+        //set by decode job. data stays null if file could not be read
+        TGAInfo* data = nullptr;
+        std::atomic<bool> decoded{ false };
+        //next level to upload, counting down to 0. num_levels until first upload
+        GLuint next_level = 0;
+    };
+    std::vector<std::unique_ptr<Request>> requests_;
+    JobCounter decode_counter_;
+
+    size_t budget_bytes_ = 4 * 1024 * 1024;
+
+    //levels uploaded in one update share a pixel buffer. Buffers are used in
+    //turn, so one being written is not one GL may still be reading from
+    static const int NUM_PIXEL_BUFFERS = 3;
+    GLuint pixel_buffers_[NUM_PIXEL_BUFFERS] = {};
+    size_t pixel_buffer_sizes_[NUM_PIXEL_BUFFERS] = {};
+    int next_pixel_buffer_ = 0;
+
+    //a level picked for upload in this update
+    struct LevelUpload {
+        Request* request;
+        GLuint level;
+        size_t offset; //in pixel buffer
+    };
+    std::vector<LevelUpload> uploads_;
+
+    static size_t getLevelBytes_(const TGAInfo& info, GLuint level);
+    void uploadLevels_();
+};
@@ -0,0 +1,185 @@
+#include "VertexFormat.h"
+#include <cmath>
+#include <cstring>
+
+bool VertexLayout::matches(const VertexLayout& other) const {
+    if (stride != other.stride || attributes.size() != other.attributes.size())
+        return false;
+    for (size_t i = 0; i < attributes.size(); i++) {
+        const VertexAttribute& a = attributes[i];
+        const VertexAttribute& b = other.attributes[i];
+        if (a.location != b.location || a.size != b.size || a.type != b.type ||
+            a.normalized != b.normalized || a.offset != b.offset)
+            return false;
+    }
+    return true;
+}
+
+const float VertexFormat::MAX_HALF_UV = 2.0f;
+
+VertexLayout VertexFormat::getLayout(bool has_uvs, bool has_normals) const {
+    VertexLayout layout;
+    GLuint offset = 0;
+    layout.attributes.push_back({ 0, 3, GL_FLOAT, GL_FALSE, offset });
+    offset += 3 * sizeof(float);
+    if (has_uvs) {
+        if (half_uvs) {
+            layout.attributes.push_back({ 1, 2, GL_HALF_FLOAT, GL_FALSE, offset });
+            offset += 2 * sizeof(uint16_t);
+        }
+        else {
+            layout.attributes.push_back({ 1, 2, GL_FLOAT, GL_FALSE, offset });
+            offset += 2 * sizeof(float);
+        }
+    }
+    if (has_normals) {
+        if (packed_normals) {
+            //w is unused, shader reads a vec3
+            layout.attributes.push_back({ 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset });
+            offset += sizeof(uint32_t);
+        }
+        else {
+            layout.attributes.push_back({ 2, 3, GL_FLOAT, GL_FALSE, offset });
+            offset += 3 * sizeof(float);
+        }
+    }
+    layout.stride = offset;
+    return layout;
+}
+
+std::string VertexFormat::getTypeName(bool has_uvs, bool has_normals) const {
+    std::string name = "Pos";
+    if (has_uvs) name += half_uvs ? "UvH" : "Uv";
+    if (has_normals) name += packed_normals ? "Nq" : "N";
+    return name;
+}
+
+VertexFormat getSourceFormat(const VertexSource& source, const VertexFormat& format) {
+    VertexFormat result = format;
+    if (!format.half_uvs || source.uvs == nullptr) return result;
+    for (size_t i = 0; i < source.num_vertices; i++) {
+        float uv[2];
+        memcpy(uv, source.uvs + i * source.uv_stride, sizeof(uv));
+        if (!(fabsf(uv[0]) <= VertexFormat::MAX_HALF_UV && fabsf(uv[1]) <= VertexFormat::MAX_HALF_UV)) {
+            result.half_uvs = false;
+            break;
+        }
+    }
+    return result;
+}
+
+void packVertices(const VertexSource& source, const VertexFormat& source_format,
+                  VertexLayout& layout, std::vector<unsigned char>& result) {
+    VertexFormat format = getSourceFormat(source, source_format);
+    layout = format.getLayout(source.uvs != nullptr, source.normals != nullptr);
+    GLuint uv_offset = 0, normal_offset = 0;
+    for (const VertexAttribute& attribute : layout.attributes) {
+        if (attribute.location == 1) uv_offset = attribute.offset;
+        if (attribute.location == 2) normal_offset = attribute.offset;
+    }
+
+    result.resize(source.num_vertices * layout.stride);
+    for (size_t i = 0; i < source.num_vertices; i++) {
+        unsigned char* vertex = result.data() + i * layout.stride;
+        memcpy(vertex, source.positions + i * source.position_stride, 3 * sizeof(float));
+
+        if (source.uvs) {
+            float uv[2];
+            memcpy(uv, source.uvs + i * source.uv_stride, sizeof(uv));
+            if (format.half_uvs) {
+                uint16_t half_uv[2] = { floatToHalf(uv[0]), floatToHalf(uv[1]) };
+                memcpy(vertex + uv_offset, half_uv, sizeof(half_uv));
+            }
+            else {
+                memcpy(vertex + uv_offset, uv, sizeof(uv));
+            }
+        }
+        if (source.normals) {
+            float normal[3];
+            memcpy(normal, source.normals + i * source.normal_stride, sizeof(normal));
+            if (format.packed_normals) {
+                uint32_t packed = packNormal10_10_10_2(normal[0], normal[1], normal[2]);
+                memcpy(vertex + normal_offset, &packed, sizeof(packed));
+            }
+            else {
+                memcpy(vertex + normal_offset, normal, sizeof(normal));
+            }
+        }
+    }
+}
+
+GLenum packIndices(const void* indices, size_t num_indices, GLuint bytes_per_index,
+                   size_t num_vertices, std::vector<unsigned char>& result) {
+    GLuint result_bytes = num_vertices <= 65536 ? 2 : 4;
+    result.resize(num_indices * result_bytes);
+    if (bytes_per_index == result_bytes) {
+        memcpy(result.data(), indices, result.size());
+    }
+    else {
+        const unsigned char* src = (const unsigned char*)indices;
+        for (size_t i = 0; i < num_indices; i++) {
+            uint32_t index;
+            if (bytes_per_index == 2) {
+                uint16_t index16;
+                memcpy(&index16, src + i * 2, 2);
+                index = index16;
+            }
+            else {
+                memcpy(&index, src + i * 4, 4);
+            }
+            if (result_bytes == 2) {
+                uint16_t index16 = (uint16_t)index;
+                memcpy(result.data() + i * 2, &index16, 2);
+            }
+            else {
+                memcpy(result.data() + i * 4, &index, 4);
+            }
+        }
+    }
+    return result_bytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+//IEEE 754 half, rounding to nearest even
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t float_exponent = (bits >> 23) & 0xFF;
+    int32_t exponent = float_exponent - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    //infinity and nan
+    if (float_exponent == 0xFF) return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    //too big
+    if (exponent >= 31) return (uint16_t)(sign | 0x7C00);
+    //too small for a normal half: denormal, or zero
+    if (exponent <= 0) {
+        if (exponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1))) half_mantissa++;
+        return (uint16_t)(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    //a carry into exponent is still the right result
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return (uint16_t)half;
+}
+
+//signed normalised 10 bit value, in low bits
+static uint32_t packSnorm10(float value) {
+    if (value > 1.0f) value = 1.0f;
+    if (value < -1.0f) value = -1.0f;
+    int32_t snorm = (int32_t)roundf(value * 511.0f);
+    return (uint32_t)snorm & 0x3FF;
+}
+
+//x in lowest bits, as read by GL_INT_2_10_10_10_REV. w is 0
+uint32_t packNormal10_10_10_2(float x, float y, float z) {
+    return packSnorm10(x) | (packSnorm10(y) << 10) | (packSnorm10(z) << 20);
+}
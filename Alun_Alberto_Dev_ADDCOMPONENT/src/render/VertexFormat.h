@@ -0,0 +1,76 @@
+#pragma once
+#include "../includes.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//one attribute of an interleaved vertex. location matches shader layout:
+//0 position, 1 uv, 2 normal
+struct VertexAttribute {
+    GLuint location;
+    GLint size; //number of components
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset; //bytes from start of vertex
+};
+
+//layout of an interleaved vertex buffer
+struct VertexLayout {
+    GLuint stride = 0; //bytes per vertex
+    std::vector<VertexAttribute> attributes;
+
+    //same stride and attributes, so buffers of one can be used as the other
+    bool matches(const VertexLayout& other) const;
+};
+
+// How vertices are stored in VRAM. Positions are always 3 floats, first in
+// the vertex. Quantised attributes are expanded back to floats by the vertex
+// fetch, so shaders are the same for every format
+// - half_uvs: uvs as 2 half floats (4 bytes instead of 8), for meshes whose
+//   uvs all fit in +-MAX_HALF_UV. Beyond that a half float step is more than a
+//   texel, so meshes with tiled uvs keep them as floats
+// - packed_normals: normals as signed normalised 10-10-10-2 (4 bytes instead of 12)
+struct VertexFormat {
+    bool half_uvs = true;
+    bool packed_normals = true;
+
+    static const float MAX_HALF_UV;
+
+    //interleaved layout of a vertex with the given attributes
+    VertexLayout getLayout(bool has_uvs, bool has_normals) const;
+    //vertex type name of that layout in a .mesh file, e.g. PosUvHNq
+    std::string getTypeName(bool has_uvs, bool has_normals) const;
+};
+
+struct VertexSource;
+//format vertices of source are packed in: format, without half_uvs if any uv
+//of source is out of range for them
+VertexFormat getSourceFormat(const VertexSource& source, const VertexFormat& format);
+
+//float vertex attributes of a mesh in memory, each with any stride in bytes
+//(e.g. separate arrays, or one interleaved buffer). uvs and normals may be null
+struct VertexSource {
+    size_t num_vertices = 0;
+    const unsigned char* positions = nullptr; //3 floats
+    size_t position_stride = 0;
+    const unsigned char* uvs = nullptr; //2 floats
+    size_t uv_stride = 0;
+    const unsigned char* normals = nullptr; //3 floats
+    size_t normal_stride = 0;
+};
+
+//all geometry goes through these before upload, whatever file it came from.
+//Sources don't need to be aligned, so they can point into mapped files
+
+//writes vertices of source interleaved in getSourceFormat(source, format), and
+//the layout used
+void packVertices(const VertexSource& source, const VertexFormat& format,
+                  VertexLayout& layout, std::vector<unsigned char>& result);
+
+//writes indices as 16 bit if every vertex can be addressed with them, else 32
+//bit. bytes_per_index of source is 2 or 4. Returns GL type of result
+GLenum packIndices(const void* indices, size_t num_indices, GLuint bytes_per_index,
+                   size_t num_vertices, std::vector<unsigned char>& result);
+
+uint16_t floatToHalf(float value);
+uint32_t packNormal10_10_10_2(float x, float y, float z);
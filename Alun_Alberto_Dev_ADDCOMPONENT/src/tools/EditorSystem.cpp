@@ -2,8 +2,11 @@
 #include "../extern.h"
 #include "../Game.h"
 #include "../render/RenderToTexture.h"
+#include "../render/RenderDevice.h"
 #include "EditorGraphModule.h"
 #include "ConsoleModule.h"
+#include "ProfilerModule.h"
+#include "../Profiler.h"
 #include "EditorUtils.h"
 #include "../rapidjson/stringbuffer.h"
 #include "../rapidjson/writer.h"
@@ -33,6 +36,7 @@ void EditorSystem::Init()
     is_saving_scene = false;
     graph_module_ = new EditorGraphModule();
     console_module_ = new ConsoleModule();
+    profiler_module_ = new ProfilerModule();
 
     SetStyles();
     node_project_ = ProcessDirectoryOredered("assets");
@@ -68,6 +72,7 @@ void EditorSystem::SetStyles()
 // All subwindows will be rendered from here
 void EditorSystem::update(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::update");
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -92,6 +97,7 @@ void EditorSystem::update(float dt)
             UpdateInspector(dt);
             UpdateProject(dt);
             UpdateConsole(dt);
+            UpdateProfiler(dt);
             UpdateComponentMenu(dt);
         }
         ImGui::End();
@@ -100,6 +106,8 @@ void EditorSystem::update(float dt)
     // Rendering
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    //ImGui sets GL state directly
+    GPU->state.invalidate();
 }
 
 // Main menu bar, used to save scene
@@ -107,6 +115,7 @@ void EditorSystem::update(float dt)
 
 void EditorSystem::UpdateMenubar(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateMenubar");
     if (ImGui::BeginMainMenuBar())
     {
         if (ImGui::BeginMenu("File"))
@@ -179,6 +188,7 @@ void EditorSystem::UpdateMenubar(float dt)
 // Set focus if this window is the active window
 void EditorSystem::UpdateRender(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateRender");
     ImGui::Begin("Render", &is_editor_mode);
     {
         ImVec2 pos = ImGui::GetWindowPos();
@@ -200,6 +210,7 @@ void EditorSystem::UpdateRender(float dt)
 // Inspector update, loop through each entity and render it
 void EditorSystem::UpdateInspector(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateInspector");
     ImGui::Begin("Inspector", &is_editor_mode);
     {
         int entity_id = ECS.getEntity(selected);
@@ -283,6 +294,7 @@ void EditorSystem::RenderProject(NodeFile& trans) {
 // Loops through all nodes and orders them then it display.
 void EditorSystem::UpdateHierarchy(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateHierarchy");
     ImGui::Begin("Hierarchy", &is_editor_mode);
     {
         // 1) create a temporary array with ALL transforms
@@ -327,6 +339,7 @@ void EditorSystem::UpdateHierarchy(float dt)
 // Method used to update project files and display them
 void EditorSystem::UpdateProject(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateProject");
     ImGui::Begin("Project", &is_editor_mode);
     {
         RenderProject(node_project_);
@@ -337,6 +350,7 @@ void EditorSystem::UpdateProject(float dt)
 // Call on console editor update
 void EditorSystem::UpdateConsole(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateConsole");
     ImGui::Begin("Console", &is_editor_mode);
     {
         console_module_->update(dt);
@@ -344,9 +358,21 @@ void EditorSystem::UpdateConsole(float dt)
     ImGui::End();
 }
 
+// Call on profiler editor update
+void EditorSystem::UpdateProfiler(float dt)
+{
+    PROFILE_SCOPE("EditorSystem::UpdateProfiler");
+    ImGui::Begin("Profiler", &is_editor_mode);
+    {
+        profiler_module_->update(dt);
+    }
+    ImGui::End();
+}
+
 // Used to draw current fps on screen
 void EditorSystem::UpdateFPS(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateFPS");
     {
         //UI Window's Size
         ImGui::SetNextWindowSize(ImVec2((float)Game::get().getWidth(), (float)Game::get().getHeight()), ImGuiCond_Always);
@@ -364,6 +390,10 @@ void EditorSystem::UpdateFPS(float dt)
         {
             ImGui::SetCursorPos(ImVec2(Game::get().getWidth() - Game::get().getWidth() * 0.05f, Game::get().getHeight() * 0.01f));
             ImGui::Text("FPS %d", (int)Game::get().fps);
+            GraphicsSystem& graphics = Game::get().getGraphicsSystem();
+            ImGui::SetCursorPosX(Game::get().getWidth() - Game::get().getWidth() * 0.05f);
+            ImGui::Text("Meshes %d/%d", graphics.getVisibleMeshCount(),
+                        graphics.getVisibleMeshCount() + graphics.getCulledMeshCount());
         }
 
         ImGui::End();
@@ -408,6 +438,7 @@ void EditorSystem::SetPickingRay(int mouse_x, int mouse_y, int screen_width, int
 // Dialog window to add a component
 void EditorSystem::UpdateComponentMenu(float dt)
 {
+    PROFILE_SCOPE("EditorSystem::UpdateComponentMenu");
     if(is_adding_component)
     {
 		const char * components[]{ "Transform","Light","Collider","Elevator" };
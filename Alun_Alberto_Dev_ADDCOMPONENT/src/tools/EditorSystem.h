@@ -14,6 +14,7 @@ struct TransformNode {
 
 class NodeFile;
 class ConsoleModule;
+class ProfilerModule;
 class EditorGraphModule;
 
 // This class holds the user interface and other related methods
@@ -68,6 +69,7 @@ private:
     void UpdateHierarchy(float dt);
     void UpdateProject(float dt);
     void UpdateConsole(float dt);
+    void UpdateProfiler(float dt);
     void UpdateFPS(float dt);
     
     void UpdateComponentMenu(float dt);
@@ -82,6 +84,7 @@ private:
 	int speed = 2;
 	lm::vec3 direction;
     ConsoleModule * console_module_;
+    ProfilerModule * profiler_module_;
     EditorGraphModule * graph_module_;
 };
 
@@ -0,0 +1,80 @@
+#include "ProfilerModule.h"
+#include "../render/RenderDevice.h"
+#include <algorithm>
+
+ProfilerModule::ProfilerModule()
+{
+    paused_ = false;
+    frame_ms_ = 0.0;
+}
+
+ProfilerModule::~ProfilerModule()
+{
+
+}
+
+// Draw controls, then for each thread the zones of last frame, indented by
+// nesting level, with a bar showing when they ran within the frame
+void ProfilerModule::update(float dt)
+{
+    Profiler& profiler = Profiler::get();
+
+    bool enabled = Profiler::isEnabled();
+    if (ImGui::Checkbox("Enabled", &enabled))
+        profiler.setEnabled(enabled);
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused_);
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace")) {
+        const char* filename = "profile_trace.json";
+        export_status_ = profiler.exportChromeTrace(filename) ? std::string("Saved ") + filename : "Export failed";
+    }
+    if (export_status_ != "") {
+        ImGui::SameLine();
+        ImGui::Text("%s", export_status_.c_str());
+    }
+
+    if (!paused_) {
+        frame_ = profiler.getLastFrame();
+        frame_ms_ = profiler.getLastFrameMs();
+        state_stats_ = GPU->state.last_frame_stats;
+    }
+    ImGui::Text("Frame %.2f ms", frame_ms_);
+    ImGui::Text("GL state calls: %u issued, %u skipped", state_stats_.issued, state_stats_.skipped);
+    ImGui::Separator();
+    if (frame_.empty()) return;
+
+    int64_t frame_start = frame_[0].start;
+    int64_t frame_end = frame_[0].end;
+    for (auto& event : frame_) {
+        frame_start = std::min(frame_start, event.start);
+        frame_end = std::max(frame_end, event.end);
+    }
+    float frame_length = (float)std::max<int64_t>(frame_end - frame_start, 1);
+    const float bar_width = 200.0f;
+
+    //events are sorted by thread, then start
+    size_t i = 0;
+    while (i < frame_.size()) {
+        int thread = frame_[i].thread;
+        std::string thread_name = profiler.getThreadName(thread);
+        bool open = ImGui::TreeNodeEx(thread_name.c_str(), ImGuiTreeNodeFlags_DefaultOpen);
+        for (; i < frame_.size() && frame_[i].thread == thread; i++) {
+            if (!open) continue;
+            const ProfileEvent& event = frame_[i];
+            float ms = (event.end - event.start) / 1000000.0f;
+
+            //bar
+            ImVec2 p = ImGui::GetCursorScreenPos();
+            float x0 = p.x + bar_width * (event.start - frame_start) / frame_length;
+            float x1 = p.x + bar_width * (event.end - frame_start) / frame_length;
+            ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(x0, p.y + 2), ImVec2(std::max(x1, x0 + 1.0f), p.y + ImGui::GetTextLineHeight() - 2),
+                                                      ImGui::GetColorU32(ImGuiCol_PlotHistogram));
+            ImGui::Dummy(ImVec2(bar_width, ImGui::GetTextLineHeight()));
+            ImGui::SameLine();
+
+            ImGui::Text("%*s%s %.3f ms", event.depth * 2, "", event.name, ms);
+        }
+        if (open) ImGui::TreePop();
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "../includes.h"
+#include "../Profiler.h"
+#include "../render/RenderStateCache.h"
+#include <string>
+#include <vector>
+
+// Profiler module
+// Shows zones of last frame per thread and GL state cache stats, and exports
+// Chrome traces
+class ProfilerModule {
+public:
+
+    ProfilerModule();
+    ~ProfilerModule();
+
+    void update(float dt);
+
+private:
+
+    bool paused_;
+    std::string export_status_;
+
+    //copy of last frame shown while paused
+    std::vector<ProfileEvent> frame_;
+    double frame_ms_;
+    RenderStateStats state_stats_;
+};